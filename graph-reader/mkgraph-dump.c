@@ -0,0 +1,60 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Example user of the reader: prints the goals, then every file
+   followed by its dependencies, one per indented line.  */
+
+#include "mkgraph.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+int
+main (int argc, char **argv)
+{
+  struct mkgraph g;
+  uint64_t i;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: %s <file written by make --goaltree-binary>\n",
+               argv[0]);
+      return 2;
+    }
+
+  if (mkgraph_open (&g, argv[1]) != 0)
+    {
+      fprintf (stderr, "%s: %s\n", argv[1], strerror (errno));
+      return 1;
+    }
+
+  printf ("goals:");
+  for (i = 0; i < g.header->goal_count; ++i)
+    printf (" %s", mkgraph_name (&g, g.goals[i]));
+  printf ("\n");
+
+  for (i = 0; i < mkgraph_node_count (&g); ++i)
+    {
+      uint64_t e, end;
+
+      printf ("%s\n", mkgraph_name (&g, (uint32_t) i));
+      mkgraph_edges (&g, (uint32_t) i, &e, &end);
+      for (; e < end; ++e)
+        printf ("  %s%s\n", mkgraph_name (&g, g.edge_target[e]),
+                g.edge_flags[e] & MKGRAPH_EDGE_ORDER_ONLY ? " [order-only]" : "");
+    }
+
+  mkgraph_close (&g);
+  return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mkgraph.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Is [OFFSET, OFFSET + COUNT * SIZE) inside the file and aligned? */
+static int
+section_ok (const struct mkgraph_header *h, uint64_t offset,
+            uint64_t count, uint64_t size)
+{
+  if (offset % 8 != 0 || offset > h->file_size)
+    return 0;
+  if (size != 0 && count > (h->file_size - offset) / size)
+    return 0;
+  return 1;
+}
+
+/* Does every index in G stay inside the sections it points into?  Done
+   once here, so that the accessors in mkgraph.h need no checks.  */
+static int
+indices_ok (const struct mkgraph *g)
+{
+  const struct mkgraph_header *h = g->header;
+  uint64_t i;
+
+  if (g->first_edge[0] != 0 || g->first_edge[h->node_count] != h->edge_count)
+    return 0;
+  for (i = 0; i < h->node_count; ++i)
+    if (g->first_edge[i] > g->first_edge[i + 1]
+        || g->nodes[i].name >= h->strings_size)
+      return 0;
+  for (i = 0; i < h->edge_count; ++i)
+    if (g->edge_target[i] >= h->node_count)
+      return 0;
+  for (i = 0; i < h->goal_count; ++i)
+    if (g->goals[i] >= h->node_count)
+      return 0;
+
+  /* Every name ends inside the string table.  */
+  return h->strings_size == 0 || g->strings[h->strings_size - 1] == '\0';
+}
+
+int
+mkgraph_open (struct mkgraph *g, const char *path)
+{
+  const struct mkgraph_header *h;
+  struct stat st;
+  void *base;
+  int fd;
+
+  memset (g, 0, sizeof (*g));
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  if (fstat (fd, &st) != 0)
+    {
+      int saved = errno;
+      close (fd);
+      errno = saved;
+      return -1;
+    }
+
+  if ((uint64_t) st.st_size < sizeof (struct mkgraph_header))
+    {
+      close (fd);
+      errno = EINVAL;
+      return -1;
+    }
+
+  base = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    return -1;
+
+  h = (const struct mkgraph_header *) base;
+  if (memcmp (h->magic, MKGRAPH_MAGIC, sizeof (MKGRAPH_MAGIC)) != 0
+      || h->version != MKGRAPH_VERSION
+      || h->byte_order != MKGRAPH_BYTE_ORDER
+      || h->file_size != (uint64_t) st.st_size
+      || h->node_count >= UINT32_MAX
+      || !section_ok (h, h->strings_offset, h->strings_size, 1)
+      || !section_ok (h, h->nodes_offset, h->node_count,
+                      sizeof (struct mkgraph_node))
+      || !section_ok (h, h->first_edge_offset, h->node_count + 1,
+                      sizeof (uint64_t))
+      || !section_ok (h, h->edge_target_offset, h->edge_count,
+                      sizeof (uint32_t))
+      || !section_ok (h, h->edge_flags_offset, h->edge_count, 1)
+      || !section_ok (h, h->goals_offset, h->goal_count, sizeof (uint32_t)))
+    {
+      munmap (base, st.st_size);
+      errno = EINVAL;
+      return -1;
+    }
+
+  g->base = base;
+  g->size = st.st_size;
+  g->header = h;
+  g->strings = (const char *) base + h->strings_offset;
+  g->nodes = (const struct mkgraph_node *) ((const char *) base + h->nodes_offset);
+  g->first_edge = (const uint64_t *) ((const char *) base + h->first_edge_offset);
+  g->edge_target = (const uint32_t *) ((const char *) base + h->edge_target_offset);
+  g->edge_flags = (const uint8_t *) base + h->edge_flags_offset;
+  g->goals = (const uint32_t *) ((const char *) base + h->goals_offset);
+
+  if (!indices_ok (g))
+    {
+      mkgraph_close (g);
+      errno = EINVAL;
+      return -1;
+    }
+
+  return 0;
+}
+
+void
+mkgraph_close (struct mkgraph *g)
+{
+  if (g->base != NULL)
+    munmap (g->base, g->size);
+  memset (g, 0, sizeof (*g));
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Layout of the files written by make --goaltree-binary, and a reader
+   that maps them into memory and walks them without any parsing.
+
+   A file is a header followed by these sections, each starting on an
+   8-byte boundary, in the byte order of the machine that wrote it:
+
+     strings     NUL-terminated file names, referenced by offset
+     nodes       node_count struct mkgraph_node
+     first_edge  node_count + 1 uint64_t; the dependencies of node N are
+                 edges first_edge[N] .. first_edge[N+1] - 1
+     edge_target edge_count uint32_t node numbers
+     edge_flags  edge_count uint8_t, MKGRAPH_EDGE_* bits
+     goals       goal_count uint32_t node numbers  */
+
+#ifndef MKGRAPH_H
+#define MKGRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MKGRAPH_MAGIC "MKGRAPH"
+#define MKGRAPH_VERSION 1
+#define MKGRAPH_BYTE_ORDER 0x01020304u
+
+/* Node flags */
+#define MKGRAPH_NODE_TARGET       (1u << 0) /* described as a target */
+#define MKGRAPH_NODE_HAS_RECIPE   (1u << 1)
+#define MKGRAPH_NODE_PHONY        (1u << 2)
+#define MKGRAPH_NODE_PRECIOUS     (1u << 3)
+#define MKGRAPH_NODE_INTERMEDIATE (1u << 4)
+#define MKGRAPH_NODE_SECONDARY    (1u << 5)
+#define MKGRAPH_NODE_DOUBLE_COLON (1u << 6)
+#define MKGRAPH_NODE_GOAL         (1u << 7)
+
+/* Edge flags */
+#define MKGRAPH_EDGE_ORDER_ONLY     (1u << 0) /* ignore_mtime */
+#define MKGRAPH_EDGE_STATIC_PATTERN (1u << 1)
+#define MKGRAPH_EDGE_SECOND_EXPANSION (1u << 2)
+
+struct mkgraph_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t node_count;
+  uint64_t edge_count;
+  uint64_t goal_count;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  uint64_t nodes_offset;
+  uint64_t first_edge_offset;
+  uint64_t edge_target_offset;
+  uint64_t edge_flags_offset;
+  uint64_t goals_offset;
+  uint64_t file_size;
+};
+
+struct mkgraph_node
+{
+  uint64_t name;                /* offset into the string table */
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+/* A mapped graph file */
+struct mkgraph
+{
+  void *base;
+  size_t size;
+  const struct mkgraph_header *header;
+  const char *strings;
+  const struct mkgraph_node *nodes;
+  const uint64_t *first_edge;
+  const uint32_t *edge_target;
+  const uint8_t *edge_flags;
+  const uint32_t *goals;
+};
+
+/* Maps PATH and checks its header, its section bounds and every node,
+   edge and goal index and name offset in it, so that a truncated or
+   corrupt file is refused rather than read out of bounds.
+   Returns 0 on success, or -1 with errno set (EINVAL for a file that is
+   not a graph of a version this reader understands).  */
+int mkgraph_open (struct mkgraph *g, const char *path);
+void mkgraph_close (struct mkgraph *g);
+
+static inline uint64_t
+mkgraph_node_count (const struct mkgraph *g)
+{
+  return g->header->node_count;
+}
+
+static inline const char *
+mkgraph_name (const struct mkgraph *g, uint32_t node)
+{
+  return g->strings + g->nodes[node].name;
+}
+
+static inline uint32_t
+mkgraph_flags (const struct mkgraph *g, uint32_t node)
+{
+  return g->nodes[node].flags;
+}
+
+/* The dependencies of NODE are edges *BEGIN .. *END - 1 */
+static inline void
+mkgraph_edges (const struct mkgraph *g, uint32_t node,
+               uint64_t *begin, uint64_t *end)
+{
+  *begin = g->first_edge[node];
+  *end = g->first_edge[node + 1];
+}
+
+#endif /* MKGRAPH_H */
@@ -1,25 +1,25 @@
 function MinimalistTree (container)
 {
     return {
-        draw : (options) => expandOrCollapseNodes (container, options)
+        draw : (options) => expandOrCollapseNodes (container, options, options.getroots)
     }
 }
 
-function addNode (parent, node, options)
+// Lists longer than this only create elements for the rows in view
+const virtualListThreshold = 200;
+const virtualRowHeight = 20;
+const virtualVisibleRows = 25;
+
+function createNode (node, options)
 {
     var li = document.createElement ('li');
 
     li.appendChild (document.createTextNode (options.getlabel(node)));
 
-    const children = options.getchildren (node);
-    if (children != null && children.length > 0)
+    if (options.haschildren (node))
     {
         li.addEventListener ('click', (e) => {
-            expandOrCollapseNodes (li, {
-                getroots : () => children,
-                getchildren : options.getchildren,
-                getlabel : options.getlabel
-            });
+            expandOrCollapseNodes (li, options, () => options.getchildren (node));
             e.stopPropagation ();
         });
     }
@@ -28,31 +28,174 @@ function addNode (parent, node, options)
         li.addEventListener ('click', (e) => e.stopPropagation ());
     }
 
-    parent.appendChild (li);
+    return li;
 }
 
-function expandOrCollapseNodes (parent, options)
+function createVirtualList (nodes, options)
 {
-    var existingUls = parent.getElementsByTagName ('ul');
-    if (existingUls.length > 0)
+    var box = document.createElement ('div');
+    box.setAttribute ('style', 'height:' + (virtualRowHeight * virtualVisibleRows) +
+                      'px;overflow-y:auto;position:relative');
+
+    var spacer = document.createElement ('div');
+    spacer.setAttribute ('style', 'height:' + (virtualRowHeight * nodes.length) + 'px');
+    box.appendChild (spacer);
+
+    var ul = document.createElement ('ul');
+    box.appendChild (ul);
+
+    // Rows in a virtual list have a fixed height, so the children of a
+    // clicked row are shown below the list instead of inside it
+    var details = document.createElement ('div');
+
+    var first = -1;
+    const render = () => {
+        const newFirst = Math.floor (box.scrollTop / virtualRowHeight);
+        if (newFirst == first)
+            return;
+        first = newFirst;
+
+        ul.setAttribute ('style', 'position:absolute;margin:0;top:' +
+                         (first * virtualRowHeight) + 'px');
+        while (ul.firstChild)
+            ul.removeChild (ul.firstChild);
+
+        const last = Math.min (nodes.length, first + virtualVisibleRows + 1);
+        for (var i = first; i < last; ++i)
+        {
+            const node = nodes[i];
+            var li = document.createElement ('li');
+            li.setAttribute ('style', 'height:' + virtualRowHeight + 'px;white-space:nowrap');
+            li.appendChild (document.createTextNode (options.getlabel(node)));
+            li.addEventListener ('click', (e) => {
+                while (details.firstChild)
+                    details.removeChild (details.firstChild);
+                var ul = document.createElement ('ul');
+                ul.appendChild (createNode (node, options));
+                details.appendChild (ul);
+                e.stopPropagation ();
+            });
+            ul.appendChild (li);
+        }
+    };
+    box.addEventListener ('scroll', render);
+    render ();
+
+    var wrapper = document.createElement ('div');
+    wrapper.appendChild (box);
+    wrapper.appendChild (details);
+    return wrapper;
+}
+
+function expandOrCollapseNodes (parent, options, getnodes)
+{
+    var existing = parent.lastChild;
+    if (existing != null && existing.className == 'minimalist-tree-children')
     {
         // Toggle the state
-        var styles = window.getComputedStyle (existingUls.item(0));
-        if (styles.getPropertyValue ('display') == 'none')
+        if (existing.style.display == 'none')
         {
-            existingUls.item(0).setAttribute ('style', 'display:block');
+            existing.style.display = 'block';
         }
         else
         {
-            existingUls.item(0).setAttribute ('style', 'display:none');
+            existing.style.display = 'none';
         }
         return;
     }
 
-    // Create a new list for the nodes
-    var ul = document.createElement ('ul');
-    options.getroots().forEach ( (node) => {
-        addNode (ul, node, options);
+    if (parent.dataset.loading)
+    {
+        return;
+    }
+    if (existing != null && existing.className == 'minimalist-tree-error')
+    {
+        // Try again
+        parent.removeChild (existing);
+    }
+    parent.dataset.loading = 'yes';
+
+    // The nodes may have to be fetched first
+    Promise.resolve (getnodes ()).then ((nodes) => {
+        var children;
+        if (nodes.length > virtualListThreshold)
+        {
+            children = createVirtualList (nodes, options);
+        }
+        else
+        {
+            children = document.createElement ('ul');
+            nodes.forEach ( (node) => {
+                children.appendChild (createNode (node, options));
+            });
+        }
+        children.className = 'minimalist-tree-children';
+        children.style.display = 'block';
+        parent.appendChild (children);
+        delete parent.dataset.loading;
+    }).catch ((error) => {
+        var message = document.createElement ('div');
+        message.className = 'minimalist-tree-error';
+        message.textContent = 'Could not load the tree: ' + error.message;
+        parent.appendChild (message);
+        delete parent.dataset.loading;
     });
-    parent.appendChild (ul);
+}
+
+// Loads the data files written by make --goaltree-html-dir.  Node n is
+// described in data/chunk-<k>.js, k = floor ((n - 1) / chunkSize), which
+// calls goalTreeChunk (k, [[label, [child, ...]], ...]).  Script tags are
+// used instead of fetch () so that the viewer also works from file:// URLs
+function GoalTreeChunks (chunkSize)
+{
+    const chunks = {};
+    const waiting = {};
+
+    window.goalTreeChunk = (k, nodes) => {
+        chunks[k] = nodes;
+        if (waiting[k])
+        {
+            waiting[k].resolve ();
+        }
+    };
+
+    const chunkOf = (node) => Math.floor ((node - 1) / chunkSize);
+
+    const load = (k) => {
+        if (!waiting[k])
+        {
+            var resolveChunk;
+            var rejectChunk;
+            const loaded = new Promise ((resolve, reject) => {
+                resolveChunk = resolve;
+                rejectChunk = reject;
+            });
+            waiting[k] = { promise : loaded, resolve : resolveChunk };
+            var script = document.createElement ('script');
+            script.src = 'data/chunk-' + k + '.js';
+            const fail = () => {
+                // Forget the attempt, so that expanding the node again retries
+                delete waiting[k];
+                script.remove ();
+                rejectChunk (new Error ('data/chunk-' + k + '.js is missing or broken'));
+            };
+            script.onerror = fail;
+            script.onload = () => {
+                if (!chunks[k])
+                {
+                    fail ();
+                }
+            };
+            document.head.appendChild (script);
+        }
+        return waiting[k].promise;
+    };
+
+    return {
+        ensure : (nodes) => {
+            const needed = new Set (nodes.map (chunkOf));
+            return Promise.all ([...needed].filter ((k) => !chunks[k]).map (load));
+        },
+        node : (node) => chunks[chunkOf (node)][(node - 1) % chunkSize]
+    };
 }
@@ -0,0 +1,62 @@
+# Reader for the files written by make --goaltree-binary.
+# See graph-reader/mkgraph.h for the layout.
+
+import mmap
+import struct
+
+MAGIC = b'MKGRAPH\0'
+VERSION = 1
+BYTE_ORDER = 0x01020304
+
+HEADER = struct.Struct ('=8sII11Q')
+
+# struct mkgraph_node: name offset, flags, reserved
+NODE = struct.Struct ('=QII')
+
+EDGE_ORDER_ONLY = 1
+EDGE_STATIC_PATTERN = 2
+EDGE_SECOND_EXPANSION = 4
+
+class MakeGraph:
+    def __init__ (self, path):
+        with open (path, 'rb') as f:
+            self.map = mmap.mmap (f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        (magic, version, byteOrder,
+         self.nodeCount, self.edgeCount, self.goalCount,
+         stringsOffset, stringsSize, nodesOffset, firstEdgeOffset,
+         edgeTargetOffset, edgeFlagsOffset, goalsOffset,
+         fileSize) = HEADER.unpack_from (self.map)
+
+        if magic != MAGIC or version != VERSION or byteOrder != BYTE_ORDER \
+           or fileSize != len (self.map):
+            raise ValueError ('{} is not a version {} goal graph'.format (path, VERSION))
+
+        # Typed views straight onto the mapped file: nothing is copied
+        view = memoryview (self.map)
+        self.stringsOffset = stringsOffset
+        self.nodesOffset = nodesOffset
+        self.nodes = view[nodesOffset:nodesOffset + 16 * self.nodeCount].cast ('Q')
+        self.firstEdge = view[firstEdgeOffset:firstEdgeOffset + 8 * (self.nodeCount + 1)].cast ('Q')
+        self.edgeTarget = view[edgeTargetOffset:edgeTargetOffset + 4 * self.edgeCount].cast ('I')
+        self.edgeFlags = view[edgeFlagsOffset:edgeFlagsOffset + self.edgeCount]
+        self.goalNodes = view[goalsOffset:goalsOffset + 4 * self.goalCount].cast ('I')
+
+    def name (self, node):
+        start = self.stringsOffset + self.nodes[2 * node]
+        return self.map[start:self.map.find (b'\0', start)].decode ('utf-8', 'replace')
+
+    def flags (self, node):
+        return NODE.unpack_from (self.map, self.nodesOffset + NODE.size * node)[1]
+
+    def goals (self):
+        return list (self.goalNodes)
+
+    def deps (self, node):
+        """The dependencies of node as (node, edge flags) pairs"""
+        return [(self.edgeTarget[e], self.edgeFlags[e])
+                for e in range (self.firstEdge[node], self.firstEdge[node + 1])]
+
+def isMakeGraph (path):
+    with open (path, 'rb') as f:
+        return f.read (len (MAGIC)) == MAGIC
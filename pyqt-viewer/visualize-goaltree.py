@@ -3,6 +3,8 @@
 import sys
 import json
 
+import makegraph
+
 from PyQt5.QtWidgets import QMainWindow, QApplication, QTreeView, QAction
 from PyQt5.QtGui import QStandardItemModel, QStandardItem, QKeySequence
 
@@ -10,10 +12,42 @@ class GoalDepTreeModel (QStandardItemModel):
     def __init__ (self, jsonFile):
         super (GoalDepTreeModel, self).__init__()
 
+        self.getChildren = None
+        if makegraph.isMakeGraph (jsonFile):
+            graph = makegraph.MakeGraph (jsonFile)
+            self.getChildren = lambda node: [child for child, flags in graph.deps (node)]
+            self.getLabel = graph.name
+            for target in graph.goals():
+                self.appendDagItem (self.invisibleRootItem(), target)
+            return
+
         with open (jsonFile) as f:
             treeData = json.load(f)
-            self.setTreeData (self.invisibleRootItem(), treeData['targets'], treeData['ids'])
+            if treeData.get ('format') == 'dag':
+                self.getChildren = lambda fileId: treeData['deps'].get (fileId, [])
+                self.getLabel = lambda fileId: treeData['ids'][ fileId ]
+                for target in treeData['targets']:
+                    self.appendDagItem (self.invisibleRootItem(), target)
+            else:
+                self.setTreeData (self.invisibleRootItem(), treeData['targets'], treeData['ids'])
+
+    # In the DAG and binary formats a file is listed once however many files
+    # depend on it, so children are only created when their parent gets expanded
+    def appendDagItem (self, parent, fileId):
+        item = QStandardItem (self.getLabel (fileId))
+        item.setData (fileId)
+        if self.getChildren (fileId):
+            item.appendRow (QStandardItem ())
+        parent.appendRow (item)
 
+    def expandDagItem (self, index):
+        if self.getChildren is None:
+            return
+        item = self.itemFromIndex (index)
+        if item.rowCount() == 1 and item.child (0).data() is None:
+            item.removeRow (0)
+            for child in self.getChildren (item.data()):
+                self.appendDagItem (item, child)
 
     def setTreeData (self, parent, treeData, idData):
         if type (treeData) == list:
@@ -35,6 +69,7 @@ class GoalDepTreeView (QTreeView):
         super (GoalDepTreeView, self).__init__()
         treeModel = GoalDepTreeModel (jsonFile)
         self.setModel (treeModel)
+        self.expanded.connect (treeModel.expandDagItem)
         self.setHeaderHidden (True)
         self.show()
 
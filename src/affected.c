@@ -0,0 +1,178 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "graph.h"
+
+#include <stdio.h>
+
+#define CHANGED 1
+#define REMADE 2
+#define LISTED 4
+
+static const struct file_graph * sortGraph;
+
+static int node_name_compare (const void * a, const void * b)
+{
+  unsigned long aNode = *(const unsigned long *) a;
+  unsigned long bNode = *(const unsigned long *) b;
+  return strcmp (sortGraph->nodes[aNode]->name, sortGraph->nodes[bNode]->name);
+}
+
+/** Marks the files named in the comma-separated list NAMES as changed,
+ * appends them to QUEUE and returns the new length of QUEUE.  Names
+ * that are not in the data base are printed */
+static unsigned long mark_changed (const char * names,
+                                   unsigned char * state,
+                                   unsigned long * queue,
+                                   unsigned long count,
+                                   int * unknown)
+{
+  const char * p = names;
+
+  while (*p != '\0')
+    {
+      const char * end = strchr (p, ',');
+      size_t length = end != NULL ? (size_t) (end - p) : strlen (p);
+
+      if (length > 0)
+        {
+          char * name = xstrndup (p, length);
+          struct file * f = lookup_file (name);
+
+          if (f == NULL)
+            {
+              if (!*unknown)
+                printf (_("Not in the dependency graph:"));
+              printf (" %s", name);
+              *unknown = 1;
+            }
+          else
+            {
+              unsigned long v = file_graph_node (f);
+              if (!state[v])
+                {
+                  state[v] = CHANGED;
+                  queue[count++] = v;
+                }
+            }
+          free (name);
+        }
+
+      p += length;
+      if (*p == ',')
+        ++p;
+    }
+
+  return count;
+}
+
+/** Answers which of the files that updating the goals would consider
+ * would be remade if the given files changed, without updating anything:
+ * a walk from the changed files over the reverse edges of the dependency
+ * graph, once implicit rules have added their dependencies.  Order-only
+ * dependencies are not followed, since a newer order-only prerequisite
+ * does not make its target out of date.  FILES is a NULL-terminated list
+ * of comma-separated lists of file names */
+void report_affected_by (struct goaldep * goals, const char ** files)
+{
+  struct file_graph g;
+  unsigned long * firstReverse;
+  unsigned long * reverse;
+  unsigned long * reverseEdge;
+  unsigned long * queue;
+  unsigned long * remade;
+  unsigned long * goalNodes;
+  unsigned char * reachable;
+  unsigned char * state;
+  struct goaldep * itr;
+  unsigned long count = 0;
+  unsigned long remadeCount = 0;
+  unsigned long goalCount = 0;
+  unsigned long head;
+  unsigned long i;
+  int unknown = 0;
+
+  file_graph_add_implicit_dependencies (goals);
+  file_graph_build (&g);
+  firstReverse = file_graph_reverse (&g, NULL, &reverse, &reverseEdge);
+
+  queue = (unsigned long *) xmalloc ((g.node_count + 1) * sizeof (unsigned long));
+  state = (unsigned char *) xcalloc (g.node_count + 1);
+  for (; *files != NULL; ++files)
+    count = mark_changed (*files, state, queue, count, &unknown);
+  if (unknown)
+    printf ("\n");
+
+  for (head = 0; head < count; ++head)
+    {
+      unsigned long v = queue[head];
+      unsigned long e;
+
+      for (e = firstReverse[v]; e < firstReverse[v + 1]; ++e)
+        {
+          unsigned long w = reverse[e];
+
+          if (g.edge_dep[reverseEdge[e]]->ignore_mtime)
+            continue;
+          if (!(state[w] & REMADE))
+            {
+              if (!state[w])
+                queue[count++] = w;
+              state[w] |= REMADE;
+            }
+        }
+    }
+
+  /* Only what updating the goals would get to */
+  reachable = (unsigned char *) xcalloc (g.node_count + 1);
+  remade = (unsigned long *) xmalloc ((g.node_count + 1) * sizeof (unsigned long));
+  file_graph_reachable (&g, goals, remade, reachable);
+  for (i = 0; i < g.node_count; ++i)
+    if (reachable[i] && (state[i] & REMADE))
+      remade[remadeCount++] = i;
+  sortGraph = &g;
+  qsort (remade, remadeCount, sizeof (unsigned long), node_name_compare);
+
+  /* Each goal once, even if it was given twice */
+  goalNodes = (unsigned long *) xmalloc ((g.node_count + 1) * sizeof (unsigned long));
+  for (itr = goals; itr != NULL; itr = itr->next)
+    {
+      unsigned long v = file_graph_node (itr->file);
+      if ((state[v] & REMADE) && !(state[v] & LISTED))
+        {
+          state[v] |= LISTED;
+          goalNodes[goalCount++] = v;
+        }
+    }
+
+  printf (_("Goals remade (%lu):\n"), goalCount);
+  for (i = 0; i < goalCount; ++i)
+    printf ("  %s\n", g.nodes[goalNodes[i]]->name);
+
+  printf (_("Files remade (%lu):\n"), remadeCount);
+  for (i = 0; i < remadeCount; ++i)
+    printf ("  %s\n", g.nodes[remade[i]]->name);
+
+  free (goalNodes);
+  free (remade);
+  free (reachable);
+  free (state);
+  free (queue);
+  free (reverseEdge);
+  free (reverse);
+  free (firstReverse);
+  file_graph_free (&g);
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "graph.h"
+#include "history.h"
+
+#include <stdio.h>
+
+#define NO_NODE ((unsigned long) -1)
+
+static const struct file_graph * sortGraph;
+static double * sortSlack;
+
+/** Orders by increasing slack, then by name */
+static int slack_compare (const void * a, const void * b)
+{
+  unsigned long aNode = *(const unsigned long *) a;
+  unsigned long bNode = *(const unsigned long *) b;
+
+  if (sortSlack[aNode] != sortSlack[bNode])
+    return sortSlack[aNode] < sortSlack[bNode] ? -1 : 1;
+  return strcmp (sortGraph->nodes[aNode]->name, sortGraph->nodes[bNode]->name);
+}
+
+/** Weighs every file reachable from the goals with the duration its
+ * recipe took according to the history file, and prints the longest
+ * weighted chain of dependencies, which no amount of -j can shorten,
+ * followed by the slack of every recipe: how much longer it could take
+ * without making the whole build longer.  Implicit rules are searched
+ * first, so recipes and dependencies they supply count.  Files with no
+ * recipe weigh nothing, and recipes with no recorded duration are
+ * counted as instant.  Edges inside dependency cycles are ignored */
+void report_critical_path (struct goaldep * goals, const char * history)
+{
+  struct file_graph g;
+  unsigned long componentCount;
+  unsigned long * component;
+  unsigned long * queue;
+  unsigned char * reachable;
+  unsigned long * order;
+  unsigned long * via;
+  unsigned long * path;
+  unsigned long * recipes;
+  double * durations;
+  double * finish;
+  double * tail;
+  double * slack;
+  double total = 0.0;
+  unsigned long last = NO_NODE;
+  unsigned long nodes;
+  unsigned long pathLength = 0;
+  unsigned long recipeCount = 0;
+  unsigned long unknown = 0;
+  unsigned long i;
+  unsigned long e;
+
+  file_graph_add_implicit_dependencies (goals);
+  file_graph_build (&g);
+  durations = load_recipe_durations (history, &g);
+  if (durations == NULL)
+    {
+      file_graph_free (&g);
+      return;
+    }
+
+  queue = (unsigned long *) xmalloc ((g.node_count + 1) * sizeof (unsigned long));
+  reachable = (unsigned char *) xcalloc (g.node_count + 1);
+  nodes = file_graph_reachable (&g, goals, queue, reachable);
+
+  for (i = 0; i < nodes; ++i)
+    {
+      unsigned long v = queue[i];
+      if (g.nodes[v]->cmds == NULL)
+        durations[v] = 0.0;
+      else if (durations[v] < 0)
+        {
+          durations[v] = 0.0;
+          ++unknown;
+        }
+    }
+
+  component = file_graph_scc (&g, &componentCount);
+  order = file_graph_order (queue, nodes, component, componentCount);
+
+  /* Earliest finish of every file, dependencies first, remembering
+     through which dependency the longest chain came */
+  finish = (double *) xcalloc ((g.node_count + 1) * sizeof (double));
+  via = (unsigned long *) xmalloc ((g.node_count + 1) * sizeof (unsigned long));
+  for (i = 0; i < nodes; ++i)
+    {
+      unsigned long v = order[i];
+      double start = 0.0;
+
+      via[v] = NO_NODE;
+      for (e = g.first_edge[v]; e < g.first_edge[v + 1]; ++e)
+        {
+          unsigned long w = g.edge_target[e];
+          if (component[w] != component[v] && finish[w] > start)
+            {
+              start = finish[w];
+              via[v] = w;
+            }
+        }
+      finish[v] = start + durations[v];
+      if (last == NO_NODE || finish[v] > total)
+        {
+          total = finish[v];
+          last = v;
+        }
+    }
+
+  /* Longest chain from the end of every file to the end of the build,
+     dependers first */
+  tail = (double *) xcalloc ((g.node_count + 1) * sizeof (double));
+  for (i = nodes; i-- > 0;)
+    {
+      unsigned long v = order[i];
+      for (e = g.first_edge[v]; e < g.first_edge[v + 1]; ++e)
+        {
+          unsigned long w = g.edge_target[e];
+          if (component[w] != component[v]
+              && durations[v] + tail[v] > tail[w])
+            tail[w] = durations[v] + tail[v];
+        }
+    }
+
+  slack = (double *) xcalloc ((g.node_count + 1) * sizeof (double));
+  recipes = (unsigned long *) xmalloc ((nodes + 1) * sizeof (unsigned long));
+  for (i = 0; i < nodes; ++i)
+    {
+      unsigned long v = order[i];
+      slack[v] = total - finish[v] - tail[v];
+      /* Rounding must not split the files on the critical path */
+      if (slack[v] < 1e-9)
+        slack[v] = 0.0;
+      if (g.nodes[v]->cmds != NULL)
+        recipes[recipeCount++] = v;
+    }
+  sortGraph = &g;
+  sortSlack = slack;
+  qsort (recipes, recipeCount, sizeof (unsigned long), slack_compare);
+
+  path = (unsigned long *) xmalloc ((nodes + 1) * sizeof (unsigned long));
+  for (i = last; i != NO_NODE; i = via[i])
+    path[pathLength++] = i;
+
+  printf (_("Critical path: %.3f seconds through %lu files\n"),
+          total, pathLength);
+  printf (_("       start    duration  target\n"));
+  while (pathLength-- > 0)
+    {
+      unsigned long v = path[pathLength];
+      printf ("  %10.3f  %10.3f  %s\n", finish[v] - durations[v],
+              durations[v], g.nodes[v]->name);
+    }
+
+  printf (_("Slack of %lu recipes:\n"), recipeCount);
+  printf (_("       slack    duration  target\n"));
+  for (i = 0; i < recipeCount; ++i)
+    {
+      unsigned long v = recipes[i];
+      printf ("  %10.3f  %10.3f  %s\n", slack[v], durations[v],
+              g.nodes[v]->name);
+    }
+
+  if (unknown > 0)
+    printf (_("%lu recipes have no recorded duration and were counted as 0 seconds\n"),
+            unknown);
+
+  free (path);
+  free (recipes);
+  free (slack);
+  free (tail);
+  free (via);
+  free (finish);
+  free (order);
+  free (component);
+  free (reachable);
+  free (queue);
+  free (durations);
+  file_graph_free (&g);
+}
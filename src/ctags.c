@@ -13,74 +13,95 @@
 
 #include "ctags.h"
 #include "makeint.h"
+#include "jsonout.h"
 
 #include <stdio.h>
 
 static FILE * TAGSfile = NULL;
 typedef struct {
-  const char * name;
+  const char * name;            /* both strings live in the strcache */
   const char * filename;
   unsigned long lineno;
+  char kind;
 } TAGline;
 
+/** Orders by name, as editors binary-search on it, then by location */
 static int TAGline_compare (const void * a, const void * b)
 {
   const TAGline * aTAGline = (const TAGline *)a;
   const TAGline * bTAGline = (const TAGline *)b;
+  int result = strcmp (aTAGline->name, bTAGline->name);
 
-  return strcmp (aTAGline->name, bTAGline->name);
+  if (result == 0)
+    result = strcmp (aTAGline->filename, bTAGline->filename);
+  if (result == 0 && aTAGline->lineno != bTAGline->lineno)
+    result = aTAGline->lineno < bTAGline->lineno ? -1 : 1;
+  return result;
 }
 
 typedef struct {
   TAGline * array;
-  unsigned int size;
-  unsigned int capacity;
+  unsigned long size;
+  unsigned long capacity;
 } TAGlinearray;
 
 static TAGlinearray TAGlines = { NULL, 0, 0 };
 
+/* Makefile names arrive many times in a row; remember the last one
+   so that it is only looked up in the strcache when it changes */
+static const char * lastCachedFilename = NULL;
+
 void init_ctags_output (const char * filename)
 {
   TAGSfile = fopen (filename,"w");
 }
 
-void add_to_ctags (const char * name, const char * filename, unsigned long lineno)
+/** Adds a tag.  A define block is first recorded as a variable
+ * definition; tagging it again at the same place just changes
+ * the kind of that tag */
+void add_to_ctags (const char * name, const char * filename,
+                   unsigned long lineno, char kind)
 {
-  if (TAGSfile == NULL)
+  TAGline * last;
+
+  if (TAGSfile == NULL || filename == NULL)
     {
       return;
     }
 
-  if (TAGlines.capacity >= TAGlines.size)
-    {
-      unsigned int biggerCapacity = TAGlines.capacity + 512;
+  if (lastCachedFilename == NULL || !streq (filename, lastCachedFilename))
+    lastCachedFilename = strcache_add (filename);
 
-      TAGline * biggerArray  = (TAGline *) xmalloc (biggerCapacity * sizeof (TAGline));
-
-      if (TAGlines.array != NULL)
-        {
-          int i;
-          for (i = 0; i < TAGlines.capacity; ++i)
-            {
-              biggerArray[i] = TAGlines.array[i];
-            }
-
-          free (TAGlines.array);
-        }
+  last = TAGlines.size > 0 ? &TAGlines.array[TAGlines.size - 1] : NULL;
+  if (last != NULL && last->lineno == lineno
+      && last->filename == lastCachedFilename && streq (last->name, name))
+    {
+      last->kind = kind;
+      return;
+    }
 
-      TAGlines.array = biggerArray;
-      TAGlines.capacity = biggerCapacity;
+  if (TAGlines.size == TAGlines.capacity)
+    {
+      TAGlines.capacity = TAGlines.capacity ? TAGlines.capacity * 2 : 1024;
+      TAGlines.array = (TAGline *) xrealloc (TAGlines.array,
+                                             TAGlines.capacity * sizeof (TAGline));
     }
 
-  TAGlines.array[ TAGlines.size ].name = xstrdup (name);
-  TAGlines.array[ TAGlines.size ].filename = xstrdup (filename);
+  TAGlines.array[ TAGlines.size ].name = strcache_add (name);
+  TAGlines.array[ TAGlines.size ].filename = lastCachedFilename;
   TAGlines.array[ TAGlines.size ].lineno = lineno;
+  TAGlines.array[ TAGlines.size ].kind = kind;
 
   ++TAGlines.size;
 }
 
-void write_out_ctags ()
+/** Writes the tags sorted by name, with the extended format
+ * headers that tell editors they can binary-search the file */
+void write_out_ctags (void)
 {
+  struct outbuf out;
+  unsigned long i;
+
   if (TAGSfile == NULL)
     {
       return;
@@ -88,14 +109,28 @@ void write_out_ctags ()
 
   qsort (TAGlines.array, TAGlines.size, sizeof (TAGline), TAGline_compare);
 
-  int i;
+  outbuf_init (&out, TAGSfile);
+  outbuf_puts (&out, "!_TAG_FILE_FORMAT\t2\t/extended format/\n");
+  outbuf_puts (&out, "!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/\n");
+  outbuf_puts (&out, "!_TAG_PROGRAM_NAME\tmake-analyze\t//\n");
+
   for (i = 0; i < TAGlines.size; ++i)
     {
-      fprintf (TAGSfile, "%s\t%s\t%ld\n",
-               TAGlines.array[i].name,
-               TAGlines.array[i].filename,
-               TAGlines.array[i].lineno);
+      outbuf_puts (&out, TAGlines.array[i].name);
+      outbuf_putc (&out, '\t');
+      outbuf_puts (&out, TAGlines.array[i].filename);
+      outbuf_putc (&out, '\t');
+      outbuf_ulong (&out, TAGlines.array[i].lineno);
+      outbuf_puts (&out, ";\"\t");
+      outbuf_putc (&out, TAGlines.array[i].kind);
+      outbuf_putc (&out, '\n');
     }
 
+  outbuf_close (&out);
   fclose (TAGSfile);
+  TAGSfile = NULL;
+
+  free (TAGlines.array);
+  TAGlines.array = NULL;
+  TAGlines.size = TAGlines.capacity = 0;
 }
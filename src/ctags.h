@@ -11,7 +11,13 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/* Kinds of tags, written out as the "kind" field of extended ctags */
+#define CTAGS_VARIABLE 'v'
+#define CTAGS_DEFINE   'd'
+#define CTAGS_TARGET   't'
+#define CTAGS_INCLUDE  'i'
 
 void init_ctags_output (const char * filename);
-void add_to_ctags (const char * name, const char * filename, unsigned long lineno);
-void write_out_ctags ();
+void add_to_ctags (const char * name, const char * filename,
+                   unsigned long lineno, char kind);
+void write_out_ctags (void);
@@ -18,6 +18,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "hash.h"
 #include "filedef.h"
 #include "dep.h"
+#include "snapshot.h"
 
 #ifdef  HAVE_DIRENT_H
 # include <dirent.h>
@@ -1051,6 +1052,98 @@ file_impossible_p (const char *filename)
   return 0;
 }
 
+#if !defined(VMS) && !defined(HAVE_DOS_PATHS) && !defined(_AMIGA) \
+    && !defined(HAVE_CASE_INSENSITIVE_FS)
+
+/* Return nonzero if the directory of PREFIX, up to its last slash, has a
+   file that is known to exist whose name begins with the rest of PREFIX
+   and ends with SUFFIX, the two not overlapping.  The whole directory is
+   read in to find out.  SUFFIX must contain no slashes.  */
+
+int
+dir_has_file_like (const char *prefix, const char *suffix)
+{
+  struct directory_contents *dir;
+  struct dirfile **files;
+  struct dirfile **end;
+  const char *base;
+  const char *slash = strrchr (prefix, '/');
+  size_t baselen;
+  size_t suffixlen = strlen (suffix);
+
+  if (slash == 0)
+    {
+      dir = find_directory (".")->contents;
+      base = prefix;
+    }
+  else
+    {
+      char *dirname = alloca (slash - prefix + 2);
+      if (slash == prefix)
+        strcpy (dirname, "/");
+      else
+        {
+          memcpy (dirname, prefix, slash - prefix);
+          dirname[slash - prefix] = '\0';
+        }
+      dir = find_directory (dirname)->contents;
+      base = slash + 1;
+    }
+  baselen = strlen (base);
+
+  if (dir == 0 || dir->dirfiles.ht_vec == 0)
+    return 0;
+
+  /* Read in whatever is left of the directory.  */
+  if (dir->dirstream != 0)
+    dir_contents_file_exists_p (dir, 0);
+
+  files = (struct dirfile **) dir->dirfiles.ht_vec;
+  end = files + dir->dirfiles.ht_size;
+  for (; files < end; ++files)
+    {
+      const struct dirfile *df = *files;
+      if (!HASH_VACANT (df) && !df->impossible
+          && df->length >= baselen + suffixlen
+          && strneq (df->name, base, baselen)
+          && streq (df->name + df->length - suffixlen, suffix))
+        return 1;
+    }
+
+  return 0;
+}
+
+/* Call FN with the name and length of every file in DIRNAME that is known
+   to exist, and ARG.  The whole directory is read in first.  The names
+   are in the strcache.  */
+
+void
+dir_map_files (const char *dirname,
+               void (*fn) (const char *name, size_t length, void *arg),
+               void *arg)
+{
+  struct directory_contents *dir = find_directory (dirname)->contents;
+  struct dirfile **files;
+  struct dirfile **end;
+
+  if (dir == 0 || dir->dirfiles.ht_vec == 0)
+    return;
+
+  if (dir->dirstream != 0)
+    dir_contents_file_exists_p (dir, 0);
+
+  files = (struct dirfile **) dir->dirfiles.ht_vec;
+  end = files + dir->dirfiles.ht_size;
+  for (; files < end; ++files)
+    {
+      const struct dirfile *df = *files;
+      if (!HASH_VACANT (df) && !df->impossible)
+        fn (df->name, df->length, arg);
+    }
+}
+
+#endif
+
 /* Return the already allocated name in the
    directory hash table that matches DIR.  */
 
@@ -1189,7 +1282,11 @@ static __ptr_t
 open_dirstream (const char *directory)
 {
   struct dirstream *new;
-  struct directory *dir = find_directory (directory);
+  struct directory *dir;
+
+  /* A file added to or removed from it changes what glob finds.  */
+  snapshot_note_input (directory);
+  dir = find_directory (directory);
 
   if (dir->contents == 0 || dir->contents->dirfiles.ht_vec == 0)
     /* DIR->contents is nil if the directory could not be stat'd.
@@ -1329,6 +1426,21 @@ local_lstat (const char *path, struct stat *buf)
 }
 #endif
 
+/* What glob stats without reading a directory, it only tests for.  */
+static int
+glob_stat (const char *path, struct stat *buf)
+{
+  snapshot_note_input (path);
+  return local_stat (path, buf);
+}
+
+static int
+glob_lstat (const char *path, struct stat *buf)
+{
+  snapshot_note_input (path);
+  return local_lstat (path, buf);
+}
+
 void
 dir_setup_glob (glob_t *gl)
 {
@@ -1336,8 +1448,8 @@ dir_setup_glob (glob_t *gl)
   gl->gl_opendir = open_dirstream;
   gl->gl_readdir = read_dirstream;
   gl->gl_closedir = free;
-  gl->gl_lstat = local_lstat;
-  gl->gl_stat = local_stat;
+  gl->gl_lstat = glob_lstat;
+  gl->gl_stat = glob_stat;
 }
 
 void
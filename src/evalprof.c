@@ -0,0 +1,542 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "hash.h"
+#include "history.h"
+#include "jsonout.h"
+#include "evalprof.h"
+
+#include <stdio.h>
+
+/* How many locations the text report lists */
+#define EVALPROF_TOP 40
+
+enum profkind
+{
+  PROF_MAKEFILE,
+  PROF_LINE,
+  PROF_FUNCTION
+};
+
+struct profentry
+{
+  const char * file;            /* in the strcache, or NULL */
+  const char * function;        /* for PROF_FUNCTION */
+  unsigned long lineno;         /* 0 for PROF_MAKEFILE */
+  enum profkind kind;
+  unsigned long calls;
+  unsigned int active;          /* frames of it on the stack */
+  double self;                  /* seconds */
+  double inclusive;
+  unsigned long selfAllocations;
+  unsigned long inclusiveAllocations;
+};
+
+struct profframe
+{
+  struct profentry * entry;
+  double start;
+  double children;              /* seconds spent in nested frames */
+  unsigned long allocations;    /* allocation_count at the start */
+  unsigned long childAllocations;
+  size_t pathLength;            /* of the stack path up to this frame */
+};
+
+/* The self time of one distinct stack, for the folded output */
+struct profstack
+{
+  const char * path;
+  double self;
+};
+
+unsigned long allocation_count = 0;
+
+static int collecting = 0;
+static struct hash_table entries;
+static struct hash_table stacks;
+
+static struct profframe * frames = NULL;
+static unsigned int frameCount = 0;
+static unsigned int frameCapacity = 0;
+
+static char * path = NULL;
+static size_t pathLength = 0;
+static size_t pathCapacity = 0;
+
+static unsigned long profentry_hash_1 (const void * keyv)
+{
+  const struct profentry * key = (const struct profentry *) keyv;
+  return (((unsigned long) key->file >> 3) * 31 + key->lineno) * 7
+    + ((unsigned long) key->function >> 3) + key->kind;
+}
+
+static unsigned long profentry_hash_2 (const void * keyv)
+{
+  const struct profentry * key = (const struct profentry *) keyv;
+  return ((unsigned long) key->file >> 3) + key->lineno * 17
+    + ((unsigned long) key->function >> 4) * 5 + key->kind;
+}
+
+static int profentry_hash_cmp (const void * xv, const void * yv)
+{
+  const struct profentry * x = (const struct profentry *) xv;
+  const struct profentry * y = (const struct profentry *) yv;
+  if (x->kind != y->kind)
+    return x->kind < y->kind ? -1 : 1;
+  if (x->file != y->file)
+    return x->file < y->file ? -1 : 1;
+  if (x->lineno != y->lineno)
+    return x->lineno < y->lineno ? -1 : 1;
+  if (x->function != y->function)
+    return x->function < y->function ? -1 : 1;
+  return 0;
+}
+
+static unsigned long profstack_hash_1 (const void * keyv)
+{
+  const struct profstack * key = (const struct profstack *) keyv;
+  return_STRING_HASH_1 (key->path);
+}
+
+static unsigned long profstack_hash_2 (const void * keyv)
+{
+  const struct profstack * key = (const struct profstack *) keyv;
+  return_STRING_HASH_2 (key->path);
+}
+
+static int profstack_hash_cmp (const void * xv, const void * yv)
+{
+  const struct profstack * x = (const struct profstack *) xv;
+  const struct profstack * y = (const struct profstack *) yv;
+  return_STRING_COMPARE (x->path, y->path);
+}
+
+/** Appends the frame LABEL to the stack path, with any ';' in it
+ * (which separates the frames of a folded stack) replaced */
+static void path_append (const char * label)
+{
+  size_t len = strlen (label);
+  size_t i;
+
+  if (pathLength + len + 2 > pathCapacity)
+    {
+      pathCapacity = (pathLength + len + 2) * 2;
+      path = (char *) xrealloc (path, pathCapacity);
+    }
+  if (pathLength > 0)
+    path[pathLength++] = ';';
+  for (i = 0; i < len; ++i)
+    path[pathLength++] = label[i] == ';' ? ',' : label[i];
+  path[pathLength] = '\0';
+}
+
+/** Writes how ENTRY is shown in the report to BUF, which must hold
+ * at least strlen (file) + strlen (function) + 32 chars */
+static void format_entry (const struct profentry * entry, char * buf)
+{
+  const char * file = entry->file != NULL ? entry->file : _("(no makefile)");
+
+  switch (entry->kind)
+    {
+    case PROF_MAKEFILE:
+      strcpy (buf, file);
+      break;
+    case PROF_LINE:
+      sprintf (buf, "%s:%lu", file, entry->lineno);
+      break;
+    case PROF_FUNCTION:
+      if (entry->file != NULL)
+        sprintf (buf, "$(%s) %s:%lu", entry->function, file, entry->lineno);
+      else
+        sprintf (buf, "$(%s)", entry->function);
+      break;
+    }
+}
+
+static size_t entry_label_size (const struct profentry * entry)
+{
+  return strlen (entry->file != NULL ? entry->file : _("(no makefile)"))
+    + (entry->function != NULL ? strlen (entry->function) : 0) + 32;
+}
+
+static int profile_enter (enum profkind kind, const char * function,
+                          const char * file, unsigned long lineno)
+{
+  struct profentry key;
+  struct profentry ** slot;
+  struct profentry * entry;
+  struct profframe * frame;
+  char * label;
+
+  key.kind = kind;
+  key.function = function;
+  key.file = file != NULL ? strcache_add (file) : NULL;
+  key.lineno = lineno;
+  slot = (struct profentry **) hash_find_slot (&entries, &key);
+  if (HASH_VACANT (*slot))
+    {
+      entry = (struct profentry *) xcalloc (sizeof (struct profentry));
+      entry->kind = kind;
+      entry->function = function;
+      entry->file = key.file;
+      entry->lineno = lineno;
+      hash_insert_at (&entries, entry, slot);
+    }
+  else
+    entry = *slot;
+
+  ++entry->calls;
+  ++entry->active;
+
+  if (frameCount == frameCapacity)
+    {
+      frameCapacity = frameCapacity ? frameCapacity * 2 : 64;
+      frames = (struct profframe *) xrealloc (frames,
+                                              frameCapacity * sizeof (struct profframe));
+    }
+
+  frame = &frames[frameCount++];
+  frame->entry = entry;
+  frame->children = 0.0;
+  frame->childAllocations = 0;
+  frame->pathLength = pathLength;
+
+  label = alloca (entry_label_size (entry));
+  format_entry (entry, label);
+  path_append (label);
+
+  frame->allocations = allocation_count;
+  frame->start = recipe_clock ();
+  return 1;
+}
+
+void init_eval_profile (void)
+{
+  hash_init (&entries, 4096, profentry_hash_1, profentry_hash_2,
+             profentry_hash_cmp);
+  hash_init (&stacks, 4096, profstack_hash_1, profstack_hash_2,
+             profstack_hash_cmp);
+  collecting = 1;
+}
+
+int profile_makefile (const char * filename)
+{
+  if (!collecting)
+    {
+      return 0;
+    }
+  return profile_enter (PROF_MAKEFILE, NULL, filename, 0);
+}
+
+int profile_line (const floc * flocp)
+{
+  if (!collecting)
+    {
+      return 0;
+    }
+  return profile_enter (PROF_LINE, NULL, flocp->filenm, flocp->lineno);
+}
+
+int profile_function (const char * name)
+{
+  static const char * const profiled[] = {
+    "shell", "eval", "call", "wildcard", "foreach", NULL
+  };
+  unsigned int i;
+
+  if (!collecting)
+    {
+      return 0;
+    }
+
+  for (i = 0; profiled[i] != NULL; ++i)
+    if (streq (name, profiled[i]))
+      break;
+  if (profiled[i] == NULL)
+    return 0;
+
+  if (reading_file != NULL)
+    return profile_enter (PROF_FUNCTION, profiled[i], reading_file->filenm,
+                          reading_file->lineno);
+  return profile_enter (PROF_FUNCTION, profiled[i], NULL, 0);
+}
+
+/** Charges the time and allocations of the finished frame to its entry,
+ * to the enclosing frame and to the stack it ends */
+void profile_leave (void)
+{
+  struct profframe * frame;
+  struct profstack key;
+  struct profstack ** slot;
+  double elapsed;
+  unsigned long allocations;
+
+  if (!collecting || frameCount == 0)
+    {
+      return;
+    }
+
+  frame = &frames[--frameCount];
+  elapsed = recipe_clock () - frame->start;
+  allocations = allocation_count - frame->allocations;
+
+  frame->entry->self += elapsed - frame->children;
+  frame->entry->selfAllocations += allocations - frame->childAllocations;
+  if (--frame->entry->active == 0)
+    {
+      frame->entry->inclusive += elapsed;
+      frame->entry->inclusiveAllocations += allocations;
+    }
+  if (frameCount > 0)
+    {
+      frames[frameCount - 1].children += elapsed;
+      frames[frameCount - 1].childAllocations += allocations;
+    }
+
+  key.path = path;
+  slot = (struct profstack **) hash_find_slot (&stacks, &key);
+  if (HASH_VACANT (*slot))
+    {
+      struct profstack * stack = (struct profstack *) xmalloc (sizeof (struct profstack));
+      stack->path = xstrdup (path);
+      stack->self = 0.0;
+      hash_insert_at (&stacks, stack, slot);
+    }
+  (*slot)->self += elapsed - frame->children;
+
+  pathLength = frame->pathLength;
+  path[pathLength] = '\0';
+}
+
+/** Orders by decreasing self time, then by location */
+static int profentry_self_compare (const void * a, const void * b)
+{
+  const struct profentry * x = *(const struct profentry * const *) a;
+  const struct profentry * y = *(const struct profentry * const *) b;
+  int result;
+
+  if (x->self != y->self)
+    return x->self < y->self ? 1 : -1;
+  if (x->file != y->file)
+    {
+      if (x->file == NULL || y->file == NULL)
+        return x->file == NULL ? 1 : -1;
+      result = strcmp (x->file, y->file);
+      if (result)
+        return result;
+    }
+  if (x->lineno != y->lineno)
+    return x->lineno < y->lineno ? -1 : 1;
+  if (x->kind != y->kind)
+    return x->kind < y->kind ? -1 : 1;
+  if (x->function != y->function)
+    return strcmp (x->function, y->function);
+  return 0;
+}
+
+/** Orders by decreasing inclusive time */
+static int profentry_inclusive_compare (const void * a, const void * b)
+{
+  const struct profentry * x = *(const struct profentry * const *) a;
+  const struct profentry * y = *(const struct profentry * const *) b;
+  if (x->inclusive != y->inclusive)
+    return x->inclusive < y->inclusive ? 1 : -1;
+  return profentry_self_compare (a, b);
+}
+
+static int profstack_path_compare (const void * a, const void * b)
+{
+  const struct profstack * x = *(const struct profstack * const *) a;
+  const struct profstack * y = *(const struct profstack * const *) b;
+  return strcmp (x->path, y->path);
+}
+
+static void free_stack (const void * item)
+{
+  const struct profstack * stack = (const struct profstack *) item;
+  free ((char *) stack->path);
+}
+
+static const char * kind_name (enum profkind kind)
+{
+  switch (kind)
+    {
+    case PROF_MAKEFILE:
+      return "makefile";
+    case PROF_LINE:
+      return "line";
+    default:
+      return "function";
+    }
+}
+
+/** Writes the stacks in the folded format flamegraph tools read, with
+ * the self time of each in whole microseconds */
+static void write_folded (const char * filename)
+{
+  struct profstack ** all;
+  unsigned long count = stacks.ht_fill;
+  unsigned long i;
+  struct outbuf ob;
+  const char * foldedName = concat (2, filename, ".folded");
+  FILE * f = fopen (foldedName, "w");
+
+  if (f == NULL)
+    {
+      perror_with_name (_("fopen (folded stacks file): "), foldedName);
+      return;
+    }
+
+  all = (struct profstack **) hash_dump (&stacks, NULL, profstack_path_compare);
+  outbuf_init (&ob, f);
+  for (i = 0; i < count; ++i)
+    {
+      unsigned long microseconds = (unsigned long) (all[i]->self * 1e6 + 0.5);
+      if (microseconds == 0)
+        continue;
+      outbuf_puts (&ob, all[i]->path);
+      outbuf_putc (&ob, ' ');
+      outbuf_ulong (&ob, microseconds);
+      outbuf_putc (&ob, '\n');
+    }
+  outbuf_close (&ob);
+  fclose (f);
+  free (all);
+}
+
+static void print_entries (struct profentry ** list, unsigned long count)
+{
+  unsigned long i;
+
+  printf (_("  %10s %10s %8s %11s %11s  %s\n"), _("self s"), _("total s"),
+          _("calls"), _("self allocs"), _("allocs"), _("location"));
+  for (i = 0; i < count; ++i)
+    {
+      char * label = alloca (entry_label_size (list[i]));
+      format_entry (list[i], label);
+      printf ("  %10.6f %10.6f %8lu %11lu %11lu  %s\n", list[i]->self,
+              list[i]->inclusive, list[i]->calls,
+              list[i]->selfAllocations, list[i]->inclusiveAllocations,
+              label);
+    }
+}
+
+/** Reports every location by decreasing self time.  Frames still open,
+ * when make dies while reading a makefile, are not counted */
+void report_eval_profile (const char * filename)
+{
+  struct profentry ** all;
+  struct profentry ** makefiles;
+  unsigned long count;
+  unsigned long makefileCount = 0;
+  unsigned long i;
+  double total = 0.0;
+  struct json_writer w;
+  FILE * f;
+
+  if (!collecting)
+    {
+      return;
+    }
+  while (frameCount > 0)
+    profile_leave ();
+  collecting = 0;
+
+  count = entries.ht_fill;
+  all = (struct profentry **) hash_dump (&entries, NULL, profentry_self_compare);
+  makefiles = (struct profentry **) xmalloc ((count + 1) * sizeof (struct profentry *));
+  for (i = 0; i < count; ++i)
+    if (all[i]->kind == PROF_MAKEFILE)
+      makefiles[makefileCount++] = all[i];
+  qsort (makefiles, makefileCount, sizeof (struct profentry *),
+         profentry_inclusive_compare);
+  for (i = 0; i < count; ++i)
+    total += all[i]->self;
+
+  if (streq (filename, "-"))
+    {
+      printf (_("Evaluation profile: %lu locations, %.6f seconds\n"),
+              count, total);
+      printf (_("Makefiles by total time:\n"));
+      print_entries (makefiles,
+                     makefileCount < EVALPROF_TOP ? makefileCount : EVALPROF_TOP);
+      printf (_("Locations by self time:\n"));
+      print_entries (all, count < EVALPROF_TOP ? count : EVALPROF_TOP);
+      goto done;
+    }
+
+  f = fopen (filename, "w");
+  if (f == NULL)
+    {
+      perror_with_name (_("fopen (evaluation profile file): "), filename);
+      goto done;
+    }
+  json_init (&w, f, 0);
+  json_begin_object (&w);
+  json_key (&w, "total_seconds");
+  json_double (&w, total);
+  json_key (&w, "locations");
+  json_begin_array (&w);
+  for (i = 0; i < count; ++i)
+    {
+      json_begin_object (&w);
+      json_key (&w, "kind");
+      json_string (&w, kind_name (all[i]->kind));
+      json_key (&w, "file");
+      if (all[i]->file != NULL)
+        json_string (&w, all[i]->file);
+      else
+        json_null (&w);
+      if (all[i]->kind != PROF_MAKEFILE)
+        {
+          json_key (&w, "line");
+          json_ulong (&w, all[i]->lineno);
+        }
+      if (all[i]->kind == PROF_FUNCTION)
+        {
+          json_key (&w, "function");
+          json_string (&w, all[i]->function);
+        }
+      json_key (&w, "calls");
+      json_ulong (&w, all[i]->calls);
+      json_key (&w, "self_seconds");
+      json_double (&w, all[i]->self);
+      json_key (&w, "inclusive_seconds");
+      json_double (&w, all[i]->inclusive);
+      json_key (&w, "self_allocations");
+      json_ulong (&w, all[i]->selfAllocations);
+      json_key (&w, "inclusive_allocations");
+      json_ulong (&w, all[i]->inclusiveAllocations);
+      json_end_object (&w);
+    }
+  json_end_array (&w);
+  json_end_object (&w);
+  json_finish (&w);
+  fclose (f);
+
+  write_folded (filename);
+
+ done:
+  free (makefiles);
+  free (all);
+  hash_map (&stacks, free_stack);
+  hash_free (&stacks, 1);
+  hash_free (&entries, 1);
+  free (frames);
+  frames = NULL;
+  frameCount = frameCapacity = 0;
+  free (path);
+  path = NULL;
+  pathLength = pathCapacity = 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A profile of reading the makefiles: the time and the allocations spent
+   in each makefile, on each line eval () runs and in each $(shell),
+   $(eval), $(call), $(wildcard) and $(foreach), all keyed by the makefile
+   location they come from.  Every call below that starts a frame returns
+   nonzero if it did; a frame that was started must be ended with
+   profile_leave ().  When the profile is not being collected nothing is
+   started.  */
+
+/* Calls made to the allocating functions of misc.c so far */
+extern unsigned long allocation_count;
+
+void init_eval_profile (void);
+
+int profile_makefile (const char * filename);
+int profile_line (const floc * flocp);
+
+/* Starts a frame for the builtin function NAME if it is one of those
+   profiled, at the location of the makefile line being read, if any */
+int profile_function (const char * name);
+
+void profile_leave (void);
+
+/* If filename is "-" the flat profile is printed as text on stdout,
+   otherwise it is written to filename as JSON and the folded stacks,
+   one "frame;frame;... microseconds" line each, to filename.folded */
+void report_eval_profile (const char * filename);
@@ -23,6 +23,9 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "commands.h"
 #include "variable.h"
 #include "rule.h"
+#include "hash.h"
+#include "varrefs.h"
+#include "expcost.h"
 
 /* Initially, any errors reported when expanding strings will be reported
    against the file where the error appears.  */
@@ -88,18 +91,25 @@ initialize_variable_output (void)
   return variable_buffer;
 }
 
-/* Recursively expand V.  The returned string is malloc'd.  */
-
 static char *allocated_variable_append (const struct variable *v);
+static char *value_expand (char *line, const struct variable *v);
 
-char *
-recursively_expand_for_file (struct variable *v, struct file *file)
+/* Recursively expand V into the variable buffer at O, using FILE's
+   variables if FILE is not nil.  The result is null-terminated; the
+   returned pointer is to its end.  References to V are expanded this way
+   so that V's value is written once, where it is wanted, rather than
+   into a buffer of its own and then copied.  */
+
+static char *
+recursively_expand_into (char *o, struct variable *v, struct file *file)
 {
   char *value;
+  size_t offset;
   const floc *this_var;
   const floc **saved_varp;
   struct variable_set_list *save = 0;
   int set_reading = 0;
+  double start;
 
   /* Don't install a new location if this location is empty.
      This can happen for command-line variables, builtin variables, etc.  */
@@ -133,12 +143,23 @@ recursively_expand_for_file (struct variable *v, struct file *file)
       current_variable_set_list = file->variables;
     }
 
+  push_variable_expansion (v->name);
+  start = expansion_cost_start ();
   v->expanding = 1;
+  offset = o - variable_buffer;
   if (v->append)
-    value = allocated_variable_append (v);
+    {
+      /* The appended parts are joined from the start of a buffer.  */
+      value = allocated_variable_append (v);
+      o = variable_buffer_output (o, value, strlen (value) + 1);
+      free (value);
+    }
   else
-    value = allocated_variable_expand (v->value);
+    value_expand (o, v);
   v->expanding = 0;
+  value = variable_buffer + offset;
+  record_expansion_cost (v, value, start);
+  pop_variable_expansion ();
 
   if (set_reading)
     reading_file = 0;
@@ -148,6 +169,27 @@ recursively_expand_for_file (struct variable *v, struct file *file)
 
   expanding_var = saved_varp;
 
+  return value + strlen (value);
+}
+
+/* Recursively expand V.  The returned string is malloc'd.  */
+
+char *
+recursively_expand_for_file (struct variable *v, struct file *file)
+{
+  char *value;
+
+  char *obuf = variable_buffer;
+  size_t olen = variable_buffer_length;
+
+  variable_buffer = 0;
+
+  recursively_expand_into (initialize_variable_output (), v, file);
+  value = variable_buffer;
+
+  variable_buffer = obuf;
+  variable_buffer_length = olen;
+
   return value;
 }
 
@@ -157,12 +199,12 @@ recursively_expand_for_file (struct variable *v, struct file *file)
 __inline
 #endif
 static char *
-reference_variable (char *o, const char *name, size_t length)
+reference_variable (char *o, const char *name, size_t length, int computed)
 {
   struct variable *v;
-  char *value;
 
   v = lookup_variable (name, length);
+  record_variable_reference (name, length, v != 0, computed);
 
   if (v == 0)
     warn_undefined (name, length);
@@ -171,16 +213,107 @@ reference_variable (char *o, const char *name, size_t length)
   if (v == 0 || (*v->value == '\0' && !v->append))
     return o;
 
-  value = (v->recursive ? recursively_expand (v) : v->value);
+  if (v->recursive)
+    return recursively_expand_into (o, v, NULL);
 
-  o = variable_buffer_output (o, value, strlen (value));
+  return variable_buffer_output (o, v->value, strlen (v->value));
+}
+
+/* Expand the reference whose name (with variable references inside it
+   already expanded) runs from BEG to END: either a substitution reference
+   such as $(FOO:A=B) or the value of a variable.  COMPUTED is nonzero if
+   the name was itself the result of an expansion.  */
 
-  if (v->recursive)
-    free (value);
+static char *
+expand_reference (char *o, const char *beg, const char *end, int computed)
+{
+  struct variable *v;
+  const char *colon;
+
+  /* This is not a reference to a built-in function and
+     any variable references inside are now expanded.
+     Is the resultant text a substitution reference?  */
+
+  colon = lindex (beg, end, ':');
+  if (colon)
+    {
+      /* This looks like a substitution reference: $(FOO:A=B).  */
+      const char *subst_beg = colon + 1;
+      const char *subst_end = lindex (subst_beg, end, '=');
+      if (subst_end == 0)
+        /* There is no = in sight.  Punt on the substitution
+           reference and treat this as a variable name containing
+           a colon, in the code below.  */
+        colon = 0;
+      else
+        {
+          const char *replace_beg = subst_end + 1;
+          const char *replace_end = end;
+
+          /* Extract the variable name before the colon
+             and look up that variable.  */
+          v = lookup_variable (beg, colon - beg);
+          record_variable_reference (beg, colon - beg, v != 0, computed);
+          if (v == 0)
+            warn_undefined (beg, colon - beg);
+
+          /* If the variable is not empty, perform the
+             substitution.  */
+          if (v != 0 && *v->value != '\0')
+            {
+              char *pattern, *replace, *ppercent, *rpercent;
+              char *value = (v->recursive
+                             ? recursively_expand (v)
+                             : v->value);
+
+              /* Copy the pattern and the replacement.  Add in an
+                 extra % at the beginning to use in case there
+                 isn't one in the pattern.  */
+              pattern = alloca (subst_end - subst_beg + 2);
+              *(pattern++) = '%';
+              memcpy (pattern, subst_beg, subst_end - subst_beg);
+              pattern[subst_end - subst_beg] = '\0';
+
+              replace = alloca (replace_end - replace_beg + 2);
+              *(replace++) = '%';
+              memcpy (replace, replace_beg, replace_end - replace_beg);
+              replace[replace_end - replace_beg] = '\0';
+
+              /* Look for %.  Set the percent pointers properly
+                 based on whether we find one or not.  */
+              ppercent = find_percent (pattern);
+              if (ppercent)
+                {
+                  ++ppercent;
+                  rpercent = find_percent (replace);
+                  if (rpercent)
+                    ++rpercent;
+                }
+              else
+                {
+                  ppercent = pattern;
+                  rpercent = replace;
+                  --pattern;
+                  --replace;
+                }
+
+              o = patsubst_expand_pat (o, value, pattern, replace,
+                                       ppercent, rpercent);
+
+              if (v->recursive)
+                free (value);
+            }
+        }
+    }
+
+  if (colon == 0)
+    /* This is an ordinary variable reference.
+       Look up the value of the variable.  */
+    o = reference_variable (o, beg, end - beg, computed);
 
   return o;
 }
-
+
 /* Scan STRING for variable references and expansion-function calls.  Only
    LENGTH bytes of STRING are actually scanned.  If LENGTH is -1, scan until
    a null byte is found.
@@ -193,7 +326,6 @@ reference_variable (char *o, const char *name, size_t length)
 char *
 variable_expand_string (char *line, const char *string, size_t length)
 {
-  struct variable *v;
   const char *p, *p1;
   char *save;
   char *o;
@@ -251,7 +383,7 @@ variable_expand_string (char *line, const char *string, size_t length)
             const char *beg = p + 1;
             char *op;
             char *abeg = NULL;
-            const char *end, *colon;
+            const char *end;
 
             op = o;
             begp = p;
@@ -298,87 +430,7 @@ variable_expand_string (char *line, const char *string, size_t length)
                  continue the scan.  */
               p = end;
 
-            /* This is not a reference to a built-in function and
-               any variable references inside are now expanded.
-               Is the resultant text a substitution reference?  */
-
-            colon = lindex (beg, end, ':');
-            if (colon)
-              {
-                /* This looks like a substitution reference: $(FOO:A=B).  */
-                const char *subst_beg = colon + 1;
-                const char *subst_end = lindex (subst_beg, end, '=');
-                if (subst_end == 0)
-                  /* There is no = in sight.  Punt on the substitution
-                     reference and treat this as a variable name containing
-                     a colon, in the code below.  */
-                  colon = 0;
-                else
-                  {
-                    const char *replace_beg = subst_end + 1;
-                    const char *replace_end = end;
-
-                    /* Extract the variable name before the colon
-                       and look up that variable.  */
-                    v = lookup_variable (beg, colon - beg);
-                    if (v == 0)
-                      warn_undefined (beg, colon - beg);
-
-                    /* If the variable is not empty, perform the
-                       substitution.  */
-                    if (v != 0 && *v->value != '\0')
-                      {
-                        char *pattern, *replace, *ppercent, *rpercent;
-                        char *value = (v->recursive
-                                       ? recursively_expand (v)
-                                       : v->value);
-
-                        /* Copy the pattern and the replacement.  Add in an
-                           extra % at the beginning to use in case there
-                           isn't one in the pattern.  */
-                        pattern = alloca (subst_end - subst_beg + 2);
-                        *(pattern++) = '%';
-                        memcpy (pattern, subst_beg, subst_end - subst_beg);
-                        pattern[subst_end - subst_beg] = '\0';
-
-                        replace = alloca (replace_end - replace_beg + 2);
-                        *(replace++) = '%';
-                        memcpy (replace, replace_beg,
-                               replace_end - replace_beg);
-                        replace[replace_end - replace_beg] = '\0';
-
-                        /* Look for %.  Set the percent pointers properly
-                           based on whether we find one or not.  */
-                        ppercent = find_percent (pattern);
-                        if (ppercent)
-                          {
-                            ++ppercent;
-                            rpercent = find_percent (replace);
-                            if (rpercent)
-                              ++rpercent;
-                          }
-                        else
-                          {
-                            ppercent = pattern;
-                            rpercent = replace;
-                            --pattern;
-                            --replace;
-                          }
-
-                        o = patsubst_expand_pat (o, value, pattern, replace,
-                                                 ppercent, rpercent);
-
-                        if (v->recursive)
-                          free (value);
-                      }
-                  }
-              }
-
-            if (colon == 0)
-              /* This is an ordinary variable reference.
-                 Look up the value of the variable.  */
-                o = reference_variable (o, beg, end - beg);
-
+            o = expand_reference (o, beg, end, abeg != NULL);
             free (abeg);
           }
           break;
@@ -389,7 +441,7 @@ variable_expand_string (char *line, const char *string, size_t length)
 
           /* A $ followed by a random char is a variable reference:
              $a is equivalent to $(a).  */
-          o = reference_variable (o, p, 1);
+          o = reference_variable (o, p, 1, 0);
 
           break;
         }
@@ -417,6 +469,371 @@ variable_expand (const char *line)
   return variable_expand_string (NULL, line, SIZE_MAX);
 }
 
+/* A string parsed once into the steps expanding it takes, so that strings
+   expanded over and over, such as the values of recursively expanded
+   variables, are not scanned for references and function calls each
+   time.  Each step does what variable_expand_string does on reaching the
+   same text.  A string that variable_expand_string would find an error
+   in is not compiled, and expanding it reports the error as usual.  */
+
+enum expansion_op
+  {
+    EXP_TEXT,                   /* Copy TEXT.  */
+    EXP_VARIABLE,               /* $x  */
+    EXP_REFERENCE,              /* $(TEXT), maybe a substitution reference.  */
+    EXP_COMPUTED,               /* A reference whose name has references.  */
+    EXP_FUNCTION                /* A builtin function call.  */
+  };
+
+struct expansion_step
+  {
+    enum expansion_op op;
+    const char *text;           /* Points into the program's source.  */
+    size_t length;
+    struct expansion_program *name;
+    struct function_call *call;
+  };
+
+struct expansion_program
+  {
+    char *source;
+    unsigned int refs;          /* Holders, and expansions running it.  */
+    unsigned int compiled:1;    /* If zero, SOURCE is expanded as usual.  */
+    unsigned int count;
+    unsigned int capacity;
+    struct expansion_step *steps;
+  };
+
+static struct expansion_step *
+add_step (struct expansion_program *program, enum expansion_op op)
+{
+  struct expansion_step *step;
+
+  if (program->count == program->capacity)
+    {
+      program->capacity = program->capacity ? program->capacity * 2 : 4;
+      program->steps = xrealloc (program->steps,
+                                 program->capacity * sizeof (*step));
+    }
+
+  step = &program->steps[program->count++];
+  memset (step, 0, sizeof (*step));
+  step->op = op;
+  return step;
+}
+
+/* Add LENGTH chars of literal TEXT, joining them to the previous step if
+   it copies the text just before.  */
+
+static void
+add_text (struct expansion_program *program, const char *text, size_t length)
+{
+  struct expansion_step *last = (program->count > 0
+                                 ? &program->steps[program->count - 1] : 0);
+
+  if (length == 0)
+    return;
+  if (last && last->op == EXP_TEXT && last->text + last->length == text)
+    last->length += length;
+  else
+    {
+      last = add_step (program, EXP_TEXT);
+      last->text = text;
+      last->length = length;
+    }
+}
+
+static void
+free_steps (struct expansion_program *program)
+{
+  unsigned int i;
+
+  for (i = 0; i < program->count; ++i)
+    {
+      if (program->steps[i].name)
+        release_expansion (program->steps[i].name);
+      if (program->steps[i].call)
+        free_function_call (program->steps[i].call);
+    }
+  free (program->steps);
+  program->steps = 0;
+  program->count = program->capacity = 0;
+}
+
+/* Parse LENGTH chars of STRING, following variable_expand_string.
+   The returned program is released with release_expansion.  */
+
+struct expansion_program *
+compile_expansion (const char *string, size_t length)
+{
+  struct expansion_program *program = xcalloc (sizeof (*program));
+  const char *p, *p1;
+
+  program->source = xstrndup (string, length);
+  program->refs = 1;
+
+  p = program->source;
+  while (1)
+    {
+      p1 = strchr (p, '$');
+      add_text (program, p, p1 != 0 ? (size_t) (p1 - p) : strlen (p));
+      if (p1 == 0)
+        break;
+      p = p1 + 1;
+
+      switch (*p)
+        {
+        case '$':
+        case '\0':
+          add_text (program, p1, 1);
+          break;
+
+        case '(':
+        case '{':
+          {
+            char openparen = *p;
+            char closeparen = (openparen == '(') ? ')' : '}';
+            const char *beg = p + 1;
+            const char *end;
+            struct function_call *call;
+            struct expansion_step *step;
+
+            if (compile_function_call (p, &end, &call))
+              {
+                if (call == 0)
+                  goto uncompiled;
+                add_step (program, EXP_FUNCTION)->call = call;
+                p = end;
+                break;
+              }
+
+            end = strchr (beg, closeparen);
+            if (end == 0)
+              goto uncompiled;
+            if (lindex (beg, end, '$') != 0)
+              {
+                int count = 0;
+                for (p = beg; *p != '\0'; ++p)
+                  {
+                    if (*p == openparen)
+                      ++count;
+                    else if (*p == closeparen && --count < 0)
+                      break;
+                  }
+                /* Leave '$($(a)' to variable_expand_string.  */
+                if (count >= 0)
+                  goto uncompiled;
+                step = add_step (program, EXP_COMPUTED);
+                step->name = compile_expansion (beg, p - beg);
+              }
+            else
+              {
+                p = end;
+                step = add_step (program, EXP_REFERENCE);
+                step->text = beg;
+                step->length = end - beg;
+              }
+          }
+          break;
+
+        default:
+          {
+            struct expansion_step *step = add_step (program, EXP_VARIABLE);
+            step->text = p;
+            step->length = 1;
+          }
+          break;
+        }
+
+      if (*p == '\0')
+        break;
+
+      ++p;
+    }
+
+  program->compiled = 1;
+  return program;
+
+ uncompiled:
+  free_steps (program);
+  return program;
+}
+
+void
+release_expansion (struct expansion_program *program)
+{
+  if (--program->refs > 0)
+    return;
+
+  free_steps (program);
+  free (program->source);
+  free (program);
+}
+
+/* Run PROGRAM, writing the result to LINE as variable_expand_string does
+   for the program's source.  */
+
+char *
+expand_program (char *line, struct expansion_program *program)
+{
+  size_t line_offset;
+  unsigned int i;
+  char *o;
+
+  if (!program->compiled)
+    return variable_expand_string (line, program->source, SIZE_MAX);
+
+  if (!line)
+    line = initialize_variable_output ();
+  o = line;
+  line_offset = line - variable_buffer;
+
+  /* An eval may redefine the variable whose program this is.  */
+  ++program->refs;
+
+  for (i = 0; i < program->count; ++i)
+    {
+      const struct expansion_step *step = &program->steps[i];
+
+      switch (step->op)
+        {
+        case EXP_TEXT:
+          o = variable_buffer_output (o, step->text, step->length);
+          break;
+
+        case EXP_VARIABLE:
+          o = reference_variable (o, step->text, step->length, 0);
+          break;
+
+        case EXP_REFERENCE:
+          o = expand_reference (o, step->text, step->text + step->length, 0);
+          break;
+
+        case EXP_COMPUTED:
+          {
+            char *name = allocated_expand_program (step->name);
+            o = expand_reference (o, name, name + strlen (name), 1);
+            free (name);
+          }
+          break;
+
+        case EXP_FUNCTION:
+          o = run_function_call (o, step->call);
+          break;
+        }
+    }
+
+  release_expansion (program);
+
+  variable_buffer_output (o, "", 1);
+  return (variable_buffer + line_offset);
+}
+
+/* Like allocated_variable_expand, for a compiled string.  */
+
+char *
+allocated_expand_program (struct expansion_program *program)
+{
+  char *value;
+
+  char *obuf = variable_buffer;
+  size_t olen = variable_buffer_length;
+
+  variable_buffer = 0;
+
+  value = expand_program (NULL, program);
+
+  variable_buffer = obuf;
+  variable_buffer_length = olen;
+
+  return value;
+}
+
+/* The program of the value of each recursively expanded variable that was
+   expanded more than once.  A program is kept for as long as the value it
+   was compiled from, and the builtin functions, stay the same.  */
+
+struct compiled_value
+  {
+    const struct variable *variable;
+    struct expansion_program *program;
+    unsigned long functions;    /* function_table_changenum then.  */
+    unsigned int expanded:1;    /* Expanded before, without a program.  */
+  };
+
+static struct hash_table compiled_values;
+
+static unsigned long
+compiled_value_hash_1 (const void *key)
+{
+  return (unsigned long) ((const struct compiled_value *) key)->variable >> 3;
+}
+
+static unsigned long
+compiled_value_hash_2 (const void *key)
+{
+  return (unsigned long) ((const struct compiled_value *) key)->variable >> 5;
+}
+
+static int
+compiled_value_hash_cmp (const void *x, const void *y)
+{
+  const struct variable *vx = ((const struct compiled_value *) x)->variable;
+  const struct variable *vy = ((const struct compiled_value *) y)->variable;
+  return vx == vy ? 0 : vx < vy ? -1 : 1;
+}
+
+/* Expand the value of the recursively expanded variable V into LINE, as
+   variable_expand_string would.  The value is compiled the second time it
+   is expanded.  */
+
+static char *
+value_expand (char *line, const struct variable *v)
+{
+  struct compiled_value key;
+  struct compiled_value **slot;
+  struct compiled_value *cv;
+
+  if (compiled_values.ht_vec == 0)
+    hash_init (&compiled_values, 1024, compiled_value_hash_1,
+               compiled_value_hash_2, compiled_value_hash_cmp);
+
+  key.variable = v;
+  slot = (struct compiled_value **) hash_find_slot (&compiled_values, &key);
+  if (HASH_VACANT (*slot))
+    {
+      cv = xcalloc (sizeof (struct compiled_value));
+      cv->variable = v;
+      hash_insert_at (&compiled_values, cv, slot);
+    }
+  else
+    cv = *slot;
+
+  /* The variable may have been given a new value, or freed and its
+     memory reused for another one.  */
+  if (cv->program
+      && (cv->functions != function_table_changenum
+          || !streq (cv->program->source, v->value)))
+    {
+      release_expansion (cv->program);
+      cv->program = 0;
+      cv->expanded = 0;
+    }
+
+  if (!cv->program)
+    {
+      if (!cv->expanded)
+        {
+          cv->expanded = 1;
+          return variable_expand_string (line, v->value, SIZE_MAX);
+        }
+      cv->program = compile_expansion (v->value, strlen (v->value));
+      cv->functions = function_table_changenum;
+    }
+
+  return expand_program (line, cv->program);
+}
+
 /* Expand an argument for an expansion function.
    The text starting at STR and ending at END is variable-expanded
    into a null-terminated string that is returned as the value.
@@ -426,26 +843,25 @@ variable_expand (const char *line)
 char *
 expand_argument (const char *str, const char *end)
 {
-  char *tmp, *alloc = NULL;
   char *r;
 
+  char *obuf = variable_buffer;
+  size_t olen = variable_buffer_length;
+
   if (str == end)
     return xstrdup ("");
 
-  if (!end || *end == '\0')
-    return allocated_variable_expand (str);
+  /* variable_expand_string makes its own copy of the text it scans, so
+     the argument need not be copied out to be terminated.  */
+  variable_buffer = 0;
 
-  if (end - str + 1 > 1000)
-    tmp = alloc = xmalloc (end - str + 1);
+  if (!end || *end == '\0')
+    r = variable_expand_string (NULL, str, SIZE_MAX);
   else
-    tmp = alloca (end - str + 1);
-
-  memcpy (tmp, str, end - str);
-  tmp[end - str] = '\0';
+    r = variable_expand_string (NULL, str, end - str);
 
-  r = allocated_variable_expand (tmp);
-
-  free (alloc);
+  variable_buffer = obuf;
+  variable_buffer_length = olen;
 
   return r;
 }
@@ -0,0 +1,510 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "variable.h"
+#include "hash.h"
+#include "history.h"
+#include "jsonout.h"
+#include "vardefs.h"
+#include "expcost.h"
+
+#include <stdio.h>
+
+/* How many variables each list of the text report shows */
+#define EXPCOST_TOP 40
+
+/* Functions found in a variable's value */
+#define CALLS_SHELL         0x01
+#define CALLS_WILDCARD      0x02
+#define HAS_SIDE_EFFECTS    0x04  /* $(eval), $(file), $(info)... */
+
+/* How deep references are followed through recursive variables when
+   looking for one defined after the variable referring to it */
+#define EXPCOST_REFERENCE_DEPTH 16
+
+/* One definition of a recursively expanded variable */
+struct expvar
+{
+  const char * name;            /* in the strcache */
+  const char * file;            /* in the strcache, or NULL */
+  unsigned long lineno;
+  unsigned char origin;
+  unsigned int per_target:1;
+  unsigned int varied:1;        /* two expansions gave different values */
+  unsigned int functions;       /* CALLS_* and HAS_SIDE_EFFECTS */
+  const char * scanned;         /* the value the functions were taken from */
+  char * text;                  /* a copy of it */
+  char * first;                 /* the value of the first expansion */
+  unsigned long sequence;        /* of the definition, in reading order */
+  unsigned int refers_later:1;  /* references a variable defined after it */
+  unsigned long expansions;
+  double seconds;               /* including the variables it expanded */
+  double self;                  /* leaving them out */
+};
+
+/* The last definition of a global variable, in reading order */
+struct expdef
+{
+  const char * name;            /* in the strcache */
+  unsigned long sequence;
+};
+
+static int collecting = 0;
+static struct hash_table variables;
+static struct hash_table definitions;
+static unsigned long definitionCount = 0;
+
+/* For every expansion under way, innermost last, the time spent so far
+   in the expansions nested in it */
+static double * nested = NULL;
+static unsigned int nestedDepth = 0;
+static unsigned int nestedSize = 0;
+
+static unsigned long expdef_hash_1 (const void * keyv)
+{
+  const struct expdef * key = (const struct expdef *) keyv;
+  return_STRING_HASH_1 (key->name);
+}
+
+static unsigned long expdef_hash_2 (const void * keyv)
+{
+  const struct expdef * key = (const struct expdef *) keyv;
+  return_STRING_HASH_2 (key->name);
+}
+
+static int expdef_hash_cmp (const void * xv, const void * yv)
+{
+  const struct expdef * x = (const struct expdef *) xv;
+  const struct expdef * y = (const struct expdef *) yv;
+  return_STRING_COMPARE (x->name, y->name);
+}
+
+static unsigned long expvar_hash_1 (const void * keyv)
+{
+  const struct expvar * key = (const struct expvar *) keyv;
+  return ((unsigned long) key->name >> 3) * 31
+    + ((unsigned long) key->file >> 3) + key->lineno;
+}
+
+static unsigned long expvar_hash_2 (const void * keyv)
+{
+  const struct expvar * key = (const struct expvar *) keyv;
+  return ((unsigned long) key->name >> 4) + key->lineno * 17
+    + ((unsigned long) key->file >> 4) * 7;
+}
+
+static int expvar_hash_cmp (const void * xv, const void * yv)
+{
+  const struct expvar * x = (const struct expvar *) xv;
+  const struct expvar * y = (const struct expvar *) yv;
+  if (x->name != y->name)
+    return x->name < y->name ? -1 : 1;
+  if (x->file != y->file)
+    return x->file < y->file ? -1 : 1;
+  if (x->lineno != y->lineno)
+    return x->lineno < y->lineno ? -1 : 1;
+  return 0;
+}
+
+/** Finds the functions VALUE calls directly, written as $(name ...)
+ * or ${name ...} */
+static unsigned int find_functions (const char * value)
+{
+  static const struct
+  {
+    const char * name;
+    unsigned int flag;
+  } known[] = {
+    { "shell", CALLS_SHELL },
+    { "wildcard", CALLS_WILDCARD },
+    { "eval", HAS_SIDE_EFFECTS },
+    { "file", HAS_SIDE_EFFECTS },
+    { "info", HAS_SIDE_EFFECTS },
+    { "warning", HAS_SIDE_EFFECTS },
+    { "error", HAS_SIDE_EFFECTS },
+    { NULL, 0 }
+  };
+  unsigned int found = 0;
+  const char * p = value;
+
+  while ((p = strchr (p, '$')) != NULL)
+    {
+      unsigned int i;
+
+      ++p;
+      if (*p != '(' && *p != '{')
+        {
+          if (*p == '$')
+            ++p;
+          continue;
+        }
+      ++p;
+      for (i = 0; known[i].name != NULL; ++i)
+        {
+          size_t len = strlen (known[i].name);
+          if (strncmp (p, known[i].name, len) == 0 && ISBLANK (p[len]))
+            found |= known[i].flag;
+        }
+    }
+  return found;
+}
+
+void init_expansion_costs (void)
+{
+  hash_init (&variables, 1024, expvar_hash_1, expvar_hash_2, expvar_hash_cmp);
+  hash_init (&definitions, 1024, expdef_hash_1, expdef_hash_2, expdef_hash_cmp);
+  collecting = 1;
+}
+
+void record_definition_order (const char * name)
+{
+  struct expdef key;
+  struct expdef ** slot;
+
+  if (!collecting)
+    {
+      return;
+    }
+
+  key.name = name;
+  slot = (struct expdef **) hash_find_slot (&definitions, &key);
+  if (HASH_VACANT (*slot))
+    {
+      struct expdef * def = (struct expdef *) xmalloc (sizeof (struct expdef));
+      def->name = strcache_add (name);
+      hash_insert_at (&definitions, def, slot);
+    }
+  (*slot)->sequence = ++definitionCount;
+}
+
+/** The reading order of the last global definition of the LENGTH chars
+ * at NAME, or 0 if the makefiles never defined it */
+static unsigned long last_definition (const char * name, size_t length)
+{
+  struct expdef key;
+  struct expdef * def;
+  char * copy = xstrndup (name, length);
+
+  key.name = copy;
+  def = (struct expdef *) hash_find_item (&definitions, &key);
+  free (copy);
+  return def != NULL ? def->sequence : 0;
+}
+
+/** Nonzero if VALUE references, directly or through recursive
+ * variables, a variable defined after SEQUENCE: simply expanding it
+ * where it was defined would not see that definition.  Only names
+ * written out are followed, not computed ones such as $($(X)) */
+static int references_later (const char * value, unsigned long sequence,
+                             unsigned int depth)
+{
+  const char * p = value;
+
+  while ((p = strchr (p, '$')) != NULL)
+    {
+      const char * name = ++p;
+      size_t length;
+      struct variable * v;
+
+      if (*p == '$')
+        {
+          ++p;
+          continue;
+        }
+      if (*p == '(' || *p == '{')
+        {
+          char close = *p == '(' ? ')' : '}';
+          name = ++p;
+          while (*p != '\0' && *p != close && *p != ':' && *p != '$'
+                 && !ISSPACE (*p))
+            ++p;
+          /* A function call or a computed name: what it contains is
+             scanned as the loop goes on */
+          if (*p != close && *p != ':')
+            continue;
+        }
+      else if (*p != '\0')
+        ++p;
+      length = p - name;
+      if (length == 0)
+        continue;
+
+      if (last_definition (name, length) > sequence)
+        return 1;
+      v = lookup_variable (name, length);
+      if (v != NULL && v->recursive && depth < EXPCOST_REFERENCE_DEPTH
+          && references_later (v->value, sequence, depth + 1))
+        return 1;
+    }
+  return 0;
+}
+
+double expansion_cost_start (void)
+{
+  if (!collecting)
+    {
+      return 0.0;
+    }
+  if (nestedDepth == nestedSize)
+    {
+      nestedSize = nestedSize == 0 ? 64 : nestedSize * 2;
+      nested = (double *) xrealloc (nested, nestedSize * sizeof (double));
+    }
+  nested[nestedDepth++] = 0.0;
+  return recipe_clock ();
+}
+
+void record_expansion_cost (const struct variable * v, const char * value,
+                            double start)
+{
+  struct expvar key;
+  struct expvar ** slot;
+  struct expvar * var;
+  double elapsed;
+  double self;
+
+  if (!collecting || nestedDepth == 0)
+    {
+      return;
+    }
+
+  elapsed = recipe_clock () - start;
+  self = elapsed - nested[--nestedDepth];
+  if (nestedDepth > 0)
+    nested[nestedDepth - 1] += elapsed;
+
+  key.name = strcache_add_len (v->name, v->length);
+  key.file = v->fileinfo.filenm != NULL ? strcache_add (v->fileinfo.filenm) : NULL;
+  key.lineno = v->fileinfo.lineno;
+  slot = (struct expvar **) hash_find_slot (&variables, &key);
+  if (HASH_VACANT (*slot))
+    {
+      var = (struct expvar *) xcalloc (sizeof (struct expvar));
+      var->name = key.name;
+      var->file = key.file;
+      var->lineno = key.lineno;
+      var->first = xstrdup (value);
+      var->sequence = last_definition (key.name, strlen (key.name));
+      hash_insert_at (&variables, var, slot);
+    }
+  else
+    {
+      var = *slot;
+      if (!var->varied && !streq (var->first, value))
+        {
+          var->varied = 1;
+          free (var->first);
+          var->first = NULL;
+        }
+    }
+
+  /* The same definition keeps its value unless it is appended to */
+  if (var->scanned != v->value)
+    {
+      var->scanned = v->value;
+      var->functions |= find_functions (v->value);
+      free (var->text);
+      var->text = xstrdup (v->value);
+    }
+  var->origin = v->origin;
+  var->per_target = v->per_target;
+
+  ++var->expansions;
+  var->seconds += elapsed;
+  var->self += self;
+}
+
+/** Time of its own that expanding only once would have saved: the
+ * variables it expands are charged with theirs */
+static double wasted (const struct expvar * var)
+{
+  return var->self - var->self / var->expansions;
+}
+
+/** Variables that could be simply expanded: defined in a makefile,
+ * expanded more than once, always to the same value, without side
+ * effects that expanding once would lose, and not referring to a
+ * variable defined after them, which := would expand too early */
+static int could_be_simple (const struct expvar * var)
+{
+  return var->file != NULL && var->expansions > 1 && !var->varied
+    && !(var->functions & HAS_SIDE_EFFECTS) && !var->refers_later;
+}
+
+/** Orders by decreasing time wasted */
+static int expvar_wasted_compare (const void * a, const void * b)
+{
+  const struct expvar * x = *(const struct expvar * const *) a;
+  const struct expvar * y = *(const struct expvar * const *) b;
+  double wx = wasted (x);
+  double wy = wasted (y);
+  if (wx != wy)
+    return wx < wy ? 1 : -1;
+  return strcmp (x->name, y->name);
+}
+
+/** Orders by decreasing self time */
+static int expvar_self_compare (const void * a, const void * b)
+{
+  const struct expvar * x = *(const struct expvar * const *) a;
+  const struct expvar * y = *(const struct expvar * const *) b;
+  if (x->self != y->self)
+    return x->self < y->self ? 1 : -1;
+  return strcmp (x->name, y->name);
+}
+
+static void print_variable (const struct expvar * var, double seconds)
+{
+  printf ("  %10.6f %8lu %-8s %-8s  %s", seconds, var->expansions,
+          var->functions & CALLS_SHELL ? "shell" : "",
+          var->functions & CALLS_WILDCARD ? "wildcard" : "", var->name);
+  if (var->file != NULL)
+    printf (" (%s:%lu)", var->file, var->lineno);
+  else
+    printf (_(" (origin %s)"), variable_origin_name (var->origin));
+  printf ("%s\n", var->per_target ? _(" target-specific") : "");
+}
+
+/** Lists the variables that could be simply expanded by the time it
+ * would have saved, then the costliest ones.  Only the expansions make
+ * actually did count, so a run with -n -B gives the fullest picture */
+void report_expansion_costs (const char * filename)
+{
+  struct expvar ** all;
+  struct expvar ** simple;
+  unsigned long count;
+  unsigned long simpleCount = 0;
+  unsigned long expansions = 0;
+  unsigned long i;
+  double seconds = 0.0;
+  double saving = 0.0;
+
+  if (!collecting)
+    {
+      return;
+    }
+  collecting = 0;
+
+  count = variables.ht_fill;
+  all = (struct expvar **) hash_dump (&variables, NULL, expvar_self_compare);
+  simple = (struct expvar **) xmalloc ((count + 1) * sizeof (struct expvar *));
+  for (i = 0; i < count; ++i)
+    {
+      if (all[i]->file != NULL && !all[i]->varied)
+        all[i]->refers_later = references_later (all[i]->text,
+                                                 all[i]->sequence, 0);
+      expansions += all[i]->expansions;
+      seconds += all[i]->self;
+      if (could_be_simple (all[i]))
+        {
+          simple[simpleCount++] = all[i];
+          saving += wasted (all[i]);
+        }
+    }
+  qsort (simple, simpleCount, sizeof (struct expvar *), expvar_wasted_compare);
+
+  if (streq (filename, "-"))
+    {
+      printf (_("Recursive variable expansions: %lu variables, %lu expansions, %.6f seconds\n"),
+              count, expansions, seconds);
+      printf (_("Same value every time, could be := (%lu, %.6f seconds to save):\n"),
+              simpleCount, saving);
+      printf (_("  (not checked: variables referenced only through computed names\n"
+                "   such as $($(X)) or $(call), which := may expand too early)\n"));
+      printf (_("  %10s %8s %-17s  %s\n"), _("wasted s"), _("count"),
+              _("calls"), _("variable"));
+      for (i = 0; i < simpleCount && i < EXPCOST_TOP; ++i)
+        print_variable (simple[i], wasted (simple[i]));
+      printf (_("Most expensive recursive variables, by time of their own:\n"));
+      printf (_("  %10s %8s %-17s  %s\n"), _("self s"), _("count"),
+              _("calls"), _("variable"));
+      for (i = 0; i < count && i < EXPCOST_TOP; ++i)
+        print_variable (all[i], all[i]->self);
+    }
+  else
+    {
+      struct json_writer w;
+      FILE * f = fopen (filename, "w");
+
+      if (f == NULL)
+        {
+          perror_with_name (_("fopen (expansion cost file): "), filename);
+          goto done;
+        }
+      json_init (&w, f, 0);
+      json_begin_object (&w);
+      json_key (&w, "expansions");
+      json_ulong (&w, expansions);
+      json_key (&w, "seconds");
+      json_double (&w, seconds);
+      json_key (&w, "variables");
+      json_begin_array (&w);
+      for (i = 0; i < count; ++i)
+        {
+          const struct expvar * var = all[i];
+          json_begin_object (&w);
+          json_key (&w, "name");
+          json_string (&w, var->name);
+          json_key (&w, "file");
+          if (var->file != NULL)
+            json_string (&w, var->file);
+          else
+            json_null (&w);
+          json_key (&w, "line");
+          json_ulong (&w, var->lineno);
+          json_key (&w, "origin");
+          json_string (&w, variable_origin_name (var->origin));
+          json_key (&w, "target_specific");
+          json_bool (&w, var->per_target);
+          json_key (&w, "expansions");
+          json_ulong (&w, var->expansions);
+          json_key (&w, "seconds");
+          json_double (&w, var->seconds);
+          json_key (&w, "self_seconds");
+          json_double (&w, var->self);
+          json_key (&w, "calls_shell");
+          json_bool (&w, (var->functions & CALLS_SHELL) != 0);
+          json_key (&w, "calls_wildcard");
+          json_bool (&w, (var->functions & CALLS_WILDCARD) != 0);
+          json_key (&w, "same_value");
+          json_bool (&w, !var->varied);
+          json_key (&w, "references_later_definition");
+          json_bool (&w, var->refers_later);
+          json_key (&w, "could_be_simple");
+          json_bool (&w, could_be_simple (var));
+          json_key (&w, "wasted_seconds");
+          json_double (&w, could_be_simple (var) ? wasted (var) : 0.0);
+          json_end_object (&w);
+        }
+      json_end_array (&w);
+      json_end_object (&w);
+      json_finish (&w);
+      fclose (f);
+    }
+
+ done:
+  for (i = 0; i < count; ++i)
+    {
+      free (all[i]->first);
+      free (all[i]->text);
+    }
+  free (simple);
+  free (all);
+  free (nested);
+  nested = NULL;
+  nestedDepth = nestedSize = 0;
+  hash_free (&variables, 1);
+  hash_free (&definitions, 1);
+}
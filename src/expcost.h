@@ -0,0 +1,39 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The cost of expanding recursively expanded variables: how often each
+   definition was expanded, for how long in all and for how long leaving
+   out the variables it expanded in turn, whether its value calls
+   $(shell) or $(wildcard), and whether every expansion of it gave the
+   same value, in which case it could have been simply expanded.  When
+   the costs are not being collected every call below returns at once.  */
+
+struct variable;
+
+void init_expansion_costs (void);
+
+/* Records that the global variable NAME was (re)defined now, so that a
+   variable referring to one defined after it is not taken for := */
+void record_definition_order (const char * name);
+
+/* Returns the time to pass to record_expansion_cost, or 0 when the costs
+   are not being collected */
+double expansion_cost_start (void);
+
+/* Records that expanding V, started at START, gave VALUE */
+void record_expansion_cost (const struct variable * v, const char * value,
+                            double start);
+
+/* If filename is "-" the report is printed as text on stdout, otherwise
+   it is written to filename as JSON */
+void report_expansion_costs (const char * filename);
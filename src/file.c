@@ -197,6 +197,7 @@ enter_file (const char *name)
     {
       new->last = new;
       hash_insert_at (&files, new, file_slot);
+      vpath_note_file (name, 1);
     }
   else
     {
@@ -209,6 +210,17 @@ enter_file (const char *name)
   return new;
 }
 
+/* Return a newly allocated, null-terminated vector of every file in the
+   data base.  Double-colon entries after the first are not included; they
+   are reachable through the 'prev' chain of the first.  */
+
+struct file **
+get_all_files (unsigned long *count)
+{
+  *count = files.ht_fill;
+  return (struct file **) hash_dump (&files, NULL, NULL);
+}
+
 /* Rehash FILE to NAME.  This is not as simple as resetting
    the 'hname' member, since it must be put in a new hash bucket,
    and possibly merged with an existing file called NAME.  */
@@ -236,6 +248,10 @@ rehash_file (struct file *from_file, const char *to_hname)
     /* hname changed unexpectedly!! */
     abort ();
 
+  /* VPATH searches might find either name differently now.  */
+  vpath_note_file (from_file->hname, 0);
+  vpath_note_file (to_hname, 1);
+
   /* Remove the "from" file from the hash.  */
   deleted_file = hash_delete (&files, from_file);
   if (deleted_file != from_file)
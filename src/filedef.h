@@ -60,6 +60,8 @@ struct file
                                            has been performed.  */
     unsigned int considered;    /* equal to 'considered' if file has been
                                    considered on current scan of goal chain */
+    unsigned int graph_id;      /* Node number given to this file by the
+                                   make-analyze graph passes.  */
     int command_flags;          /* Flags OR'd in for cmds; see commands.h.  */
     enum update_status          /* Status of the last attempt to update.  */
       {
@@ -100,6 +102,7 @@ struct file
                                    pattern-specific variables.  */
     unsigned int no_diag:1;     /* True if the file failed to update and no
                                    diagnostics has been issued (dontcare). */
+    unsigned int graph_mark:1;  /* Scratch mark for make-analyze walks.  */
   };
 
 
@@ -107,6 +110,7 @@ extern struct file *default_file;
 
 
 struct file *lookup_file (const char *name);
+struct file **get_all_files (unsigned long *count);
 struct file *enter_file (const char *name);
 struct dep *split_prereqs (char *prereqstr);
 struct dep *enter_prereqs (struct dep *prereqs, const char *stem);
@@ -122,6 +126,7 @@ char *build_target_list (char *old_list);
 void print_prereqs (const struct dep *deps);
 void print_file_data_base (void);
 int try_implicit_rule (struct file *file, unsigned int depth);
+void implicit_print_stats (const char *prefix);
 int stemlen_compare (const void *v1, const void *v2);
 
 #if FILE_TIMESTAMP_HI_RES
@@ -22,6 +22,12 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "os.h"
 #include "commands.h"
 #include "debug.h"
+#include "trace.h"
+#include "evalprof.h"
+#include "shellcache.h"
+#include "mtimecache.h"
+#include "varrefs.h"
+#include "snapshot.h"
 
 #ifdef _AMIGA
 #include "amiga.h"
@@ -68,6 +74,10 @@ function_table_entry_hash_cmp (const void *xv, const void *yv)
 }
 
 static struct hash_table function_table;
+
+/* Incremented whenever a function is added, since that changes how
+   strings already compiled into expansion programs would be read.  */
+unsigned long function_table_changenum = 0;
 
 
 /* Store into VARIABLE_BUFFER at O the result of scanning TEXT and replacing
@@ -460,6 +470,7 @@ func_origin (char *o, char **argv, const char *funcname UNUSED)
 {
   /* Expand the argument.  */
   struct variable *v = lookup_variable (argv[0], strlen (argv[0]));
+  record_variable_reference (argv[0], strlen (argv[0]), v != 0, 0);
   if (v == 0)
     o = variable_buffer_output (o, "undefined", 9);
   else
@@ -499,6 +510,7 @@ static char *
 func_flavor (char *o, char **argv, const char *funcname UNUSED)
 {
   struct variable *v = lookup_variable (argv[0], strlen (argv[0]));
+  record_variable_reference (argv[0], strlen (argv[0]), v != 0, 0);
 
   if (v == 0)
     o = variable_buffer_output (o, "undefined", 9);
@@ -873,6 +885,7 @@ func_foreach (char *o, char **argv, const char *funcname UNUSED)
   const char *p;
   size_t len;
   struct variable *var;
+  struct expansion_program *program = NULL;
 
   /* Clean up the variable name by removing whitespace.  */
   char *vp = next_token (varname);
@@ -889,7 +902,13 @@ func_foreach (char *o, char **argv, const char *funcname UNUSED)
       free (var->value);
       var->value = xstrndup (p, len);
 
-      result = allocated_variable_expand (body);
+      /* Parse BODY once if it is expanded more than once.  */
+      if (doneany && program == NULL)
+        program = compile_expansion (body, strlen (body));
+      if (program != NULL)
+        result = allocated_expand_program (program);
+      else
+        result = allocated_variable_expand (body);
 
       o = variable_buffer_output (o, result, strlen (result));
       o = variable_buffer_output (o, " ", 1);
@@ -901,6 +920,8 @@ func_foreach (char *o, char **argv, const char *funcname UNUSED)
     /* Kill the last space.  */
     --o;
 
+  if (program != NULL)
+    release_expansion (program);
   pop_variable_scope ();
   free (varname);
   free (list);
@@ -1418,6 +1439,7 @@ func_value (char *o, char **argv, const char *funcname UNUSED)
 {
   /* Look up the variable.  */
   struct variable *v = lookup_variable (argv[0], strlen (argv[0]));
+  record_variable_reference (argv[0], strlen (argv[0]), v != 0, 0);
 
   /* Copy its value into the output buffer without expanding it.  */
   if (v)
@@ -1738,6 +1760,9 @@ func_shell_base (char *o, char **argv, int trim_newlines)
 
   envp = environ;
 
+  /* The command may change any file.  */
+  forget_prefetched_mtimes ();
+
   /* Set up the output in case the shell writes something.  */
   output_start ();
 
@@ -1985,7 +2010,34 @@ func_shell_base (char *o, char **argv, int trim_newlines)
 static char *
 func_shell (char *o, char **argv, const char *funcname UNUSED)
 {
-  return func_shell_base (o, argv, 1);
+  double start = trace_start ();
+  const char *output;
+  size_t length;
+  size_t offset;
+
+  snapshot_note_side_effect ("$(shell)");
+  if (!find_shell_output (argv[0], &output, &length))
+    o = func_shell_base (o, argv, 1);
+  else if (output != NULL)
+    {
+      /* A memoized call succeeded the first time it ran.  */
+      shell_completed (0, 0);
+      o = variable_buffer_output (o, output, length);
+    }
+  else
+    {
+      const struct variable *status;
+
+      offset = o - variable_buffer;
+      o = func_shell_base (o, argv, 1);
+      status = lookup_variable (STRING_SIZE_TUPLE (".SHELLSTATUS"));
+      store_shell_output (variable_buffer + offset,
+                          o - (variable_buffer + offset),
+                          status != NULL && streq (status->value, "0"));
+    }
+
+  trace_span ("$(shell)", "shell", start, argv[0]);
+  return o;
 }
 #endif  /* !VMS */
 
@@ -2229,6 +2281,8 @@ func_file (char *o, char **argv, const char *funcname UNUSED)
       if (fn[0] == '\0')
         O (fatal, *expanding_var, _("file: missing filename"));
 
+      snapshot_note_side_effect ("$(file >)");
+      forget_prefetched_mtimes ();
       ENULLLOOP (fp, fopen (fn, mode));
       if (fp == NULL)
         OSS (fatal, reading_file, _("open: %s: %s"), fn, strerror (errno));
@@ -2257,6 +2311,7 @@ func_file (char *o, char **argv, const char *funcname UNUSED)
       if (argv[1])
         O (fatal, *expanding_var, _("file: too many arguments"));
 
+      snapshot_note_input (fn);
       ENULLLOOP (fp, fopen (fn, "r"));
       if (fp == NULL)
         {
@@ -2449,6 +2504,7 @@ handle_function (char **op, const char **stringp)
   char *abeg = NULL;
   char **argv, **argvp;
   int nargs;
+  int profiled;
 
   beg = *stringp + 1;
 
@@ -2485,6 +2541,9 @@ handle_function (char **op, const char **stringp)
 
   *stringp = end;
 
+  /* Arguments are expanded in the function's frame.  */
+  profiled = profile_function (entry_p->name);
+
   /* Get some memory to store the arg pointers.  */
   argvp = argv = alloca (sizeof (char *) * (nargs + 2));
 
@@ -2550,10 +2609,183 @@ handle_function (char **op, const char **stringp)
   else
     free (abeg);
 
+  if (profiled)
+    profile_leave ();
+
   return 1;
 }
 
 
+/* A builtin function call read by compile_function_call.  */
+
+struct function_call
+{
+  const struct function_table_entry *entry;
+  int nargs;
+  struct expansion_program **args;  /* If the function expands them.  */
+  char *raw;                    /* If not: the nul-separated arguments.  */
+  size_t raw_length;
+};
+
+/* Like handle_function, but read the function call at S without running
+   it.  If S starts one, return nonzero, set *ENDP to its closing paren
+   and *CALLP to the call, or to NULL if the call is unterminated.  */
+
+int
+compile_function_call (const char *s, const char **endp,
+                       struct function_call **callp)
+{
+  const struct function_table_entry *entry_p;
+  struct function_call *call;
+  char openparen = s[0];
+  char closeparen = openparen == '(' ? ')' : '}';
+  const char *beg;
+  const char *end;
+  int count = 0;
+  int nargs;
+
+  beg = s + 1;
+
+  entry_p = lookup_function (beg);
+
+  if (!entry_p)
+    return 0;
+
+  beg += entry_p->len;
+  NEXT_TOKEN (beg);
+
+  for (nargs=1, end=beg; *end != '\0'; ++end)
+    if (!STOP_SET (*end, MAP_VARSEP|MAP_COMMA))
+      continue;
+    else if (*end == ',')
+      ++nargs;
+    else if (*end == openparen)
+      ++count;
+    else if (*end == closeparen && --count < 0)
+      break;
+
+  if (count >= 0)
+    {
+      /* Leave the error to handle_function.  */
+      *callp = NULL;
+      return 1;
+    }
+
+  *endp = end;
+
+  call = xcalloc (sizeof (struct function_call));
+  call->entry = entry_p;
+
+  if (entry_p->expand_args)
+    {
+      const char *p;
+      call->args = xmalloc (sizeof (struct expansion_program *) * nargs);
+      for (p=beg, nargs=0; p <= end; )
+        {
+          const char *next;
+
+          ++nargs;
+
+          if (nargs == entry_p->maximum_args
+              || ((next = find_next_argument (openparen, closeparen, p, end)) == NULL))
+            next = end;
+
+          call->args[nargs - 1] = compile_expansion (p, next - p);
+          p = next + 1;
+        }
+    }
+  else
+    {
+      size_t len = end - beg;
+      char *p, *aend;
+
+      call->raw = xmalloc (len+1);
+      call->raw_length = len + 1;
+      memcpy (call->raw, beg, len);
+      call->raw[len] = '\0';
+      aend = call->raw + len;
+
+      for (p=call->raw, nargs=0; p <= aend; )
+        {
+          char *next;
+
+          ++nargs;
+
+          if (nargs == entry_p->maximum_args
+              || ((next = find_next_argument (openparen, closeparen, p, aend)) == NULL))
+            next = aend;
+
+          *next = '\0';
+          p = next + 1;
+        }
+    }
+
+  call->nargs = nargs;
+  *callp = call;
+  return 1;
+}
+
+/* Run CALL as handle_function would, writing its result at O.  */
+
+char *
+run_function_call (char *o, const struct function_call *call)
+{
+  const struct function_table_entry *entry_p = call->entry;
+  char *abeg = NULL;
+  char **argv;
+  int profiled;
+  int i;
+
+  /* Arguments are expanded in the function's frame.  */
+  profiled = profile_function (entry_p->name);
+
+  argv = alloca (sizeof (char *) * (call->nargs + 1));
+
+  if (entry_p->expand_args)
+    for (i = 0; i < call->nargs; ++i)
+      argv[i] = allocated_expand_program (call->args[i]);
+  else
+    {
+      char *p;
+
+      /* The function may write to its arguments.  */
+      abeg = xmalloc (call->raw_length);
+      memcpy (abeg, call->raw, call->raw_length);
+      for (p = abeg, i = 0; i < call->nargs; ++i)
+        {
+          argv[i] = p;
+          p += strlen (p) + 1;
+        }
+    }
+  argv[call->nargs] = NULL;
+
+  o = expand_builtin_function (o, call->nargs, argv, entry_p);
+
+  if (entry_p->expand_args)
+    for (i = 0; i < call->nargs; ++i)
+      free (argv[i]);
+  else
+    free (abeg);
+
+  if (profiled)
+    profile_leave ();
+
+  return o;
+}
+
+void
+free_function_call (struct function_call *call)
+{
+  int i;
+
+  if (call->args)
+    for (i = 0; i < call->nargs; ++i)
+      release_expansion (call->args[i]);
+  free (call->args);
+  free (call->raw);
+  free (call);
+}
+
 /* User-defined functions.  Expand the first argument as either a builtin
    function or a make variable, in the context of the rest of the arguments
    assigned to $1, $2, ... $N.  $0 is the name of the function.  */
@@ -2686,6 +2918,7 @@ define_new_function (const floc *flocp, const char *name,
   ent->fptr.alloc_func_ptr = func;
 
   hash_insert (&function_table, ent);
+  ++function_table_changenum;
 }
 
 void
@@ -16,6 +16,7 @@
 #include "dep.h"
 #include "goaltree.h"
 #include "hash.h"
+#include "jsonout.h"
 
 #include <stdio.h>
 #include <sys/stat.h>
@@ -29,7 +30,6 @@ struct filename_id
   unsigned long id;
   unsigned long dependents;
   unsigned long dependers;
-  unsigned int is_considered;
 };
 
 static unsigned long nFiles = 0;
@@ -72,8 +72,11 @@ static struct filename_id * filename_to_filename_id (const char * filename)
   return NULL;
 }
 
-static unsigned long
-filename_to_id (const char * filename, const int isDependent)
+/** Returns the filename_id for filename, creating it if needed.
+ * isNew is set to 1 if the entry was created by this call */
+static struct filename_id *
+filename_to_new_filename_id (const char * filename, const int isDependent,
+                             int * isNew)
 {
   struct filename_id ** slot = filename_to_hash_slot (filename);
   if (!HASH_VACANT(*slot))
@@ -82,7 +85,8 @@ filename_to_id (const char * filename, const int isDependent)
         {
           (*slot)->dependers++;
         }
-      return (*slot)->id;
+      *isNew = 0;
+      return *slot;
     }
 
   struct filename_id * newfId = (struct filename_id *) xcalloc (sizeof (struct filename_id));
@@ -90,102 +94,22 @@ filename_to_id (const char * filename, const int isDependent)
   newfId->filename = filename;
   newfId->dependers = 1;
   newfId->dependents = 0;
-  newfId->is_considered = 0;
   hash_insert_at (&goaltreeFiles, newfId, slot);
 
-  return newfId->id;
-}
-
-static void start_considering_file (const char * filename)
-{
-  struct filename_id * filenameId = filename_to_filename_id (filename);
-
-  if (filenameId != NULL)
-    {
-      filenameId->is_considered = 1;
-    }
+  *isNew = 1;
+  return newfId;
 }
 
-static void stop_considering_file (const char * filename)
+static unsigned long
+filename_to_id (const char * filename, const int isDependent)
 {
-  struct filename_id * filenameId = filename_to_filename_id (filename);
-
-  if (filenameId != NULL)
-    {
-      filenameId->is_considered = 0;
-    }
-}
-
-static int considering_file (const char * filename)
-{
-  struct filename_id * filenameId = filename_to_filename_id (filename);
-
-  if (filenameId != NULL)
-    {
-      return filenameId->is_considered;
-    }
-
-  return 0;
+  int isNew;
+  return filename_to_new_filename_id (filename, isDependent, &isNew)->id;
 }
 
 static int prettyPrint = 0;
 
-static void print_n_spaces (const int n, FILE * f)
-{
-  if (!prettyPrint) return;
-
-  int i;
-  for (i = 0; i < n; ++i)
-    fprintf (f, " ");
-}
-
-/** Prints the opening brace of a JavaScript object */
-static void print_object_start (const int nSpaces, FILE * f)
-{
-  print_n_spaces (nSpaces, f);
-
-  fprintf (f, "{");
-  if (prettyPrint)
-    {
-      fprintf (f, "\n");
-    }
-}
-
-/** Prints the closing brace of a JavaScript object */
-static void print_object_end (const int nSpaces, FILE * f)
-{
-  print_n_spaces (nSpaces, f);
-
-  fprintf (f, "}");
-  if (prettyPrint)
-    {
-      fprintf (f, "\n");
-    }
-}
-
-/** Prints the opening bracket of a JavaScript array */
-static void print_array_start (const int nSpaces, FILE * f)
-{
-  print_n_spaces (nSpaces, f);
-
-  fprintf (f, "[");
-  if (prettyPrint)
-    {
-      fprintf (f, "\n");
-    }
-}
-
-/** Prints the closing bracket of a JavaScript array */
-static void print_array_end (const int nSpaces, FILE * f)
-{
-  print_n_spaces (nSpaces, f);
-
-  fprintf (f, "]");
-  if (prettyPrint)
-    {
-      fprintf (f, "\n");
-    }
-}
+static void print_file_ids (struct json_writer * w);
 
 struct dep_tree_child_list
 {
@@ -227,21 +151,48 @@ static struct dep_tree_child_list * dep_tree_child_list_add_after (struct dep_tr
 }
 
 /** Prints the dependency tree as nested JavaScript objects and arrays */
-static void print_file_deps (struct file * depender, const int level, FILE * f)
+static void print_file_deps (struct file * depender, const int level,
+                             struct json_writer * w)
 {
   struct dep_tree_child_list * depItr = dep_tree_child_list_alloc (depender, level);
+  int openParents = 0;
+
+  /* The files from the goal down to the current one.  Each of them
+     has graph_mark set, so a dependency back onto the path is found
+     without any lookups */
+  unsigned int pathCapacity = 64;
+  unsigned int pathLength = 0;
+  struct file ** path = (struct file **) xmalloc (pathCapacity * sizeof (struct file *));
 
   while (depItr != NULL)
     {
+      const unsigned int depth = depItr->level - level;
+
+      /* Close the lists of the nodes whose children have all been printed */
+      for (; openParents > depth; --openParents)
+        {
+          json_end_array (w);
+          json_end_object (w);
+        }
+
+      for (; pathLength > depth; --pathLength)
+        path[pathLength - 1]->graph_mark = 0;
+      if (pathLength == pathCapacity)
+        {
+          pathCapacity *= 2;
+          path = (struct file **) xrealloc (path, pathCapacity * sizeof (struct file *));
+        }
+      path[pathLength++] = depItr->child;
+      depItr->child->graph_mark = 1;
+
       struct dep * childItr = depItr->child->deps;
 
       struct dep_tree_child_list * appendAfter = depItr;
       for (; childItr != NULL; childItr = childItr->next)
         {
-          if (considering_file (childItr->file->name))
+          if (childItr->file->graph_mark)
             {
-              /* possible cyclic dependency */
-              printf ("cyclic dependency found on %s\n",childItr->file->name);
+              /* cyclic dependency, see --detect-cycles for details */
               continue;
             }
 
@@ -249,138 +200,179 @@ static void print_file_deps (struct file * depender, const int level, FILE * f)
         }
 
       const unsigned long depfileId = filename_to_id (depItr->child->name, 1);
-      start_considering_file (depItr->child->name);
       if (depItr->next != NULL && depItr->next->level > depItr->level)
         {
           /* This node has children, hence it has to be dumped as an object
              with a property whose value is an array of its children */
-          print_object_start (depItr->level, f);
-
-          print_n_spaces (depItr->level+1, f);
-          fprintf (f, "\"f%ld\":", depfileId);
-
-          print_array_start (0, f);
+          json_begin_object (w);
+          json_key_id (w, 'f', depfileId);
+          json_begin_array (w);
+          ++openParents;
         }
       else
         {
           /* This is a leaf-level node */
-          print_n_spaces (depItr->level+1, f);
-
-          fprintf (f, "\"f%ld\"", depfileId);
-        }
-
-      if (depItr->next == NULL || depItr->next->level < depItr->level)
-        {
-          /* This is the end of one or multiple lists */
-          int numberOfEnded = 0;
-          if (depItr->next == NULL)
-            {
-              numberOfEnded = depItr->level - level;
-            }
-          else
-            {
-              numberOfEnded = depItr->level - depItr->next->level;
-            }
-
-          if (prettyPrint)
-            {
-              fprintf (f, "\n");
-            }
-
-          int i;
-          for (i = numberOfEnded; i > 0; --i)
-            {
-              print_array_end (i+1, f);
-
-              print_object_end (i, f);
-            }
-
+          json_id (w, 'f', depfileId);
         }
 
-      if (depItr->next != NULL && depItr->next->level <= depItr->level)
-        {
-          fprintf (f, ",");
-
-          if (prettyPrint)
-            {
-              fprintf (f, "\n");
-            }
-        }
-
-
-      stop_considering_file (depItr->child->name);
       struct dep_tree_child_list * discarded = depItr;
       depItr = depItr->next;
       free (discarded);
     }
+
+  for (; openParents > 0; --openParents)
+    {
+      json_end_array (w);
+      json_end_object (w);
+    }
+
+  for (; pathLength > 0; --pathLength)
+    path[pathLength - 1]->graph_mark = 0;
+  free (path);
 }
 
 /** Prints the dependency trees of all the goals
- * as nested JavaScript objects and arrays */
-void print_goal_tree (struct goaldep * const goals, FILE * f)
+ * as nested JavaScript objects and arrays.  Returns the errno of a
+ * failed write, or 0 */
+int print_goal_tree (struct goaldep * const goals, FILE * f)
 {
   struct goaldep * itr = goals;
+  struct json_writer w;
+  int error;
   hash_init (&goaltreeFiles, 1000, file_hash_1, file_hash_2, file_hash_cmp);
+  nFiles = 0;
+  json_init (&w, f, prettyPrint);
 
-  print_object_start (0, f);
-
-  print_n_spaces (1, f);
-  fprintf (f,"\"targets\":");
-
-  print_array_start (0,f );
-
+  json_begin_object (&w);
+  json_key (&w, "targets");
+  json_begin_array (&w);
   for (; itr != NULL; itr = itr->next)
     {
-      print_file_deps (itr->file, 2, f);
-
-      if (itr->next != NULL)
-        fprintf (f, ",");
-
-      if (prettyPrint)
-        {
-          fprintf (f, "\n");
-        }
+      print_file_deps (itr->file, 0, &w);
     }
-  print_array_end (1, f);
+  json_end_array (&w);
+
+  print_file_ids (&w);
+  json_end_object (&w);
 
-  fprintf (f, ",\n");
+  error = json_finish (&w);
+  hash_free (&goaltreeFiles, 1);
+  return error;
+}
 
+/** Prints the "ids" object mapping every id
+ * handed out so far to its file name */
+static void print_file_ids (struct json_writer * w)
+{
   struct filename_id ** fileIds = (struct filename_id **)hash_dump (&goaltreeFiles, NULL, NULL);
   struct filename_id ** fileIds_end = fileIds + goaltreeFiles.ht_fill;
   struct filename_id ** fileId;
-  struct filename_id ** fileIds_end_minus1 = fileIds + goaltreeFiles.ht_fill - 1;
-  fprintf (f, "\"ids\":");
-  print_object_start (1,f);
+
+  json_key (w, "ids");
+  json_begin_object (w);
   for (fileId = fileIds; fileId < fileIds_end; fileId++)
     {
-      print_n_spaces (1, f);
-      fprintf (f, "\"f%ld\":\"%s\"",
-               (*fileId)->id,
-               (*fileId)->filename);
-      if (fileId != fileIds_end_minus1)
+      json_key_id (w, 'f', (*fileId)->id);
+      json_string (w, (*fileId)->filename);
+    }
+  json_end_object (w);
+
+  free (fileIds);
+}
+
+/** Prints the goals and everything they depend on as a DAG:
+ * "targets" lists the ids of the goals, the object under childrenKey
+ * maps every file's id to the ids of its direct dependencies, and "ids"
+ * maps the ids to file names.  The walk is breadth-first and a file is
+ * only queued when it gets its id, so each file and each edge is
+ * visited once */
+static void print_goal_graph (struct json_writer * w,
+                              struct goaldep * const goals,
+                              const char * childrenKey)
+{
+  struct goaldep * itr;
+  struct file ** queue;
+  unsigned long queueSize = 0;
+  unsigned long queueCapacity = 1024;
+  unsigned long head;
+  int isNew;
+
+  hash_init (&goaltreeFiles, 1000, file_hash_1, file_hash_2, file_hash_cmp);
+  nFiles = 0;
+  queue = (struct file **) xmalloc (queueCapacity * sizeof (struct file *));
+
+  json_key (w, "targets");
+  json_begin_array (w);
+  for (itr = goals; itr != NULL; itr = itr->next)
+    {
+      struct filename_id * goalId =
+        filename_to_new_filename_id (itr->file->name, 0, &isNew);
+      if (isNew)
         {
-          fprintf (f,",");
+          queue[queueSize++] = itr->file;
+          if (queueSize == queueCapacity)
+            {
+              queueCapacity *= 2;
+              queue = (struct file **) xrealloc (queue, queueCapacity * sizeof (struct file *));
+            }
         }
 
-      if (prettyPrint)
+      json_id (w, 'f', goalId->id);
+    }
+  json_end_array (w);
+
+  json_key (w, childrenKey);
+  json_begin_object (w);
+  for (head = 0; head < queueSize; ++head)
+    {
+      struct file * depender = queue[head];
+      struct filename_id * dependerId = filename_to_filename_id (depender->name);
+      struct dep * depItr;
+
+      json_key_id (w, 'f', dependerId->id);
+      json_begin_array (w);
+      for (depItr = depender->deps; depItr != NULL; depItr = depItr->next)
         {
-          fprintf (f,"\n");
+          struct filename_id * childId =
+            filename_to_new_filename_id (depItr->file->name, 1, &isNew);
+          if (isNew)
+            {
+              queue[queueSize++] = depItr->file;
+              if (queueSize == queueCapacity)
+                {
+                  queueCapacity *= 2;
+                  queue = (struct file **) xrealloc (queue, queueCapacity * sizeof (struct file *));
+                }
+            }
+
+          dependerId->dependents++;
+          json_id (w, 'f', childId->id);
         }
+      json_end_array (w);
     }
-  print_object_end (1, f);
-  print_object_end (0, f);
-
-  /* Work in progress - unfinished
-     for (fileId = fileIds; fileId < fileIds_end; fileId++)
-     {
-     printf ("%ld %ld\n",
-     (*fileId)->dependers,
-     (*fileId)->id);
-     }
-  */
+  json_end_object (w);
 
-  free (fileIds);
-  hash_free_items (&goaltreeFiles);
+  print_file_ids (w);
+
+  free (queue);
+  hash_free (&goaltreeFiles, 1);
+}
+
+/** Prints the goals and everything they depend on
+ * as a DAG, see print_goal_graph.  Returns the errno of a failed write,
+ * or 0 */
+int print_goal_dag (struct goaldep * const goals, FILE * f)
+{
+  struct json_writer w;
+  json_init (&w, f, prettyPrint);
+
+  json_begin_object (&w);
+  json_key (&w, "format");
+  json_string (&w, "dag");
+  print_goal_graph (&w, goals, "deps");
+  json_end_object (&w);
+
+  return json_finish (&w);
 }
 
 struct previous_file_list
@@ -512,77 +504,6 @@ void browse_goal_tree (struct goaldep * const goals)
   printf ("Bye!");
 }
 
-struct files_bfs_list
-{
-  struct file * current;
-  struct files_bfs_list * next;
-};
-
-static void print_goal_tree_children (FILE * f, struct goaldep * const goals)
-{
-  struct files_bfs_list * bfs_list = NULL;
-  struct files_bfs_list * bfs_list_tail = NULL;
-
-  struct goaldep * itr = goals;
-  for (;itr != NULL; itr = itr->next)
-    {
-      struct files_bfs_list * bfs_elem = (struct files_bfs_list *) xcalloc (sizeof (struct files_bfs_list));
-      bfs_elem->current = itr->file;
-      bfs_elem->next = NULL;
-
-      if (bfs_list == NULL)
-        {
-          bfs_list = bfs_elem;
-          bfs_list_tail = bfs_list;
-        }
-      else
-        {
-          bfs_list_tail->next = bfs_elem;
-          bfs_list_tail = bfs_elem;
-        }
-    }
-
-  struct files_bfs_list * itr2 = bfs_list;
-  while (itr2 != NULL)
-    {
-      fprintf (f, "\"%s\":", itr2->current->name);
-      if (itr2->current->deps == NULL)
-        {
-          fprintf (f, "[]");
-        }
-      else
-        {
-          fprintf (f, "[");
-          struct dep * depItr = itr2->current->deps;
-          for (;depItr != NULL; depItr = depItr->next)
-            {
-              fprintf (f, "\"%s\"",depItr->file->name);
-              if (depItr->next != NULL)
-                fprintf (f, ",");
-
-
-              struct files_bfs_list * bfs_elem = (struct files_bfs_list *) xcalloc (sizeof (struct files_bfs_list));
-              bfs_elem->current = depItr->file;
-              bfs_elem->next = NULL;
-              bfs_list_tail->next = bfs_elem;
-              bfs_list_tail = bfs_elem;
-            }
-          fprintf (f, "]");
-        }
-
-      if (itr2->next != NULL)
-        fprintf (f, ",\n");
-
-      struct files_bfs_list * tmp = itr2->next;
-      free (itr2);
-      itr2 = tmp;
-    }
-}
-
-static void print_goal_tree_file_ids (FILE * f)
-{
-}
-
 static void generate_goaltree_js (struct goaldep * goals,
                                   const char * output_dir);
 static void generate_goaltree_html (const char * output_dir);
@@ -613,6 +534,143 @@ void print_goal_tree_as_html (struct goaldep * const goals,
   free (unique_output_dir);
 }
 
+/* Number of nodes described by each file under data/ */
+#define GOALTREE_CHUNK_SIZE 500
+
+static FILE * open_goaltree_chunk (const char * output_dir,
+                                   const unsigned long chunk,
+                                   struct json_writer * w)
+{
+  char * path_to_chunk = (char *) xcalloc (strlen (output_dir) + 64);
+  sprintf (path_to_chunk, "%s/data/chunk-%lu.js", output_dir, chunk);
+  FILE * chunk_file = fopen (path_to_chunk, "w");
+
+  if (chunk_file == NULL)
+    {
+      printf ("Error: couldn't create %s\n",
+              path_to_chunk);
+      free (path_to_chunk);
+      return NULL;
+    }
+  free (path_to_chunk);
+
+  json_init (w, chunk_file, 0);
+  json_raw (w, "goalTreeChunk(");
+  json_ulong (w, chunk);
+  json_raw (w, ",");
+  json_begin_array (w);
+
+  return chunk_file;
+}
+
+static void close_goaltree_chunk (FILE * chunk_file, struct json_writer * w)
+{
+  json_end_array (w);
+  json_raw (w, ");\n");
+  json_finish (w);
+  fclose (chunk_file);
+}
+
+/** Writes the goal graph as data/chunk-<k>.js files of
+ * GOALTREE_CHUNK_SIZE nodes each, so that the viewer only has to
+ * load the parts the user expands.  Ids are handed out in the same
+ * breadth-first order the nodes are written in, so node n is entry
+ * (n-1) % GOALTREE_CHUNK_SIZE of chunk (n-1) / GOALTREE_CHUNK_SIZE, and
+ * the children of a node usually share one or two chunks.
+ * Returns the number of chunks written */
+static unsigned long generate_goaltree_chunks (struct goaldep * const goals,
+                                               const char * output_dir,
+                                               struct json_writer * targets)
+{
+  struct goaldep * itr;
+  struct file ** queue;
+  unsigned long queueSize = 0;
+  unsigned long queueCapacity = 1024;
+  unsigned long head;
+  int isNew;
+  FILE * chunk_file = NULL;
+  struct json_writer w;
+
+  char * path_to_data = (char *) xcalloc (strlen (output_dir) + strlen ("/data") + 1);
+  sprintf (path_to_data, "%s/data", output_dir);
+  if (mkdir (path_to_data, 511) != 0)
+    {
+      printf ("Error: couldn't create directory %s for goaltree HTML output\n",path_to_data);
+      free (path_to_data);
+      return 0;
+    }
+  free (path_to_data);
+
+  hash_init (&goaltreeFiles, 1000, file_hash_1, file_hash_2, file_hash_cmp);
+  nFiles = 0;
+  queue = (struct file **) xmalloc (queueCapacity * sizeof (struct file *));
+
+  json_begin_array (targets);
+  for (itr = goals; itr != NULL; itr = itr->next)
+    {
+      struct filename_id * goalId =
+        filename_to_new_filename_id (itr->file->name, 0, &isNew);
+      if (isNew)
+        {
+          queue[queueSize++] = itr->file;
+          if (queueSize == queueCapacity)
+            {
+              queueCapacity *= 2;
+              queue = (struct file **) xrealloc (queue, queueCapacity * sizeof (struct file *));
+            }
+        }
+
+      json_ulong (targets, goalId->id);
+    }
+  json_end_array (targets);
+
+  for (head = 0; head < queueSize; ++head)
+    {
+      struct file * depender = queue[head];
+      struct dep * depItr;
+
+      if (head % GOALTREE_CHUNK_SIZE == 0)
+        {
+          if (chunk_file != NULL)
+            close_goaltree_chunk (chunk_file, &w);
+          chunk_file = open_goaltree_chunk (output_dir,
+                                            head / GOALTREE_CHUNK_SIZE, &w);
+          if (chunk_file == NULL)
+            break;
+        }
+
+      json_begin_array (&w);
+      json_string (&w, depender->name);
+      json_begin_array (&w);
+      for (depItr = depender->deps; depItr != NULL; depItr = depItr->next)
+        {
+          struct filename_id * childId =
+            filename_to_new_filename_id (depItr->file->name, 1, &isNew);
+          if (isNew)
+            {
+              queue[queueSize++] = depItr->file;
+              if (queueSize == queueCapacity)
+                {
+                  queueCapacity *= 2;
+                  queue = (struct file **) xrealloc (queue, queueCapacity * sizeof (struct file *));
+                }
+            }
+
+          json_ulong (&w, childId->id);
+        }
+      json_end_array (&w);
+      json_end_array (&w);
+    }
+
+  if (chunk_file != NULL)
+    close_goaltree_chunk (chunk_file, &w);
+
+  free (queue);
+  hash_free (&goaltreeFiles, 1);
+
+  return (queueSize + GOALTREE_CHUNK_SIZE - 1) / GOALTREE_CHUNK_SIZE;
+}
+
 static void generate_goaltree_js (struct goaldep * const goals,
                                   const char * output_dir)
 {
@@ -629,43 +687,36 @@ static void generate_goaltree_js (struct goaldep * const goals,
       return;
     }
 
-  fprintf (js_file,
-           "const data = {\n"
-           "  targets : [");
-  struct goaldep * itr = goals;
-  for (;itr != NULL; itr = itr->next)
-    {
-      fprintf (js_file, "\"%s\"",itr->file->name);
-      if (itr->next != NULL)
-        fprintf (js_file, ",");
-    }
-  fprintf (js_file,
-           "],\n"
-           "  children : {\n");
-
-  print_goal_tree_children (js_file, goals);
-
-  fprintf (js_file,
-           "  },\n"
-           "  ids : {\n");
-
-  print_goal_tree_file_ids (js_file);
-
-  fprintf (js_file,
-           "  }\n"
-           "};\n");
-
-  fprintf (js_file,
-           "function setupGoalTree (container)\n"
-           "{\n"
-           "    let goalTree = MinimalistTree (document.getElementById (container));\n"
-           "    goalTree.draw ({\n"
-           "        getroots : () => data.targets,\n"
-           "        getchildren : (parent) => data.children[parent],\n"
-           "//        getlabel : (node) => data.ids[node]\n"
-           "        getlabel : (node) => node\n"
-           "    });\n"
-           "}\n");
+  struct json_writer w;
+  json_init (&w, js_file, prettyPrint);
+
+  json_raw (&w, "const goalTreeData = ");
+  json_begin_object (&w);
+  json_key (&w, "targets");
+  unsigned long chunks = generate_goaltree_chunks (goals, output_dir, &w);
+  json_key (&w, "chunkSize");
+  json_ulong (&w, GOALTREE_CHUNK_SIZE);
+  json_key (&w, "chunkCount");
+  json_ulong (&w, chunks);
+  json_end_object (&w);
+
+  json_raw (&w,
+            ";\n"
+            "function setupGoalTree (container)\n"
+            "{\n"
+            "    const chunks = GoalTreeChunks (goalTreeData.chunkSize);\n"
+            "    let goalTree = MinimalistTree (document.getElementById (container));\n"
+            "    goalTree.draw ({\n"
+            "        getroots : () => chunks.ensure (goalTreeData.targets).then (() => goalTreeData.targets),\n"
+            "        getchildren : (parent) => {\n"
+            "            const children = chunks.node (parent)[1];\n"
+            "            return chunks.ensure (children).then (() => children);\n"
+            "        },\n"
+            "        haschildren : (node) => chunks.node (node)[1].length > 0,\n"
+            "        getlabel : (node) => chunks.node (node)[0]\n"
+            "    });\n"
+            "}\n");
+  json_finish (&w);
   fclose (js_file);
 
   free (path_to_js_file);
@@ -731,57 +782,204 @@ static void generate_minimalist_tree_js (const char * output_dir)
   fprintf (js_file,
            "function MinimalistTree (container)\n"
            "{\n"
-           "  return {\n"
-           "    draw : (options) => expandOrCollapseNodes (container, options)\n"
-           "  }\n"
+           "    return {\n"
+           "        draw : (options) => expandOrCollapseNodes (container, options, options.getroots)\n"
+           "    }\n"
            "}\n"
            "\n"
-           "function addNode (parent, node, options)\n"
+           "// Lists longer than this only create elements for the rows in view\n"
+           "const virtualListThreshold = 200;\n"
+           "const virtualRowHeight = 20;\n"
+           "const virtualVisibleRows = 25;\n"
+           "\n"
+           "function createNode (node, options)\n"
            "{\n"
-           "  var li = document.createElement ('li');\n"
-           "  li.appendChild (document.createTextNode (options.getlabel(node)));\n"
-           "  const children = options.getchildren (node);\n"
-           "  if (children != null && children.length > 0)\n"
-           "  {\n"
-           "    li.addEventListener ('click', (e) => {\n"
-           "      expandOrCollapseNodes (li, {\n"
-           "        getroots : () => children,\n"
-           "        getchildren : options.getchildren,\n"
-           "        getlabel : options.getlabel\n"
-           "      });\n"
-           "      e.stopPropagation ();\n"
-           "    });\n"
-           "  }\n"
-           "  else\n"
-           "  {\n"
-           "    li.addEventListener ('click', (e) => e.stopPropagation ());\n"
-           "  }\n"
-           "  parent.appendChild (li);\n"
+           "    var li = document.createElement ('li');\n"
+           "\n"
+           "    li.appendChild (document.createTextNode (options.getlabel(node)));\n"
+           "\n"
+           "    if (options.haschildren (node))\n"
+           "    {\n"
+           "        li.addEventListener ('click', (e) => {\n"
+           "            expandOrCollapseNodes (li, options, () => options.getchildren (node));\n"
+           "            e.stopPropagation ();\n"
+           "        });\n"
+           "    }\n"
+           "    else\n"
+           "    {\n"
+           "        li.addEventListener ('click', (e) => e.stopPropagation ());\n"
+           "    }\n"
+           "\n"
+           "    return li;\n"
            "}\n"
            "\n"
-           "function expandOrCollapseNodes (parent, options)\n"
+           "function createVirtualList (nodes, options)\n"
            "{\n"
-           "  var existingUls = parent.getElementsByTagName ('ul');\n"
-           "  if (existingUls.length > 0)\n"
-           "  {\n"
-           "    // Toggle the state\n"
-           "    var styles = window.getComputedStyle (existingUls.item(0));\n"
-           "    if (styles.getPropertyValue ('display') == 'none')\n"
+           "    var box = document.createElement ('div');\n"
+           "    box.setAttribute ('style', 'height:' + (virtualRowHeight * virtualVisibleRows) +\n"
+           "                      'px;overflow-y:auto;position:relative');\n"
+           "\n"
+           "    var spacer = document.createElement ('div');\n"
+           "    spacer.setAttribute ('style', 'height:' + (virtualRowHeight * nodes.length) + 'px');\n"
+           "    box.appendChild (spacer);\n"
+           "\n"
+           "    var ul = document.createElement ('ul');\n"
+           "    box.appendChild (ul);\n"
+           "\n"
+           "    // Rows in a virtual list have a fixed height, so the children of a\n"
+           "    // clicked row are shown below the list instead of inside it\n"
+           "    var details = document.createElement ('div');\n"
+           "\n"
+           "    var first = -1;\n"
+           "    const render = () => {\n"
+           "        const newFirst = Math.floor (box.scrollTop / virtualRowHeight);\n"
+           "        if (newFirst == first)\n"
+           "            return;\n"
+           "        first = newFirst;\n"
+           "\n"
+           "        ul.setAttribute ('style', 'position:absolute;margin:0;top:' +\n"
+           "                         (first * virtualRowHeight) + 'px');\n"
+           "        while (ul.firstChild)\n"
+           "            ul.removeChild (ul.firstChild);\n"
+           "\n"
+           "        const last = Math.min (nodes.length, first + virtualVisibleRows + 1);\n"
+           "        for (var i = first; i < last; ++i)\n"
+           "        {\n"
+           "            const node = nodes[i];\n"
+           "            var li = document.createElement ('li');\n"
+           "            li.setAttribute ('style', 'height:' + virtualRowHeight + 'px;white-space:nowrap');\n"
+           "            li.appendChild (document.createTextNode (options.getlabel(node)));\n"
+           "            li.addEventListener ('click', (e) => {\n"
+           "                while (details.firstChild)\n"
+           "                    details.removeChild (details.firstChild);\n"
+           "                var ul = document.createElement ('ul');\n"
+           "                ul.appendChild (createNode (node, options));\n"
+           "                details.appendChild (ul);\n"
+           "                e.stopPropagation ();\n"
+           "            });\n"
+           "            ul.appendChild (li);\n"
+           "        }\n"
+           "    };\n"
+           "    box.addEventListener ('scroll', render);\n"
+           "    render ();\n"
+           "\n"
+           "    var wrapper = document.createElement ('div');\n"
+           "    wrapper.appendChild (box);\n"
+           "    wrapper.appendChild (details);\n"
+           "    return wrapper;\n"
+           "}\n"
+           "\n"
+           "function expandOrCollapseNodes (parent, options, getnodes)\n"
+           "{\n"
+           "    var existing = parent.lastChild;\n"
+           "    if (existing != null && existing.className == 'minimalist-tree-children')\n"
            "    {\n"
-           "      existingUls.item(0).setAttribute ('style', 'display:block');\n"
+           "        // Toggle the state\n"
+           "        if (existing.style.display == 'none')\n"
+           "        {\n"
+           "            existing.style.display = 'block';\n"
+           "        }\n"
+           "        else\n"
+           "        {\n"
+           "            existing.style.display = 'none';\n"
+           "        }\n"
+           "        return;\n"
            "    }\n"
-           "    else\n"
+           "\n"
+           "    if (parent.dataset.loading)\n"
+           "    {\n"
+           "        return;\n"
+           "    }\n"
+           "    if (existing != null && existing.className == 'minimalist-tree-error')\n"
            "    {\n"
-           "      existingUls.item(0).setAttribute ('style', 'display:none');\n"
-           "     }\n"
-           "     return;\n"
-           "  }\n"
-           "  // Create a new list for the nodes\n"
-           "  var ul = document.createElement ('ul');\n"
-           "  options.getroots().forEach ( (node) => {\n"
-           "    addNode (ul, node, options);\n"
-           "  });\n"
-           "  parent.appendChild (ul);\n"
+           "        // Try again\n"
+           "        parent.removeChild (existing);\n"
+           "    }\n"
+           "    parent.dataset.loading = 'yes';\n"
+           "\n"
+           "    // The nodes may have to be fetched first\n"
+           "    Promise.resolve (getnodes ()).then ((nodes) => {\n"
+           "        var children;\n"
+           "        if (nodes.length > virtualListThreshold)\n"
+           "        {\n"
+           "            children = createVirtualList (nodes, options);\n"
+           "        }\n"
+           "        else\n"
+           "        {\n"
+           "            children = document.createElement ('ul');\n"
+           "            nodes.forEach ( (node) => {\n"
+           "                children.appendChild (createNode (node, options));\n"
+           "            });\n"
+           "        }\n"
+           "        children.className = 'minimalist-tree-children';\n"
+           "        children.style.display = 'block';\n"
+           "        parent.appendChild (children);\n"
+           "        delete parent.dataset.loading;\n"
+           "    }).catch ((error) => {\n"
+           "        var message = document.createElement ('div');\n"
+           "        message.className = 'minimalist-tree-error';\n"
+           "        message.textContent = 'Could not load the tree: ' + error.message;\n"
+           "        parent.appendChild (message);\n"
+           "        delete parent.dataset.loading;\n"
+           "    });\n"
+           "}\n"
+           "\n"
+           "// Loads the data files written by make --goaltree-html-dir.  Node n is\n"
+           "// described in data/chunk-<k>.js, k = floor ((n - 1) / chunkSize), which\n"
+           "// calls goalTreeChunk (k, [[label, [child, ...]], ...]).  Script tags are\n"
+           "// used instead of fetch () so that the viewer also works from file:// URLs\n"
+           "function GoalTreeChunks (chunkSize)\n"
+           "{\n"
+           "    const chunks = {};\n"
+           "    const waiting = {};\n"
+           "\n"
+           "    window.goalTreeChunk = (k, nodes) => {\n"
+           "        chunks[k] = nodes;\n"
+           "        if (waiting[k])\n"
+           "        {\n"
+           "            waiting[k].resolve ();\n"
+           "        }\n"
+           "    };\n"
+           "\n"
+           "    const chunkOf = (node) => Math.floor ((node - 1) / chunkSize);\n"
+           "\n"
+           "    const load = (k) => {\n"
+           "        if (!waiting[k])\n"
+           "        {\n"
+           "            var resolveChunk;\n"
+           "            var rejectChunk;\n"
+           "            const loaded = new Promise ((resolve, reject) => {\n"
+           "                resolveChunk = resolve;\n"
+           "                rejectChunk = reject;\n"
+           "            });\n"
+           "            waiting[k] = { promise : loaded, resolve : resolveChunk };\n"
+           "            var script = document.createElement ('script');\n"
+           "            script.src = 'data/chunk-' + k + '.js';\n"
+           "            const fail = () => {\n"
+           "                // Forget the attempt, so that expanding the node again retries\n"
+           "                delete waiting[k];\n"
+           "                script.remove ();\n"
+           "                rejectChunk (new Error ('data/chunk-' + k + '.js is missing or broken'));\n"
+           "            };\n"
+           "            script.onerror = fail;\n"
+           "            script.onload = () => {\n"
+           "                if (!chunks[k])\n"
+           "                {\n"
+           "                    fail ();\n"
+           "                }\n"
+           "            };\n"
+           "            document.head.appendChild (script);\n"
+           "        }\n"
+           "        return waiting[k].promise;\n"
+           "    };\n"
+           "\n"
+           "    return {\n"
+           "        ensure : (nodes) => {\n"
+           "            const needed = new Set (nodes.map (chunkOf));\n"
+           "            return Promise.all ([...needed].filter ((k) => !chunks[k]).map (load));\n"
+           "        },\n"
+           "        node : (node) => chunks[chunkOf (node)][(node - 1) %% chunkSize]\n"
+           "    };\n"
            "}\n");
 
   fclose (js_file);
@@ -11,7 +11,10 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-void print_goal_tree (struct goaldep * goals, FILE * f);
+/* Both return the errno of a write to F that failed, or 0 */
+int print_goal_tree (struct goaldep * goals, FILE * f);
+
+int print_goal_dag (struct goaldep * goals, FILE * f);
 
 void browse_goal_tree (struct goaldep * goals);
 
@@ -0,0 +1,555 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "job.h"
+#include "commands.h"
+#include "graph.h"
+#include "jsonout.h"
+
+#include <stdio.h>
+
+#define NOT_VISITED ((unsigned long) -1)
+
+unsigned long file_graph_node (struct file * f)
+{
+  check_renamed (f);
+  if (f->double_colon)
+    f = f->double_colon;
+  return f->graph_id;
+}
+
+/** Numbers every file in the data base and collects
+ * all the dependencies into CSR arrays */
+void file_graph_build (struct file_graph * g)
+{
+  unsigned long i;
+  unsigned long e;
+
+  g->nodes = get_all_files (&g->node_count);
+  for (i = 0; i < g->node_count; ++i)
+    {
+      struct file * f;
+      for (f = g->nodes[i]; f != NULL; f = f->prev)
+        f->graph_id = i;
+    }
+
+  /* First pass counts, second pass fills in */
+  g->edge_count = 0;
+  for (i = 0; i < g->node_count; ++i)
+    {
+      struct file * f;
+      struct dep * d;
+      for (f = g->nodes[i]; f != NULL; f = f->prev)
+        for (d = f->deps; d != NULL; d = d->next)
+          if (d->file != NULL)
+            ++g->edge_count;
+    }
+
+  g->first_edge = (unsigned long *) xmalloc ((g->node_count + 1) * sizeof (unsigned long));
+  g->edge_target = (unsigned long *) xmalloc ((g->edge_count + 1) * sizeof (unsigned long));
+  g->edge_dep = (struct dep **) xmalloc ((g->edge_count + 1) * sizeof (struct dep *));
+  g->edge_owner = (struct file **) xmalloc ((g->edge_count + 1) * sizeof (struct file *));
+
+  e = 0;
+  for (i = 0; i < g->node_count; ++i)
+    {
+      struct file * f;
+      struct dep * d;
+
+      g->first_edge[i] = e;
+      for (f = g->nodes[i]; f != NULL; f = f->prev)
+        for (d = f->deps; d != NULL; d = d->next)
+          if (d->file != NULL)
+            {
+              g->edge_target[e] = file_graph_node (d->file);
+              g->edge_dep[e] = d;
+              g->edge_owner[e] = f;
+              ++e;
+            }
+    }
+  g->first_edge[g->node_count] = e;
+}
+
+void file_graph_free (struct file_graph * g)
+{
+  free (g->nodes);
+  free (g->first_edge);
+  free (g->edge_target);
+  free (g->edge_dep);
+  free (g->edge_owner);
+  memset (g, 0, sizeof (*g));
+}
+
+/** Searches for implicit rules for the files reachable from GOALS that
+ * have no recipe, as updating them would, so that the dependencies those
+ * rules add (foo.c for foo.o, say) are part of the graph.  The search
+ * looks at the file system to see which prerequisites exist */
+void file_graph_add_implicit_dependencies (struct goaldep * goals)
+{
+  struct file ** queue;
+  unsigned long capacity = 256;
+  unsigned long count = 0;
+  unsigned long head;
+  struct goaldep * itr;
+
+  queue = (struct file **) xmalloc (capacity * sizeof (struct file *));
+  for (itr = goals; itr != NULL; itr = itr->next)
+    {
+      struct file * f = itr->file;
+      check_renamed (f);
+      if (!f->graph_mark)
+        {
+          if (count == capacity)
+            {
+              capacity *= 2;
+              queue = (struct file **) xrealloc (queue, capacity * sizeof (struct file *));
+            }
+          f->graph_mark = 1;
+          queue[count++] = f;
+        }
+    }
+
+  for (head = 0; head < count; ++head)
+    {
+      struct file * f = queue[head];
+      struct file * entry;
+      struct dep * d;
+
+      if (!f->phony && f->cmds == 0 && !f->tried_implicit)
+        {
+          try_implicit_rule (f, 0);
+          f->tried_implicit = 1;
+        }
+
+      /* Every double-colon entry has dependencies of its own */
+      for (entry = f; entry != NULL; entry = entry->prev)
+        for (d = entry->deps; d != NULL; d = d->next)
+          {
+            struct file * dep = d->file;
+            if (dep == NULL)
+              continue;
+            check_renamed (dep);
+            if (!dep->graph_mark)
+              {
+                if (count == capacity)
+                  {
+                    capacity *= 2;
+                    queue = (struct file **) xrealloc (queue, capacity * sizeof (struct file *));
+                  }
+                dep->graph_mark = 1;
+                queue[count++] = dep;
+              }
+          }
+    }
+
+  for (head = 0; head < count; ++head)
+    queue[head]->graph_mark = 0;
+  free (queue);
+}
+
+/** Tarjan's algorithm, with an explicit stack instead of recursion
+ * so that long dependency chains cannot overflow the C stack */
+unsigned long * file_graph_scc (const struct file_graph * g,
+                                unsigned long * component_count)
+{
+  const unsigned long n = g->node_count;
+  unsigned long * component = (unsigned long *) xmalloc ((n + 1) * sizeof (unsigned long));
+  unsigned long * index = (unsigned long *) xmalloc ((n + 1) * sizeof (unsigned long));
+  unsigned long * lowlink = (unsigned long *) xmalloc ((n + 1) * sizeof (unsigned long));
+  unsigned long * next_edge = (unsigned long *) xmalloc ((n + 1) * sizeof (unsigned long));
+  unsigned long * calls = (unsigned long *) xmalloc ((n + 1) * sizeof (unsigned long));
+  unsigned long * stack = (unsigned long *) xmalloc ((n + 1) * sizeof (unsigned long));
+  char * on_stack = (char *) xcalloc (n + 1);
+  unsigned long counter = 0;
+  unsigned long components = 0;
+  unsigned long ncalls = 0;
+  unsigned long nstack = 0;
+  unsigned long root;
+
+  for (root = 0; root < n; ++root)
+    index[root] = NOT_VISITED;
+
+  for (root = 0; root < n; ++root)
+    {
+      if (index[root] != NOT_VISITED)
+        continue;
+
+      index[root] = lowlink[root] = counter++;
+      next_edge[root] = g->first_edge[root];
+      stack[nstack++] = root;
+      on_stack[root] = 1;
+      calls[ncalls++] = root;
+
+      while (ncalls > 0)
+        {
+          unsigned long v = calls[ncalls - 1];
+
+          if (next_edge[v] < g->first_edge[v + 1])
+            {
+              unsigned long w = g->edge_target[next_edge[v]++];
+              if (index[w] == NOT_VISITED)
+                {
+                  index[w] = lowlink[w] = counter++;
+                  next_edge[w] = g->first_edge[w];
+                  stack[nstack++] = w;
+                  on_stack[w] = 1;
+                  calls[ncalls++] = w;
+                }
+              else if (on_stack[w] && index[w] < lowlink[v])
+                lowlink[v] = index[w];
+              continue;
+            }
+
+          /* All the dependencies of v are done */
+          --ncalls;
+          if (lowlink[v] == index[v])
+            {
+              unsigned long w;
+              do
+                {
+                  w = stack[--nstack];
+                  on_stack[w] = 0;
+                  component[w] = components;
+                }
+              while (w != v);
+              ++components;
+            }
+
+          if (ncalls > 0)
+            {
+              unsigned long u = calls[ncalls - 1];
+              if (lowlink[v] < lowlink[u])
+                lowlink[u] = lowlink[v];
+            }
+        }
+    }
+
+  free (index);
+  free (lowlink);
+  free (next_edge);
+  free (calls);
+  free (stack);
+  free (on_stack);
+
+  *component_count = components;
+  return component;
+}
+
+unsigned long file_graph_reachable (const struct file_graph * g,
+                                    struct goaldep * goals,
+                                    unsigned long * nodes,
+                                    unsigned char * reachable)
+{
+  struct goaldep * itr;
+  unsigned long count = 0;
+  unsigned long head;
+  unsigned long e;
+
+  for (itr = goals; itr != NULL; itr = itr->next)
+    {
+      unsigned long goal = file_graph_node (itr->file);
+      if (!reachable[goal])
+        {
+          reachable[goal] = 1;
+          nodes[count++] = goal;
+        }
+    }
+  for (head = 0; head < count; ++head)
+    {
+      unsigned long v = nodes[head];
+      for (e = g->first_edge[v]; e < g->first_edge[v + 1]; ++e)
+        if (!reachable[g->edge_target[e]])
+          {
+            reachable[g->edge_target[e]] = 1;
+            nodes[count++] = g->edge_target[e];
+          }
+    }
+
+  return count;
+}
+
+/** A counting sort of the edges by target */
+unsigned long * file_graph_reverse (const struct file_graph * g,
+                                    const unsigned char * within,
+                                    unsigned long ** reverse,
+                                    unsigned long ** reverse_edge)
+{
+  unsigned long * first = (unsigned long *) xcalloc ((g->node_count + 2) * sizeof (unsigned long));
+  unsigned long * fill;
+  unsigned long * sources;
+  unsigned long * edges = NULL;
+  unsigned long v;
+  unsigned long e;
+
+  for (v = 0; v < g->node_count; ++v)
+    if (within == NULL || within[v])
+      for (e = g->first_edge[v]; e < g->first_edge[v + 1]; ++e)
+        ++first[g->edge_target[e] + 1];
+  for (v = 0; v < g->node_count; ++v)
+    first[v + 1] += first[v];
+
+  sources = (unsigned long *) xmalloc ((first[g->node_count] + 1) * sizeof (unsigned long));
+  if (reverse_edge != NULL)
+    edges = (unsigned long *) xmalloc ((first[g->node_count] + 1) * sizeof (unsigned long));
+
+  fill = (unsigned long *) xmalloc ((g->node_count + 1) * sizeof (unsigned long));
+  memcpy (fill, first, (g->node_count + 1) * sizeof (unsigned long));
+  for (v = 0; v < g->node_count; ++v)
+    if (within == NULL || within[v])
+      for (e = g->first_edge[v]; e < g->first_edge[v + 1]; ++e)
+        {
+          unsigned long slot = fill[g->edge_target[e]]++;
+          sources[slot] = v;
+          if (edges != NULL)
+            edges[slot] = e;
+        }
+  free (fill);
+
+  *reverse = sources;
+  if (reverse_edge != NULL)
+    *reverse_edge = edges;
+  return first;
+}
+
+/** A counting sort of the nodes by component number */
+unsigned long * file_graph_order (const unsigned long * nodes,
+                                  unsigned long count,
+                                  const unsigned long * component,
+                                  unsigned long component_count)
+{
+  unsigned long * start = (unsigned long *) xcalloc ((component_count + 2) * sizeof (unsigned long));
+  unsigned long * sorted = (unsigned long *) xmalloc ((count + 1) * sizeof (unsigned long));
+  unsigned long i;
+
+  for (i = 0; i < count; ++i)
+    ++start[component[nodes[i]] + 1];
+  for (i = 0; i < component_count; ++i)
+    start[i + 1] += start[i];
+  for (i = 0; i < count; ++i)
+    sorted[start[component[nodes[i]]]++] = nodes[i];
+
+  free (start);
+  return sorted;
+}
+
+struct cycle
+{
+  unsigned long first;          /* offset of the members in the sorted array */
+  unsigned long size;
+};
+
+static const struct file_graph * sortGraph;
+
+static int node_name_compare (const void * a, const void * b)
+{
+  const unsigned long * aNode = (const unsigned long *) a;
+  const unsigned long * bNode = (const unsigned long *) b;
+  return strcmp (sortGraph->nodes[*aNode]->name, sortGraph->nodes[*bNode]->name);
+}
+
+static unsigned long * sortMembers;
+
+static int cycle_compare (const void * a, const void * b)
+{
+  const struct cycle * aCycle = (const struct cycle *) a;
+  const struct cycle * bCycle = (const struct cycle *) b;
+  return node_name_compare (&sortMembers[aCycle->first],
+                            &sortMembers[bCycle->first]);
+}
+
+/** Location of the rule an edge was written in, if it had a recipe */
+static const floc * edge_location (const struct file_graph * g, unsigned long e)
+{
+  const struct file * owner = g->edge_owner[e];
+  if (owner->cmds != NULL && owner->cmds->fileinfo.filenm != NULL)
+    return &owner->cmds->fileinfo;
+  return NULL;
+}
+
+/** Finds every strongly connected component of the dependency graph
+ * that contains a cycle and reports it, along with the edges between
+ * its members.  If filename is "-" the report is printed as text on
+ * stdout, otherwise it is written to filename as JSON */
+void report_cycles (const char * filename)
+{
+  struct file_graph g;
+  unsigned long componentCount;
+  unsigned long * component;
+  unsigned long * start;
+  unsigned long * members;
+  struct cycle * cycles;
+  unsigned long cycleCount = 0;
+  unsigned long i;
+  unsigned long c;
+  FILE * f = NULL;
+  struct json_writer w;
+  int json = !streq (filename, "-");
+
+  file_graph_build (&g);
+  component = file_graph_scc (&g, &componentCount);
+
+  /* Group the nodes by component (a counting sort) */
+  start = (unsigned long *) xcalloc ((componentCount + 1) * sizeof (unsigned long));
+  members = (unsigned long *) xmalloc ((g.node_count + 1) * sizeof (unsigned long));
+  for (i = 0; i < g.node_count; ++i)
+    ++start[component[i] + 1];
+  for (c = 0; c < componentCount; ++c)
+    start[c + 1] += start[c];
+  {
+    unsigned long * fill = (unsigned long *) xmalloc ((componentCount + 1) * sizeof (unsigned long));
+    memcpy (fill, start, (componentCount + 1) * sizeof (unsigned long));
+    for (i = 0; i < g.node_count; ++i)
+      members[fill[component[i]]++] = i;
+    free (fill);
+  }
+
+  /* A component is a cycle if it has several members
+     or if its only member depends on itself */
+  cycles = (struct cycle *) xmalloc ((componentCount + 1) * sizeof (struct cycle));
+  sortGraph = &g;
+  for (c = 0; c < componentCount; ++c)
+    {
+      unsigned long size = start[c + 1] - start[c];
+      int isCycle = size > 1;
+
+      if (!isCycle)
+        {
+          unsigned long node = members[start[c]];
+          unsigned long e;
+          for (e = g.first_edge[node]; e < g.first_edge[node + 1]; ++e)
+            if (g.edge_target[e] == node)
+              isCycle = 1;
+        }
+
+      if (isCycle)
+        {
+          qsort (&members[start[c]], size, sizeof (unsigned long), node_name_compare);
+          cycles[cycleCount].first = start[c];
+          cycles[cycleCount].size = size;
+          ++cycleCount;
+        }
+    }
+  sortMembers = members;
+  qsort (cycles, cycleCount, sizeof (struct cycle), cycle_compare);
+
+  if (json)
+    {
+      f = fopen (filename, "w");
+      if (f == NULL)
+        {
+          perror_with_name (_("fopen (cycles file): "), filename);
+          goto done;
+        }
+      json_init (&w, f, 0);
+      json_begin_object (&w);
+      json_key (&w, "cycles");
+      json_begin_array (&w);
+    }
+
+  for (c = 0; c < cycleCount; ++c)
+    {
+      unsigned long m;
+      unsigned long cycleComponent = component[members[cycles[c].first]];
+
+      if (json)
+        {
+          json_begin_object (&w);
+          json_key (&w, "size");
+          json_ulong (&w, cycles[c].size);
+          json_key (&w, "members");
+          json_begin_array (&w);
+          for (m = 0; m < cycles[c].size; ++m)
+            json_string (&w, g.nodes[members[cycles[c].first + m]]->name);
+          json_end_array (&w);
+          json_key (&w, "edges");
+          json_begin_array (&w);
+        }
+      else
+        {
+          printf (_("Dependency cycle %lu (%lu files):"), c + 1, cycles[c].size);
+          for (m = 0; m < cycles[c].size; ++m)
+            printf (" %s", g.nodes[members[cycles[c].first + m]]->name);
+          printf ("\n");
+        }
+
+      for (m = 0; m < cycles[c].size; ++m)
+        {
+          unsigned long node = members[cycles[c].first + m];
+          unsigned long e;
+          for (e = g.first_edge[node]; e < g.first_edge[node + 1]; ++e)
+            {
+              const floc * location;
+
+              if (component[g.edge_target[e]] != cycleComponent)
+                continue;
+
+              location = edge_location (&g, e);
+              if (json)
+                {
+                  json_begin_object (&w);
+                  json_key (&w, "from");
+                  json_string (&w, g.nodes[node]->name);
+                  json_key (&w, "to");
+                  json_string (&w, g.nodes[g.edge_target[e]]->name);
+                  if (location != NULL)
+                    {
+                      json_key (&w, "file");
+                      json_string (&w, location->filenm);
+                      json_key (&w, "line");
+                      json_ulong (&w, location->lineno);
+                    }
+                  json_key (&w, "order_only");
+                  json_bool (&w, g.edge_dep[e]->ignore_mtime);
+                  json_end_object (&w);
+                }
+              else
+                {
+                  printf ("  %s -> %s%s", g.nodes[node]->name,
+                          g.nodes[g.edge_target[e]]->name,
+                          g.edge_dep[e]->ignore_mtime ? " [order-only]" : "");
+                  if (location != NULL)
+                    printf (" (%s:%lu)", location->filenm, location->lineno);
+                  printf ("\n");
+                }
+            }
+        }
+
+      if (json)
+        {
+          json_end_array (&w);
+          json_end_object (&w);
+        }
+    }
+
+  if (json)
+    {
+      json_end_array (&w);
+      json_key (&w, "count");
+      json_ulong (&w, cycleCount);
+      json_end_object (&w);
+      json_finish (&w);
+      fclose (f);
+    }
+  else if (cycleCount == 0)
+    printf (_("No dependency cycles found.\n"));
+
+ done:
+  free (cycles);
+  free (members);
+  free (start);
+  free (component);
+  file_graph_free (&g);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A compact snapshot of the file/dependency graph.  Every file in the
+   data base becomes a node numbered 0..node_count-1 (the number is also
+   stored in the file's graph_id), and the dependencies of node N are
+   edge_target[first_edge[N]] .. edge_target[first_edge[N+1]-1].
+   Dependencies of all the double-colon entries of a file are merged into
+   that file's node.  */
+struct file_graph
+{
+  unsigned long node_count;
+  unsigned long edge_count;
+  struct file ** nodes;
+  unsigned long * first_edge;
+  unsigned long * edge_target;
+  struct dep ** edge_dep;       /* the dependency each edge came from */
+  struct file ** edge_owner;    /* the (double-colon) entry holding it */
+};
+
+void file_graph_build (struct file_graph * g);
+void file_graph_free (struct file_graph * g);
+
+/* Searches for implicit rules for the files reachable from GOALS that
+   have no recipe, as updating them would, so that the dependencies those
+   rules add are in the graph file_graph_build makes next */
+void file_graph_add_implicit_dependencies (struct goaldep * goals);
+
+/* Returns the node number of F, following renames */
+unsigned long file_graph_node (struct file * f);
+
+/* Returns an array mapping every node to the number of its strongly
+   connected component and sets *component_count.  Components are
+   numbered in reverse topological order: a component's dependencies
+   always have smaller numbers than the component itself */
+unsigned long * file_graph_scc (const struct file_graph * g,
+                                unsigned long * component_count);
+
+/* Stores the nodes reachable from GOALS in NODES, in breadth-first
+   order, marks them in REACHABLE and returns how many there are.  Both
+   arrays need room for every node of G */
+unsigned long file_graph_reachable (const struct file_graph * g,
+                                    struct goaldep * goals,
+                                    unsigned long * nodes,
+                                    unsigned char * reachable);
+
+/* Builds the reverse edges of G and returns FIRST_REVERSE: the files
+   depending on node N are reverse[first_reverse[N]] ..
+   reverse[first_reverse[N+1]-1], and if REVERSE_EDGE is not NULL it
+   receives the forward edge each of them came from.  Only the edges of
+   the nodes marked in WITHIN are reversed, or all of them if WITHIN is
+   NULL */
+unsigned long * file_graph_reverse (const struct file_graph * g,
+                                    const unsigned char * within,
+                                    unsigned long ** reverse,
+                                    unsigned long ** reverse_edge);
+
+/* Returns a copy of NODES sorted by COMPONENT (from file_graph_scc),
+   so that every node comes after its dependencies, except for the
+   dependencies it shares a cycle with */
+unsigned long * file_graph_order (const unsigned long * nodes,
+                                  unsigned long count,
+                                  const unsigned long * component,
+                                  unsigned long component_count);
+
+void report_cycles (const char * filename);
+void report_graph_stats (struct goaldep * goals, const char * filename);
+void report_critical_path (struct goaldep * goals, const char * history);
+void report_affected_by (struct goaldep * goals, const char ** files);
+
+void write_goal_graph_binary (struct goaldep * goals, const char * filename);
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "graph.h"
+#include "jsonout.h"
+#include "mkgraph.h"
+
+#include <stdio.h>
+
+static uint64_t align8 (uint64_t n)
+{
+  return (n + 7) & ~(uint64_t) 7;
+}
+
+static void write_padding (struct outbuf * out, uint64_t from, uint64_t to)
+{
+  static const char zeros[8] = { 0 };
+  outbuf_write (out, zeros, to - from);
+}
+
+static uint32_t node_flags (const struct file * f)
+{
+  uint32_t flags = 0;
+
+  if (f->is_target)
+    flags |= MKGRAPH_NODE_TARGET;
+  if (f->cmds != NULL)
+    flags |= MKGRAPH_NODE_HAS_RECIPE;
+  if (f->phony)
+    flags |= MKGRAPH_NODE_PHONY;
+  if (f->precious)
+    flags |= MKGRAPH_NODE_PRECIOUS;
+  if (f->intermediate)
+    flags |= MKGRAPH_NODE_INTERMEDIATE;
+  if (f->secondary)
+    flags |= MKGRAPH_NODE_SECONDARY;
+  if (f->double_colon)
+    flags |= MKGRAPH_NODE_DOUBLE_COLON;
+
+  return flags;
+}
+
+/** Writes the whole file graph to filename in the format
+ * described in graph-reader/mkgraph.h */
+void write_goal_graph_binary (struct goaldep * goals, const char * filename)
+{
+  struct file_graph g;
+  struct mkgraph_header header;
+  struct outbuf out;
+  struct goaldep * itr;
+  uint64_t stringsSize = 0;
+  uint64_t offset;
+  unsigned long i;
+  int error;
+  FILE * f;
+
+  f = fopen (filename, "wb");
+  if (f == NULL)
+    {
+      perror_with_name (_("fopen (goaltree binary file): "), filename);
+      return;
+    }
+
+  file_graph_build (&g);
+
+  for (i = 0; i < g.node_count; ++i)
+    stringsSize += strlen (g.nodes[i]->name) + 1;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, MKGRAPH_MAGIC, sizeof (MKGRAPH_MAGIC));
+  header.version = MKGRAPH_VERSION;
+  header.byte_order = MKGRAPH_BYTE_ORDER;
+  header.node_count = g.node_count;
+  header.edge_count = g.edge_count;
+  for (itr = goals; itr != NULL; itr = itr->next)
+    ++header.goal_count;
+
+  offset = align8 (sizeof (header));
+  header.strings_offset = offset;
+  header.strings_size = stringsSize;
+  offset = align8 (offset + stringsSize);
+  header.nodes_offset = offset;
+  offset += g.node_count * sizeof (struct mkgraph_node);
+  header.first_edge_offset = offset;
+  offset += (g.node_count + 1) * sizeof (uint64_t);
+  header.edge_target_offset = offset;
+  offset = align8 (offset + g.edge_count * sizeof (uint32_t));
+  header.edge_flags_offset = offset;
+  offset = align8 (offset + g.edge_count);
+  header.goals_offset = offset;
+  offset = align8 (offset + header.goal_count * sizeof (uint32_t));
+  header.file_size = offset;
+
+  outbuf_init (&out, f);
+  outbuf_write (&out, (const char *) &header, sizeof (header));
+  write_padding (&out, sizeof (header), header.strings_offset);
+
+  for (i = 0; i < g.node_count; ++i)
+    outbuf_write (&out, g.nodes[i]->name, strlen (g.nodes[i]->name) + 1);
+  write_padding (&out, header.strings_offset + stringsSize, header.nodes_offset);
+
+  {
+    uint64_t nameOffset = 0;
+    char * isGoal = (char *) xcalloc (g.node_count + 1);
+    for (itr = goals; itr != NULL; itr = itr->next)
+      isGoal[file_graph_node (itr->file)] = 1;
+
+    for (i = 0; i < g.node_count; ++i)
+      {
+        struct mkgraph_node node;
+        node.name = nameOffset;
+        node.flags = node_flags (g.nodes[i]);
+        if (isGoal[i])
+          node.flags |= MKGRAPH_NODE_GOAL;
+        node.reserved = 0;
+        nameOffset += strlen (g.nodes[i]->name) + 1;
+        outbuf_write (&out, (const char *) &node, sizeof (node));
+      }
+    free (isGoal);
+  }
+
+  for (i = 0; i <= g.node_count; ++i)
+    {
+      uint64_t first = g.first_edge[i];
+      outbuf_write (&out, (const char *) &first, sizeof (first));
+    }
+
+  for (i = 0; i < g.edge_count; ++i)
+    {
+      uint32_t target = (uint32_t) g.edge_target[i];
+      outbuf_write (&out, (const char *) &target, sizeof (target));
+    }
+  write_padding (&out, header.edge_target_offset + g.edge_count * sizeof (uint32_t),
+                 header.edge_flags_offset);
+
+  for (i = 0; i < g.edge_count; ++i)
+    {
+      const struct dep * d = g.edge_dep[i];
+      char flags = 0;
+      if (d->ignore_mtime)
+        flags |= MKGRAPH_EDGE_ORDER_ONLY;
+      if (d->staticpattern)
+        flags |= MKGRAPH_EDGE_STATIC_PATTERN;
+      if (d->need_2nd_expansion)
+        flags |= MKGRAPH_EDGE_SECOND_EXPANSION;
+      outbuf_putc (&out, flags);
+    }
+  write_padding (&out, header.edge_flags_offset + g.edge_count, header.goals_offset);
+
+  for (itr = goals; itr != NULL; itr = itr->next)
+    {
+      uint32_t goal = (uint32_t) file_graph_node (itr->file);
+      outbuf_write (&out, (const char *) &goal, sizeof (goal));
+    }
+  write_padding (&out, header.goals_offset + header.goal_count * sizeof (uint32_t),
+                 header.file_size);
+
+  error = outbuf_close (&out);
+  if (fclose (f) != 0 && error == 0)
+    error = errno;
+  if (error != 0)
+    {
+      errno = error;
+      perror_with_name (_("write: "), filename);
+    }
+
+  file_graph_free (&g);
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "graph.h"
+#include "jsonout.h"
+
+#include <stdio.h>
+
+/* How many of the most depended-upon files to list */
+#define GRAPH_STATS_TOP 20
+
+/* Degree histograms use power-of-two buckets: 0, 1, 2-3, 4-7, ... */
+#define DEGREE_BUCKETS 40
+
+struct degree_stats
+{
+  unsigned long max;
+  unsigned long total;
+  unsigned long buckets[DEGREE_BUCKETS];
+};
+
+static void add_degree (struct degree_stats * stats, unsigned long degree)
+{
+  unsigned int bucket = 0;
+  unsigned long d;
+
+  for (d = degree; d != 0; d >>= 1)
+    ++bucket;
+
+  ++stats->buckets[bucket];
+  stats->total += degree;
+  if (degree > stats->max)
+    stats->max = degree;
+}
+
+static unsigned long bucket_low (unsigned int bucket)
+{
+  return bucket == 0 ? 0 : 1UL << (bucket - 1);
+}
+
+static unsigned long bucket_high (unsigned int bucket)
+{
+  return bucket == 0 ? 0 : (1UL << bucket) - 1;
+}
+
+static const struct file_graph * sortGraph;
+static unsigned long * sortFanIn;
+
+/** Orders by decreasing fan-in, then by name */
+static int fan_in_compare (const void * a, const void * b)
+{
+  unsigned long aNode = *(const unsigned long *) a;
+  unsigned long bNode = *(const unsigned long *) b;
+
+  if (sortFanIn[aNode] != sortFanIn[bNode])
+    return sortFanIn[aNode] < sortFanIn[bNode] ? 1 : -1;
+  return strcmp (sortGraph->nodes[aNode]->name, sortGraph->nodes[bNode]->name);
+}
+
+/** Counts the files that (transitively) depend on node
+ * among the reachable ones, by a walk over the reverse edges */
+static unsigned long count_dependers (unsigned long node,
+                                      const unsigned long * firstReverse,
+                                      const unsigned long * reverse,
+                                      unsigned long * queue,
+                                      unsigned char * seen,
+                                      unsigned long nodeCount)
+{
+  unsigned long head = 0;
+  unsigned long tail = 0;
+  unsigned long e;
+
+  memset (seen, 0, nodeCount);
+  seen[node] = 1;
+  queue[tail++] = node;
+  while (head < tail)
+    {
+      unsigned long v = queue[head++];
+      for (e = firstReverse[v]; e < firstReverse[v + 1]; ++e)
+        if (!seen[reverse[e]])
+          {
+            seen[reverse[e]] = 1;
+            queue[tail++] = reverse[e];
+          }
+    }
+
+  return tail - 1;
+}
+
+static void print_degree_stats_text (const char * title,
+                                     const struct degree_stats * stats,
+                                     unsigned long nodes)
+{
+  unsigned int b;
+
+  printf (_("%s: max %lu, mean %.2f\n"), title, stats->max,
+          nodes ? (double) stats->total / nodes : 0.0);
+  for (b = 0; b < DEGREE_BUCKETS; ++b)
+    {
+      char range[64];
+      if (stats->buckets[b] == 0)
+        continue;
+      if (bucket_low (b) == bucket_high (b))
+        sprintf (range, "%lu", bucket_low (b));
+      else
+        sprintf (range, "%lu-%lu", bucket_low (b), bucket_high (b));
+      printf ("  %15s: %lu\n", range, stats->buckets[b]);
+    }
+}
+
+static void print_degree_stats_json (struct json_writer * w, const char * key,
+                                     const struct degree_stats * stats,
+                                     unsigned long nodes)
+{
+  unsigned int b;
+
+  json_key (w, key);
+  json_begin_object (w);
+  json_key (w, "max");
+  json_ulong (w, stats->max);
+  json_key (w, "mean");
+  json_double (w, nodes ? (double) stats->total / nodes : 0.0);
+  json_key (w, "histogram");
+  json_begin_array (w);
+  for (b = 0; b < DEGREE_BUCKETS; ++b)
+    {
+      if (stats->buckets[b] == 0)
+        continue;
+      json_begin_object (w);
+      json_key (w, "min");
+      json_ulong (w, bucket_low (b));
+      json_key (w, "max");
+      json_ulong (w, bucket_high (b));
+      json_key (w, "count");
+      json_ulong (w, stats->buckets[b]);
+      json_end_object (w);
+    }
+  json_end_array (w);
+  json_end_object (w);
+}
+
+/** Walks the part of the dependency graph reachable from the goals
+ * once and reports its size, fan-in and fan-out distributions, the
+ * most depended-upon files, and the width of every level of a
+ * topological layering, whose maximum is the most jobs that could
+ * ever run at once.  Implicit rules are searched first, so the graph
+ * has the dependencies and recipes they supply.  If filename is "-" the
+ * report is printed as text on stdout, otherwise it is written to
+ * filename as JSON */
+void report_graph_stats (struct goaldep * goals, const char * filename)
+{
+  struct file_graph g;
+  unsigned long componentCount;
+  unsigned long * component;
+  unsigned long * queue;
+  unsigned char * reachable;
+  unsigned long * fanIn;
+  unsigned long * level;
+  unsigned long * order;
+  unsigned long * firstReverse;
+  unsigned long * reverse;
+  unsigned long * levelWidth;
+  unsigned long * hottest;
+  struct degree_stats fanInStats;
+  struct degree_stats fanOutStats;
+  unsigned long nodes = 0;
+  unsigned long edges = 0;
+  unsigned long orderOnly = 0;
+  unsigned long withRecipe = 0;
+  unsigned long leaves = 0;
+  unsigned long depth = 0;
+  unsigned long widest = 0;
+  unsigned long hottestCount;
+  unsigned long head = 0;
+  unsigned long i;
+  unsigned long e;
+  int json = !streq (filename, "-");
+
+  file_graph_add_implicit_dependencies (goals);
+  file_graph_build (&g);
+  memset (&fanInStats, 0, sizeof (fanInStats));
+  memset (&fanOutStats, 0, sizeof (fanOutStats));
+
+  /* Find the reachable part of the graph */
+  queue = (unsigned long *) xmalloc ((g.node_count + 1) * sizeof (unsigned long));
+  reachable = (unsigned char *) xcalloc (g.node_count + 1);
+  nodes = file_graph_reachable (&g, goals, queue, reachable);
+
+  /* Degrees, and the reverse edges for the transitive counts */
+  fanIn = (unsigned long *) xcalloc ((g.node_count + 1) * sizeof (unsigned long));
+  for (head = 0; head < nodes; ++head)
+    {
+      unsigned long v = queue[head];
+      unsigned long outDegree = g.first_edge[v + 1] - g.first_edge[v];
+
+      add_degree (&fanOutStats, outDegree);
+      edges += outDegree;
+      if (outDegree == 0)
+        ++leaves;
+      if (g.nodes[v]->cmds != NULL)
+        ++withRecipe;
+      for (e = g.first_edge[v]; e < g.first_edge[v + 1]; ++e)
+        {
+          ++fanIn[g.edge_target[e]];
+          if (g.edge_dep[e]->ignore_mtime)
+            ++orderOnly;
+        }
+    }
+  for (head = 0; head < nodes; ++head)
+    add_degree (&fanInStats, fanIn[queue[head]]);
+
+  firstReverse = file_graph_reverse (&g, reachable, &reverse, NULL);
+
+  /* Levels: a file with no dependencies is on level 0, any other one
+     level above its highest dependency.  Visiting the nodes in the order
+     of their strongly connected components visits dependencies first;
+     edges inside a component (cycles) are ignored */
+  component = file_graph_scc (&g, &componentCount);
+  order = file_graph_order (queue, nodes, component, componentCount);
+
+  level = (unsigned long *) xcalloc ((g.node_count + 1) * sizeof (unsigned long));
+  for (i = 0; i < nodes; ++i)
+    {
+      unsigned long v = order[i];
+      for (e = g.first_edge[v]; e < g.first_edge[v + 1]; ++e)
+        {
+          unsigned long w = g.edge_target[e];
+          if (component[w] != component[v] && level[w] + 1 > level[v])
+            level[v] = level[w] + 1;
+        }
+      if (level[v] + 1 > depth)
+        depth = level[v] + 1;
+    }
+
+  levelWidth = (unsigned long *) xcalloc ((depth + 1) * sizeof (unsigned long));
+  for (i = 0; i < nodes; ++i)
+    ++levelWidth[level[order[i]]];
+  for (i = 0; i < depth; ++i)
+    if (levelWidth[i] > levelWidth[widest])
+      widest = i;
+
+  /* The most depended-upon files */
+  hottest = (unsigned long *) xmalloc ((nodes + 1) * sizeof (unsigned long));
+  memcpy (hottest, queue, nodes * sizeof (unsigned long));
+  sortGraph = &g;
+  sortFanIn = fanIn;
+  qsort (hottest, nodes, sizeof (unsigned long), fan_in_compare);
+  hottestCount = nodes < GRAPH_STATS_TOP ? nodes : GRAPH_STATS_TOP;
+
+  if (json)
+    {
+      struct json_writer w;
+      FILE * f = fopen (filename, "w");
+      if (f == NULL)
+        {
+          perror_with_name (_("fopen (graph stats file): "), filename);
+          goto done;
+        }
+
+      json_init (&w, f, 0);
+      json_begin_object (&w);
+      json_key (&w, "files");
+      json_ulong (&w, nodes);
+      json_key (&w, "files_with_recipes");
+      json_ulong (&w, withRecipe);
+      json_key (&w, "leaves");
+      json_ulong (&w, leaves);
+      json_key (&w, "dependencies");
+      json_ulong (&w, edges);
+      json_key (&w, "order_only_dependencies");
+      json_ulong (&w, orderOnly);
+      print_degree_stats_json (&w, "fan_in", &fanInStats, nodes);
+      print_degree_stats_json (&w, "fan_out", &fanOutStats, nodes);
+      json_key (&w, "hottest");
+      json_begin_array (&w);
+      for (i = 0; i < hottestCount; ++i)
+        {
+          unsigned long v = hottest[i];
+          json_begin_object (&w);
+          json_key (&w, "name");
+          json_string (&w, g.nodes[v]->name);
+          json_key (&w, "dependers");
+          json_ulong (&w, fanIn[v]);
+          json_key (&w, "transitive_dependers");
+          json_ulong (&w, count_dependers (v, firstReverse, reverse, queue,
+                                           reachable, g.node_count));
+          json_end_object (&w);
+        }
+      json_end_array (&w);
+      json_key (&w, "depth");
+      json_ulong (&w, depth);
+      json_key (&w, "level_widths");
+      json_begin_array (&w);
+      for (i = 0; i < depth; ++i)
+        json_ulong (&w, levelWidth[i]);
+      json_end_array (&w);
+      json_key (&w, "max_parallelism");
+      json_ulong (&w, depth ? levelWidth[widest] : 0);
+      json_end_object (&w);
+      json_finish (&w);
+      fclose (f);
+    }
+  else
+    {
+      printf (_("Dependency graph statistics\n"));
+      printf (_("files: %lu (%lu with recipes, %lu with no dependencies)\n"),
+              nodes, withRecipe, leaves);
+      printf (_("dependencies: %lu (%lu order-only)\n"), edges, orderOnly);
+      print_degree_stats_text (_("fan-in"), &fanInStats, nodes);
+      print_degree_stats_text (_("fan-out"), &fanOutStats, nodes);
+      printf (_("most depended-upon files (direct, transitive dependers):\n"));
+      for (i = 0; i < hottestCount; ++i)
+        {
+          unsigned long v = hottest[i];
+          unsigned long transitive = count_dependers (v, firstReverse, reverse,
+                                                      queue, reachable,
+                                                      g.node_count);
+          printf ("  %8lu %8lu  %s\n", fanIn[v], transitive, g.nodes[v]->name);
+        }
+      printf (_("depth: %lu levels\n"), depth);
+      printf (_("level widths:"));
+      for (i = 0; i < depth; ++i)
+        printf (" %lu", levelWidth[i]);
+      printf ("\n");
+      printf (_("maximum parallelism: %lu (level %lu)\n"),
+              depth ? levelWidth[widest] : 0, widest);
+    }
+
+ done:
+  free (hottest);
+  free (levelWidth);
+  free (level);
+  free (order);
+  free (component);
+  free (reverse);
+  free (firstReverse);
+  free (fanIn);
+  free (reachable);
+  free (queue);
+  file_graph_free (&g);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "graph.h"
+#include "history.h"
+
+#include <stdio.h>
+
+static FILE * historyFile = NULL;
+
+double recipe_clock (void)
+{
+#if HAVE_CLOCK_GETTIME && defined CLOCK_REALTIME
+  {
+    struct timespec timespec;
+    if (clock_gettime (CLOCK_REALTIME, &timespec) == 0)
+      return timespec.tv_sec + timespec.tv_nsec / 1e9;
+  }
+#endif
+#if HAVE_GETTIMEOFDAY
+  {
+    struct timeval timeval;
+    if (gettimeofday (&timeval, 0) == 0)
+      return timeval.tv_sec + timeval.tv_usec / 1e6;
+  }
+#endif
+  return (double) time ((time_t *) 0);
+}
+
+/** Opens the history file for appending.  Nothing is recorded
+ * while only printing, questioning or touching targets, since no
+ * recipe really runs then */
+void init_duration_history (const char * filename)
+{
+  if (just_print_flag || question_flag || touch_flag)
+    return;
+
+  historyFile = fopen (filename, "a");
+  if (historyFile == NULL)
+    perror_with_name (_("fopen (duration history file): "), filename);
+}
+
+void record_recipe_duration (const struct file * file, double seconds)
+{
+  if (historyFile == NULL)
+    {
+      return;
+    }
+
+  /* Flush every record, so that a build which dies
+     still leaves the durations of the recipes it finished */
+  fprintf (historyFile, "%.6f\t%s\n", seconds < 0 ? 0.0 : seconds, file->name);
+  fflush (historyFile);
+}
+
+double * load_recipe_durations (const char * filename,
+                                const struct file_graph * g)
+{
+  FILE * f = fopen (filename, "r");
+  double * durations;
+  char * line;
+  size_t size = 256;
+  unsigned long i;
+
+  if (f == NULL)
+    {
+      perror_with_name (_("fopen (duration history file): "), filename);
+      return NULL;
+    }
+
+  durations = (double *) xmalloc ((g->node_count + 1) * sizeof (double));
+  for (i = 0; i < g->node_count; ++i)
+    durations[i] = -1.0;
+
+  line = (char *) xmalloc (size);
+  while (fgets (line, size, f) != NULL)
+    {
+      size_t len = strlen (line);
+      char * name;
+      char * end;
+      double seconds;
+      struct file * file;
+
+      /* Grow the buffer until the whole line fits */
+      while (len > 0 && line[len - 1] != '\n' && !feof (f))
+        {
+          size *= 2;
+          line = (char *) xrealloc (line, size);
+          if (fgets (line + len, size - len, f) == NULL)
+            break;
+          len += strlen (line + len);
+        }
+      if (len > 0 && line[len - 1] == '\n')
+        line[--len] = '\0';
+
+      if (line[0] == '#')
+        continue;
+      name = strchr (line, '\t');
+      if (name == NULL)
+        continue;
+      *name++ = '\0';
+      seconds = strtod (line, &end);
+      if (end == line || *end != '\0' || seconds < 0)
+        continue;
+
+      file = lookup_file (name);
+      if (file != NULL)
+        durations[file_graph_node (file)] = seconds;
+    }
+
+  free (line);
+  fclose (f);
+  return durations;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Recipe durations are appended to a plain text history file, one
+   "<seconds><TAB><target>" line per finished recipe.  Later lines for
+   the same target override earlier ones, so a file can be shared by
+   any number of runs.  */
+
+struct file;
+struct file_graph;
+
+/* Wall-clock time in seconds, with sub-second precision where the
+   system has it */
+double recipe_clock (void);
+
+void init_duration_history (const char * filename);
+void record_recipe_duration (const struct file * file, double seconds);
+
+/* Reads a history file and returns the duration of every node of G,
+   or a negative number for nodes it has no record of.  Returns NULL
+   if the file cannot be read */
+double * load_recipe_durations (const char * filename,
+                                const struct file_graph * g);
@@ -23,8 +23,10 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "job.h"      /* struct child, used inside commands.h */
 #include "commands.h" /* set_file_variables */
 
+struct stem_place;
 static int pattern_search (struct file *file, int archive,
-                           unsigned int depth, unsigned int recursions);
+                           unsigned int depth, unsigned int recursions,
+                           const struct stem_place *place);
 
 /* For a FILE which has no commands specified, try to figure out some
    from the implicit pattern rules.
@@ -42,7 +44,7 @@ try_implicit_rule (struct file *file, unsigned int depth)
      (the archive search omits the archive name), it is more specific and
      should come first.  */
 
-  if (pattern_search (file, 0, depth, 0))
+  if (pattern_search (file, 0, depth, 0, NULL))
     return 1;
 
 #ifndef NO_ARCHIVES
@@ -52,7 +54,7 @@ try_implicit_rule (struct file *file, unsigned int depth)
     {
       DBF (DB_IMPLICIT,
            _("Looking for archive-member implicit rule for '%s'.\n"));
-      if (pattern_search (file, 1, depth, 0))
+      if (pattern_search (file, 1, depth, 0, NULL))
         return 1;
     }
 #endif
@@ -172,6 +174,11 @@ struct tryrule
 
     /* Nonzero if the LASTSLASH logic was used in matching this rule. */
     char checked_lastslash;
+
+    /* The rule that matched, even once RULE is found not to apply, and
+       the prerequisite of it that could not be found or made.  */
+    struct rule *matched;
+    struct dep *lacking;
   };
 
 int
@@ -183,6 +190,368 @@ stemlen_compare (const void *v1, const void *v2)
   return r != 0 ? r : (int) (r1->order - r2->order);
 }
 
+/* Dead ends of implicit rule chains.
+
+   A search for a rule to make an intermediate file usually fails, and
+   fails the same way for the next file: foo.c cannot be made from a
+   foo.y that cannot be checked out of RCS/foo.y,v, and neither can bar.c
+   from bar.y.  When a search for an intermediate file fails only for
+   want of files that are not in their directories at all, in any name
+   like the one it looked for, and no pattern rule could match the name
+   differently with another stem, the failure holds for every name of the
+   same shape: the same text before and after the stem of the rule that
+   wanted the file.  It is remembered as a dead end.  A later search for
+   a name of that shape only checks that none of the files it would look
+   for are targets or mentioned in the makefiles, as those are the only
+   ones the directory cache does not account for.
+
+   Names themselves are marked impossible (see file_impossible) once a
+   search for them fails, as before.  */
+
+/* Where the stem of the rule that wants an intermediate file is in the
+   name of that file.  */
+
+struct stem_place
+  {
+    size_t start;
+    size_t length;
+  };
+
+/* A rule that could not make any name of a dead end's shape, and how to
+   get the name of the prerequisite it lacked from such a name.  */
+
+struct dead_end_step
+  {
+    size_t drop;        /* Chars of the prefix before the rule's stem.  */
+    size_t keep;        /* Chars of the suffix in the rule's stem.  */
+    const char *prefix; /* Around the rule's stem in the prerequisite.  */
+    const char *suffix;
+    int terminal;       /* Nonzero if the prerequisite is not made.  */
+  };
+
+struct dead_end
+  {
+    const char *prefix;         /* Both in the strcache.  */
+    const char *suffix;
+    unsigned int nsteps;
+    struct dead_end_step *steps;
+  };
+
+static struct hash_table dead_ends;
+
+/* The value of pattern_rules_changenum when DEAD_ENDS was last
+   emptied.  */
+static unsigned long dead_ends_changenum;
+
+static unsigned long dead_end_hits;
+static unsigned long dead_end_misses;
+static unsigned long impossible_hits;
+
+static unsigned long
+dead_end_hash_1 (const void *key)
+{
+  const struct dead_end *d = key;
+  return ((unsigned long) d->prefix >> 3) ^ ((unsigned long) d->suffix >> 2);
+}
+
+static unsigned long
+dead_end_hash_2 (const void *key)
+{
+  const struct dead_end *d = key;
+  return ((unsigned long) d->prefix >> 5) + ((unsigned long) d->suffix >> 4);
+}
+
+static int
+dead_end_hash_cmp (const void *x, const void *y)
+{
+  const struct dead_end *dx = x;
+  const struct dead_end *dy = y;
+  if (dx->prefix != dy->prefix)
+    return dx->prefix < dy->prefix ? -1 : 1;
+  if (dx->suffix != dy->suffix)
+    return dx->suffix < dy->suffix ? -1 : 1;
+  return 0;
+}
+
+static void
+free_dead_end (const void *item)
+{
+  struct dead_end *d = (struct dead_end *) item;
+  free (d->steps);
+  free (d);
+}
+
+/* Return nonzero if dead ends may be used now: only the directory cache
+   and the file data base decide whether a file exists, and the pattern
+   rules are those the dead ends were found with.  */
+
+static int
+dead_ends_usable (void)
+{
+#if defined(VMS) || defined(HAVE_DOS_PATHS) || defined(_AMIGA) \
+    || defined(HAVE_CASE_INSENSITIVE_FS)
+  return 0;
+#else
+  if (vpath_in_effect ())
+    return 0;
+
+  if (dead_ends.ht_vec == 0)
+    hash_init (&dead_ends, 256, dead_end_hash_1, dead_end_hash_2,
+               dead_end_hash_cmp);
+  else if (dead_ends_changenum != pattern_rules_changenum)
+    {
+      hash_map (&dead_ends, free_dead_end);
+      hash_delete_items (&dead_ends);
+    }
+  dead_ends_changenum = pattern_rules_changenum;
+  return 1;
+#endif
+}
+
+/* Return nonzero if the LENGTH chars at STEM read the same in any name,
+   without whitespace, quoting, slashes, patterns or archive members.  */
+
+static int
+plain_stem (const char *stem, size_t length)
+{
+  size_t i;
+
+  if (length == 0)
+    return 0;
+  for (i = 0; i < length; ++i)
+    if (!isalnum ((unsigned char) stem[i]) && strchr ("._-+,=@", stem[i]) == 0)
+      return 0;
+  return 1;
+}
+
+/* Return nonzero if NAME, whose stem is at PLACE, is known to be a dead
+   end: of a shape no name of which can be made.  LEVEL counts the dead
+   ends being checked for the prerequisites of another.  */
+
+static int
+dead_end_p (const char *name, const struct stem_place *place,
+            unsigned int level)
+{
+  struct dead_end key;
+  const struct dead_end *d;
+  const char *stem = name + place->start;
+  unsigned int i;
+
+  if (level > 16 || !plain_stem (stem, place->length))
+    return 0;
+
+  key.prefix = strcache_add_len (name, place->start);
+  key.suffix = strcache_add (stem + place->length);
+  d = hash_find_item (&dead_ends, &key);
+  if (d == 0)
+    return 0;
+
+  for (i = 0; i < d->nsteps; ++i)
+    {
+      const struct dead_end_step *step = &d->steps[i];
+      size_t prefixlen = strlen (step->prefix);
+      size_t stemlen = (place->start - step->drop) + place->length + step->keep;
+      char *lacking = alloca (prefixlen + stemlen + strlen (step->suffix) + 1);
+      struct stem_place next;
+      char *o = lacking;
+
+      /* The name of the prerequisite the rule would look for.  */
+      memcpy (o, step->prefix, prefixlen);
+      o += prefixlen;
+      memcpy (o, name + step->drop, stemlen);
+      o += stemlen;
+      strcpy (o, step->suffix);
+
+      /* The directory cache has no file like it, but the data base might
+         have the name itself.  */
+      if (lookup_file (lacking) != 0)
+        break;
+
+      next.start = prefixlen;
+      next.length = stemlen;
+      if (!step->terminal && !dead_end_p (lacking, &next, level + 1))
+        break;
+    }
+
+  if (i < d->nsteps)
+    {
+      if (level == 0)
+        ++dead_end_misses;
+      return 0;
+    }
+
+  if (level == 0)
+    ++dead_end_hits;
+  return 1;
+}
+
+/* Return nonzero if each pattern rule target either matches every name
+   with PREFIX and SUFFIX around a plain stem, or none: none reaches into
+   the stem with text a plain stem could have.  */
+
+static int
+same_rules_for_any_stem (const char *prefix, size_t prefixlen,
+                         const char *suffix)
+{
+  const char *slash = 0;
+  const char *base;
+  size_t baselen;
+  size_t suffixlen = strlen (suffix);
+  const struct rule *rule;
+  unsigned int ti;
+
+  for (base = prefix; base < prefix + prefixlen; ++base)
+    if (*base == '/')
+      slash = base;
+  base = slash ? slash + 1 : prefix;
+  baselen = prefixlen - (base - prefix);
+
+  for (rule = pattern_rules; rule != 0; rule = rule->next)
+    for (ti = 0; ti < rule->num; ++ti)
+      {
+        const char *target = rule->targets[ti];
+        const char *tsuffix = rule->suffixes[ti];
+        size_t tprefixlen = tsuffix - target - 1;
+        size_t tsuffixlen = strlen (tsuffix);
+        int lastslash = slash != 0 && strchr (target, '/') == 0;
+        const char *against = lastslash ? base : prefix;
+        size_t againstlen = lastslash ? baselen : prefixlen;
+
+        if (tsuffixlen > suffixlen
+            && streq (tsuffix + tsuffixlen - suffixlen, suffix)
+            && plain_stem (tsuffix, tsuffixlen - suffixlen))
+          return 0;
+        if (tprefixlen > againstlen && strneq (target, against, againstlen)
+            && plain_stem (target + againstlen, tprefixlen - againstlen))
+          return 0;
+      }
+
+  return 1;
+}
+
+/* Remember that no name with the shape of FILENAME, whose stem is at
+   PLACE, can be made, if that is so: each of the NRULES rules in
+   TRYRULES lacked a prerequisite that no file in its directory looks
+   like.  PATHLEN is the length of the directory part of FILENAME.  */
+
+static void
+record_dead_end (const char *filename, const struct stem_place *place,
+                 size_t pathlen, const struct tryrule *tryrules,
+                 unsigned int nrules)
+{
+  struct dead_end key;
+  struct dead_end **slot;
+  struct dead_end *d;
+  struct dead_end_step *steps;
+  unsigned int nsteps = 0;
+  const char *suffix = filename + place->start + place->length;
+  size_t suffixlen = strlen (suffix);
+  unsigned int ri;
+
+  if (!plain_stem (filename + place->start, place->length)
+      || strchr (suffix, '/') != 0 || strchr (filename, '(') != 0
+      || !same_rules_for_any_stem (filename, place->start, suffix))
+    return;
+
+  steps = xmalloc ((nrules + 1) * sizeof (struct dead_end_step));
+  for (ri = 0; ri < nrules; ++ri)
+    {
+      const struct tryrule *t = &tryrules[ri];
+      const struct rule *rule = t->matched;
+      size_t tprefixlen;
+      size_t tsuffixlen;
+      size_t drop;
+      const char *dname;
+      const char *percent;
+      char *prefix;
+      char *o;
+      char *like;
+      char *likesuffix;
+
+      /* Rules dropped for matching anything can never apply.  */
+      if (rule == 0)
+        continue;
+
+      if (t->lacking == 0 || t->lacking->need_2nd_expansion)
+        goto fail;
+
+      tprefixlen = rule->suffixes[t->matches] - rule->targets[t->matches] - 1;
+      tsuffixlen = strlen (rule->suffixes[t->matches]);
+      drop = tprefixlen + (t->checked_lastslash ? pathlen : 0);
+      if (drop > place->start || tsuffixlen > suffixlen)
+        goto fail;
+
+      /* The prerequisite's name must be taken as it is, not globbed,
+         split or turned into an archive member.  */
+      dname = dep_name (t->lacking);
+      percent = strchr (dname, '%');
+      if (percent == 0 || strpbrk (dname, " \t\\$*?[~(|;") != 0
+          || strchr (percent + 1, '/') != 0)
+        goto fail;
+
+      /* The prerequisite's name is PREFIX, the rule's stem, then what
+         follows the % in DNAME.  */
+      prefix = alloca (pathlen + (percent - dname) + 1);
+      o = prefix;
+      if (t->checked_lastslash)
+        {
+          memcpy (o, filename, pathlen);
+          o += pathlen;
+        }
+      memcpy (o, dname, percent - dname);
+      o += percent - dname;
+      *o = '\0';
+      if (prefix[0] == '.' && prefix[1] == '/')
+        goto fail;
+
+      /* No file in its directory may look like it: none may begin
+         like the prerequisite's name, up to the stem, and end like it,
+         after the stem.  */
+      like = alloca ((o - prefix) + (place->start - drop) + 1);
+      memcpy (like, prefix, o - prefix);
+      memcpy (like + (o - prefix), filename + drop, place->start - drop);
+      like[(o - prefix) + (place->start - drop)] = '\0';
+      likesuffix = alloca (suffixlen + strlen (percent + 1) + 1);
+      memcpy (likesuffix, suffix, suffixlen - tsuffixlen);
+      strcpy (likesuffix + suffixlen - tsuffixlen, percent + 1);
+      if (dir_has_file_like (like, likesuffix))
+        goto fail;
+
+      steps[nsteps].drop = drop;
+      steps[nsteps].keep = suffixlen - tsuffixlen;
+      steps[nsteps].prefix = strcache_add (prefix);
+      steps[nsteps].suffix = strcache_add (percent + 1);
+      steps[nsteps].terminal = rule->terminal;
+      ++nsteps;
+    }
+
+  key.prefix = strcache_add_len (filename, place->start);
+  key.suffix = strcache_add (suffix);
+  slot = (struct dead_end **) hash_find_slot (&dead_ends, &key);
+  if (!HASH_VACANT (*slot))
+    free_dead_end (*slot);
+  d = xmalloc (sizeof (struct dead_end));
+  *d = key;
+  d->nsteps = nsteps;
+  d->steps = steps;
+  hash_insert_at (&dead_ends, d, slot);
+  return;
+
+ fail:
+  free (steps);
+}
+
+/* Print statistics about implicit rule searches.  */
+
+void
+implicit_print_stats (const char *prefix)
+{
+  printf (_("\n%s Implicit rule search: %lu impossible prerequisites,"
+            " %lu dead ends (%lu hits, %lu misses)\n"),
+          prefix, impossible_hits, dead_ends.ht_fill, dead_end_hits,
+          dead_end_misses);
+}
+
 /* Search the pattern rules for a rule with an existing dependency to make
    FILE.  If a rule is found, the appropriate commands and deps are put in FILE
    and 1 is returned.  If not, 0 is returned.
@@ -195,11 +564,16 @@ stemlen_compare (const void *v1, const void *v2)
    is set up as a target by the recursive call and is also made a dependency
    of FILE.
 
-   DEPTH is used for debugging messages.  */
+   DEPTH is used for debugging messages.
+
+   PLACE, if not nil, is where the stem of the rule that wants FILE as an
+   intermediate file is in its name.  If no rule is found, FILE may then
+   be remembered as a dead end.  */
 
 static int
 pattern_search (struct file *file, int archive,
-                unsigned int depth, unsigned int recursions)
+                unsigned int depth, unsigned int recursions,
+                const struct stem_place *place)
 {
   /* Filename we are searching for a rule for.  */
   const char *filename = archive ? strchr (file->name, '(') : file->name;
@@ -228,9 +602,13 @@ pattern_search (struct file *file, int archive,
   size_t stemlen = 0;
   size_t fullstemlen = 0;
 
+  /* The target patterns that FILENAME could match.  */
+  const struct pattern_target *targets;
+  unsigned int ntargets;
+  unsigned int ci;
+
   /* Buffer in which we store all the rules that are possibly applicable.  */
-  struct tryrule *tryrules = xmalloc (num_pattern_rules * max_pattern_targets
-                                      * sizeof (struct tryrule));
+  struct tryrule *tryrules;
 
   /* Number of valid elements in TRYRULES.  */
   unsigned int nrules;
@@ -248,6 +626,10 @@ pattern_search (struct file *file, int archive,
      that is not just '%'.  */
   int specific_rule_matched = 0;
 
+  /* Nonzero if dead ends may be used, and zero once the search does
+     something that depends on more than the shape of FILENAME.  */
+  int shape_known = recursions > 0 && dead_ends_usable ();
+
   unsigned int ri;  /* uninit checks OK */
   struct rule *rule;
 
@@ -292,12 +674,21 @@ pattern_search (struct file *file, int archive,
   pathlen = lastslash - filename + 1;
 
   /* First see which pattern rules match this target and may be considered.
-     Put them in TRYRULES.  */
+     Put them in TRYRULES.  Only the patterns whose suffix FILENAME ends
+     with can match, so the others are not even looked at.  */
+
+  targets = find_pattern_targets (filename, namelen, &ntargets);
+  tryrules = xmalloc ((ntargets + 1) * sizeof (struct tryrule));
 
   nrules = 0;
-  for (rule = pattern_rules; rule != 0; rule = rule->next)
+  for (ci = 0; ci < ntargets; ++ci)
     {
-      unsigned int ti;
+      unsigned int ti = targets[ci].target;
+      const char *target;
+      const char *suffix;
+      char check_lastslash;
+
+      rule = targets[ci].rule;
 
       /* If the pattern rule has deps but no commands, ignore it.
          Users cancel built-in rules by redefining them without commands.  */
@@ -309,100 +700,106 @@ pattern_search (struct file *file, int archive,
       if (rule->in_use)
         {
           DBS (DB_IMPLICIT, (_("Avoiding implicit rule recursion.\n")));
+          /* Which rules are in use depends on the search that wants
+             FILENAME, unless this one could not be used anyway.  */
+          if (recursions == 0 || rule->terminal
+              || rule->targets[targets[ci].target][1] != '\0')
+            shape_known = 0;
           continue;
         }
 
-      for (ti = 0; ti < rule->num; ++ti)
-        {
-          const char *target = rule->targets[ti];
-          const char *suffix = rule->suffixes[ti];
-          char check_lastslash;
+      target = rule->targets[ti];
+      suffix = rule->suffixes[ti];
 
-          /* Rules that can match any filename and are not terminal
-             are ignored if we're recursing, so that they cannot be
-             intermediate files.  */
-          if (recursions > 0 && target[1] == '\0' && !rule->terminal)
-            continue;
+      /* Rules that can match any filename and are not terminal
+         are ignored if we're recursing, so that they cannot be
+         intermediate files.  */
+      if (recursions > 0 && target[1] == '\0' && !rule->terminal)
+        continue;
 
-          if (rule->lens[ti] > namelen)
-            /* It can't possibly match.  */
-            continue;
+      if (rule->lens[ti] > namelen)
+        /* It can't possibly match.  */
+        continue;
 
-          /* From the lengths of the filename and the pattern parts,
-             find the stem: the part of the filename that matches the %.  */
-          stem = filename + (suffix - target - 1);
-          stemlen = namelen - rule->lens[ti] + 1;
+      /* From the lengths of the filename and the pattern parts,
+         find the stem: the part of the filename that matches the %.  */
+      stem = filename + (suffix - target - 1);
+      stemlen = namelen - rule->lens[ti] + 1;
 
-          /* Set CHECK_LASTSLASH if FILENAME contains a directory
-             prefix and the target pattern does not contain a slash.  */
+      /* Set CHECK_LASTSLASH if FILENAME contains a directory
+         prefix and the target pattern does not contain a slash.  */
 
-          check_lastslash = 0;
-          if (lastslash)
-            {
+      check_lastslash = 0;
+      if (lastslash)
+        {
 #ifdef VMS
-              check_lastslash = strpbrk (target, "/]>:") == NULL;
+          check_lastslash = strpbrk (target, "/]>:") == NULL;
 #else
-              check_lastslash = strchr (target, '/') == 0;
+          check_lastslash = strchr (target, '/') == 0;
 #endif
 #ifdef HAVE_DOS_PATHS
-              /* Didn't find it yet: check for DOS-type directories.  */
-              if (check_lastslash)
-                {
-                  char *b = strchr (target, '\\');
-                  check_lastslash = !(b || (target[0] && target[1] == ':'));
-                }
-#endif
-            }
+          /* Didn't find it yet: check for DOS-type directories.  */
           if (check_lastslash)
             {
-              /* If so, don't include the directory prefix in STEM here.  */
-              if (pathlen > stemlen)
-                continue;
-              stemlen -= pathlen;
-              stem += pathlen;
-            }
-
-          /* Check that the rule pattern matches the text before the stem.  */
-          if (check_lastslash)
-            {
-              if (stem > (lastslash + 1)
-                  && !strneq (target, lastslash + 1, stem - lastslash - 1))
-                continue;
+              char *b = strchr (target, '\\');
+              check_lastslash = !(b || (target[0] && target[1] == ':'));
             }
-          else if (stem > filename
-                   && !strneq (target, filename, stem - filename))
+#endif
+        }
+      if (check_lastslash)
+        {
+          /* If so, don't include the directory prefix in STEM here.  */
+          if (pathlen > stemlen)
             continue;
+          stemlen -= pathlen;
+          stem += pathlen;
+        }
 
-          /* Check that the rule pattern matches the text after the stem.
-             We could test simply use streq, but this way we compare the
-             first two characters immediately.  This saves time in the very
-             common case where the first character matches because it is a
-             period.  */
-          if (*suffix != stem[stemlen]
-              || (*suffix != '\0' && !streq (&suffix[1], &stem[stemlen + 1])))
+      /* Check that the rule pattern matches the text before the stem.  */
+      if (check_lastslash)
+        {
+          if (stem > (lastslash + 1)
+              && !strneq (target, lastslash + 1, stem - lastslash - 1))
             continue;
+        }
+      else if (stem > filename
+               && !strneq (target, filename, stem - filename))
+        continue;
 
-          /* Record if we match a rule that not all filenames will match.  */
-          if (target[1] != '\0')
-            specific_rule_matched = 1;
+      /* Check that the rule pattern matches the text after the stem.
+         We could test simply use streq, but this way we compare the
+         first two characters immediately.  This saves time in the very
+         common case where the first character matches because it is a
+         period.  */
+      if (*suffix != stem[stemlen]
+          || (*suffix != '\0' && !streq (&suffix[1], &stem[stemlen + 1])))
+        continue;
 
-          /* A rule with no dependencies and no commands exists solely to set
-             specific_rule_matched when it matches.  Don't try to use it.  */
-          if (rule->deps == 0 && rule->cmds == 0)
-            continue;
+      /* Record if we match a rule that not all filenames will match.  */
+      if (target[1] != '\0')
+        specific_rule_matched = 1;
 
-          /* Record this rule in TRYRULES and the index of the matching
-             target in MATCHES.  If several targets of the same rule match,
-             that rule will be in TRYRULES more than once.  */
-          tryrules[nrules].rule = rule;
-          tryrules[nrules].matches = ti;
-          tryrules[nrules].stemlen = stemlen + (check_lastslash ? pathlen : 0);
-          tryrules[nrules].order = nrules;
-          tryrules[nrules].checked_lastslash = check_lastslash;
-          ++nrules;
-        }
+      /* A rule with no dependencies and no commands exists solely to set
+         specific_rule_matched when it matches.  Don't try to use it.  */
+      if (rule->deps == 0 && rule->cmds == 0)
+        continue;
+
+      /* Record this rule in TRYRULES and the index of the matching
+         target in MATCHES.  If several targets of the same rule match,
+         that rule will be in TRYRULES more than once.  */
+      tryrules[nrules].rule = rule;
+      tryrules[nrules].matches = ti;
+      tryrules[nrules].stemlen = stemlen + (check_lastslash ? pathlen : 0);
+      tryrules[nrules].order = nrules;
+      tryrules[nrules].checked_lastslash = check_lastslash;
+      tryrules[nrules].matched = rule;
+      tryrules[nrules].lacking = 0;
+      ++nrules;
     }
 
+  /* Nothing below relies on RULE yet, but the result does.  */
+  rule = 0;
+
   /* Bail out early if we haven't found any rules. */
   if (nrules == 0)
     goto done;
@@ -423,6 +820,7 @@ pattern_search (struct file *file, int archive,
             if (tryrules[ri].rule->targets[j][1] == '\0')
               {
                 tryrules[ri].rule = 0;
+                tryrules[ri].matched = 0;
                 break;
               }
         }
@@ -485,6 +883,7 @@ pattern_search (struct file *file, int archive,
             {
               DBS (DB_IMPLICIT, (_("Stem too long: '%.*s'.\n"),
                                  (int) stemlen, stem));
+              shape_known = 0;
               continue;
             }
 
@@ -518,6 +917,10 @@ pattern_search (struct file *file, int archive,
               struct dep *dl, *d;
               char *p;
 
+              /* Where the stem is in DEPNAME, if anywhere.  */
+              struct stem_place depplace;
+              depplace.length = 0;
+
               /* If we're out of name to parse, start the next prereq.  */
               if (! nptr)
                 {
@@ -543,6 +946,8 @@ pattern_search (struct file *file, int archive,
                         }
                       memcpy (o, nptr, p - nptr);
                       o += p - nptr;
+                      depplace.start = o - depname;
+                      depplace.length = stemlen;
                       memcpy (o, stem_str, stemlen);
                       o += stemlen;
                       strcpy (o, p + 1);
@@ -576,6 +981,8 @@ pattern_search (struct file *file, int archive,
                   size_t len;
                   struct dep **dptr;
 
+                  shape_known = 0;
+
                   nptr = get_next_word (nptr, &len);
                   if (nptr == 0)
                     continue;
@@ -698,6 +1105,8 @@ pattern_search (struct file *file, int archive,
                             : _("Rejecting impossible implicit prerequisite '%s'.\n"),
                             d->name));
                       tryrules[ri].rule = 0;
+                      tryrules[ri].lacking = dep;
+                      ++impossible_hits;
 
                       failed = 1;
                       break;
@@ -761,6 +1170,25 @@ pattern_search (struct file *file, int archive,
 
                   if (intermed_ok)
                     {
+                      /* Only a name that is just the stem put into the
+                         prerequisite pattern can be a dead end.  */
+                      const struct stem_place *intplace = 0;
+                      if (depplace.length > 0 && dl->next == 0
+                          && streq (d->name, depname)
+                          && dead_ends_usable ())
+                        intplace = &depplace;
+
+                      if (intplace != 0 && dead_end_p (d->name, intplace, 0))
+                        {
+                          DBS (DB_IMPLICIT,
+                               (_("Not looking for a rule with intermediate file '%s': no file like it can be made.\n"),
+                                d->name));
+                          file_impossible (d->name);
+                          failed = 1;
+                          tryrules[ri].lacking = dep;
+                          break;
+                        }
+
                       DBS (DB_IMPLICIT,
                            (_("Looking for a rule with intermediate file '%s'.\n"),
                             d->name));
@@ -773,7 +1201,8 @@ pattern_search (struct file *file, int archive,
                       if (pattern_search (int_file,
                                           0,
                                           depth + 1,
-                                          recursions + 1))
+                                          recursions + 1,
+                                          intplace))
                         {
                           pat->pattern = int_file->name;
                           int_file->name = d->name;
@@ -795,6 +1224,7 @@ pattern_search (struct file *file, int archive,
 
                   /* A dependency of this rule does not exist. Therefore, this
                      rule fails.  */
+                  tryrules[ri].lacking = dep;
                   failed = 1;
                   break;
                 }
@@ -992,6 +1422,10 @@ pattern_search (struct file *file, int archive,
         }
 
  done:
+  if (rule == 0 && shape_known && place != 0 && !archive)
+    record_dead_end (filename, place, lastslash ? pathlen : 0,
+                     tryrules, nrules);
+
   free (tryrules);
   free (deplist);
 
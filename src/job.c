@@ -25,6 +25,10 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "commands.h"
 #include "variable.h"
 #include "os.h"
+#include "history.h"
+#include "trace.h"
+#include "mtimecache.h"
+#include "varrefs.h"
 
 /* Default shell to use.  */
 #ifdef WINDOWS32
@@ -905,6 +909,8 @@ reap_children (int block, int err)
 
     process_child:
 
+      trace_job (c, exit_code, exit_sig);
+
 #if defined(USE_POSIX_SPAWN)
       /* Some versions of posix_spawn() do not detect errors such as command
          not found until after they fork.  In that case they will exit with a
@@ -1038,7 +1044,11 @@ reap_children (int block, int err)
             /* There are no more commands.  We got through them all
                without an unignored error.  Now the target has been
                successfully updated.  */
-            c->file->update_status = us_success;
+            {
+              c->file->update_status = us_success;
+              record_recipe_duration (c->file,
+                                      recipe_clock () - c->start_time);
+            }
         }
 
       /* When we get here, all the commands for c->file are finished.  */
@@ -1106,6 +1116,7 @@ static void
 free_child (struct child *child)
 {
   output_close (&child->output);
+  trace_release_lane (child->trace_lane);
 
   if (!jobserver_tokens)
     ONS (fatal, NILF, "INTERNAL: Freeing child %p (%s) but no tokens left!\n",
@@ -1167,6 +1178,13 @@ start_job_command (struct child *child)
   char **argv;
 #endif
 
+  if (child->start_time == 0)
+    {
+      child->start_time = recipe_clock ();
+      child->trace_lane = trace_take_lane ();
+    }
+  child->command_start = trace_start ();
+
   /* If we have a completely empty commandset, stop now.  */
   if (!child->command_ptr)
     goto next_command;
@@ -1679,6 +1697,10 @@ new_job (struct file *file)
   char **lines;
   unsigned int i;
 
+  /* Expanding and running the commands may change any file, so stat
+     them afresh from now on.  */
+  forget_prefetched_mtimes ();
+
   /* Let any previously decided-upon jobs that are waiting
      for the load to go down start before this new one.  */
   start_waiting_jobs ();
@@ -3625,6 +3647,7 @@ construct_command_argv (char *line, char **restp, struct file *file,
   {
     /* Turn off --warn-undefined-variables while we expand SHELL and IFS.  */
     int save = warn_undefined_variables_flag;
+    unsigned int hidden = hide_variable_references ();
     warn_undefined_variables_flag = 0;
 
     shell = allocated_variable_expand_for_file ("$(SHELL)", file);
@@ -3688,6 +3711,7 @@ construct_command_argv (char *line, char **restp, struct file *file,
     ifs = allocated_variable_expand_for_file ("$(IFS)", file);
 
     warn_undefined_variables_flag = save;
+    show_variable_references (hidden);
   }
 
   argv = construct_command_argv_internal (line, restp, shell, shellflags, ifs,
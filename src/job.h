@@ -56,6 +56,10 @@ struct child
 
     pid_t pid;                  /* Child process's ID number.  */
 
+    double start_time;          /* When the first command started.  */
+    double command_start;       /* When the current one started, if traced.  */
+    unsigned int trace_lane;    /* Lane of this recipe in the trace.  */
+
     unsigned int  remote:1;     /* Nonzero if executing remotely.  */
     unsigned int  noerror:1;    /* Nonzero if commands contained a '-'.  */
     unsigned int  good_stdin:1; /* Nonzero if this child has a good stdin.  */
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "jsonout.h"
+
+#include <stdio.h>
+#include <float.h>
+
+#define OUTBUF_SIZE (1024 * 1024)
+
+/* The starting size of a buffer without a stream */
+#define OUTBUF_MEMORY_SIZE 4096
+
+void outbuf_init (struct outbuf * ob, FILE * f)
+{
+  ob->f = f;
+  ob->capacity = f != NULL ? OUTBUF_SIZE : OUTBUF_MEMORY_SIZE;
+  ob->buffer = (char *) xmalloc (ob->capacity);
+  ob->used = 0;
+  ob->error = 0;
+}
+
+/** Writes LEN bytes at S to the stream, remembering the first failure */
+static void outbuf_fwrite (struct outbuf * ob, const char * s, size_t len)
+{
+  errno = 0;
+  if (fwrite (s, 1, len, ob->f) != len && ob->error == 0)
+    ob->error = errno != 0 ? errno : EIO;
+}
+
+/** Makes room for LEN more bytes in a buffer without a stream */
+static void outbuf_grow (struct outbuf * ob, size_t len)
+{
+  while (ob->used + len > ob->capacity)
+    ob->capacity *= 2;
+  ob->buffer = (char *) xrealloc (ob->buffer, ob->capacity);
+}
+
+void outbuf_flush (struct outbuf * ob)
+{
+  if (ob->used > 0 && ob->f != NULL)
+    {
+      outbuf_fwrite (ob, ob->buffer, ob->used);
+      ob->used = 0;
+    }
+}
+
+/** Flushes the buffer and releases it.  The stream itself is left open */
+int outbuf_close (struct outbuf * ob)
+{
+  outbuf_flush (ob);
+  free (ob->buffer);
+  ob->buffer = NULL;
+  ob->capacity = 0;
+  return ob->error;
+}
+
+void outbuf_write (struct outbuf * ob, const char * s, size_t len)
+{
+  if (ob->used + len > ob->capacity && ob->f == NULL)
+    outbuf_grow (ob, len);
+  else if (ob->used + len > ob->capacity)
+    {
+      outbuf_flush (ob);
+      if (len > ob->capacity)
+        {
+          /* Too big to be worth copying */
+          outbuf_fwrite (ob, s, len);
+          return;
+        }
+    }
+
+  memcpy (ob->buffer + ob->used, s, len);
+  ob->used += len;
+}
+
+void outbuf_puts (struct outbuf * ob, const char * s)
+{
+  outbuf_write (ob, s, strlen (s));
+}
+
+void outbuf_putc (struct outbuf * ob, char c)
+{
+  if (ob->used == ob->capacity && ob->f == NULL)
+    outbuf_grow (ob, 1);
+  else if (ob->used == ob->capacity)
+    outbuf_flush (ob);
+
+  ob->buffer[ob->used++] = c;
+}
+
+void outbuf_ulong (struct outbuf * ob, unsigned long n)
+{
+  char digits[32];
+  char * p = digits + sizeof (digits);
+
+  do
+    {
+      *--p = (char) ('0' + n % 10);
+      n /= 10;
+    }
+  while (n != 0);
+
+  outbuf_write (ob, p, digits + sizeof (digits) - p);
+}
+
+void json_init (struct json_writer * w, FILE * f, int pretty)
+{
+  outbuf_init (&w->out, f);
+  w->pretty = pretty;
+  w->depth = 0;
+  w->after_key = 0;
+  w->max_depth = 64;
+  w->has_members = (unsigned char *) xcalloc (w->max_depth);
+}
+
+/** Flushes everything written so far and releases the buffers.
+ * The stream itself is left open */
+int json_finish (struct json_writer * w)
+{
+  if (w->pretty)
+    outbuf_putc (&w->out, '\n');
+  free (w->has_members);
+  w->has_members = NULL;
+  return outbuf_close (&w->out);
+}
+
+char * json_take (struct json_writer * w, size_t * length)
+{
+  char * text;
+
+  if (w->pretty)
+    outbuf_putc (&w->out, '\n');
+  text = w->out.buffer;
+  *length = w->out.used;
+  w->out.buffer = NULL;
+  w->out.used = w->out.capacity = 0;
+  free (w->has_members);
+  w->has_members = NULL;
+  return text;
+}
+
+static void json_indent (struct json_writer * w)
+{
+  unsigned int i;
+
+  outbuf_putc (&w->out, '\n');
+  for (i = 0; i < w->depth; ++i)
+    outbuf_putc (&w->out, ' ');
+}
+
+/** Emits whatever has to come before a value or a key at
+ * the current position: a comma and, in pretty mode, a line break */
+static void json_separate (struct json_writer * w)
+{
+  if (w->after_key)
+    {
+      w->after_key = 0;
+      return;
+    }
+
+  if (w->depth == 0)
+    return;
+
+  if (w->has_members[w->depth])
+    outbuf_putc (&w->out, ',');
+  w->has_members[w->depth] = 1;
+
+  if (w->pretty)
+    json_indent (w);
+}
+
+static void json_open (struct json_writer * w, char c)
+{
+  json_separate (w);
+  outbuf_putc (&w->out, c);
+
+  if (++w->depth == w->max_depth)
+    {
+      w->max_depth *= 2;
+      w->has_members = (unsigned char *) xrealloc (w->has_members, w->max_depth);
+    }
+  w->has_members[w->depth] = 0;
+}
+
+static void json_close (struct json_writer * w, char c)
+{
+  int hadMembers = w->has_members[w->depth];
+
+  --w->depth;
+  if (w->pretty && hadMembers)
+    json_indent (w);
+  outbuf_putc (&w->out, c);
+}
+
+void json_begin_object (struct json_writer * w)
+{
+  json_open (w, '{');
+}
+
+void json_end_object (struct json_writer * w)
+{
+  json_close (w, '}');
+}
+
+void json_begin_array (struct json_writer * w)
+{
+  json_open (w, '[');
+}
+
+void json_end_array (struct json_writer * w)
+{
+  json_close (w, ']');
+}
+
+/** Writes S as a quoted JSON string, escaping quotes, backslashes
+ * and control characters.  Runs of plain characters are copied
+ * in one go */
+static void json_quote (struct json_writer * w, const char * s)
+{
+  static const char hex[] = "0123456789abcdef";
+  const char * run = s;
+
+  outbuf_putc (&w->out, '"');
+  for (; *s != '\0'; ++s)
+    {
+      unsigned char c = (unsigned char) *s;
+      char escaped[6];
+      int len = 2;
+
+      if (c >= 0x20 && c != '"' && c != '\\')
+        continue;
+
+      outbuf_write (&w->out, run, s - run);
+      run = s + 1;
+
+      escaped[0] = '\\';
+      switch (c)
+        {
+        case '"':  escaped[1] = '"'; break;
+        case '\\': escaped[1] = '\\'; break;
+        case '\n': escaped[1] = 'n'; break;
+        case '\r': escaped[1] = 'r'; break;
+        case '\t': escaped[1] = 't'; break;
+        case '\b': escaped[1] = 'b'; break;
+        case '\f': escaped[1] = 'f'; break;
+        default:
+          escaped[1] = 'u';
+          escaped[2] = '0';
+          escaped[3] = '0';
+          escaped[4] = hex[c >> 4];
+          escaped[5] = hex[c & 0xf];
+          len = 6;
+          break;
+        }
+      outbuf_write (&w->out, escaped, len);
+    }
+  outbuf_write (&w->out, run, s - run);
+  outbuf_putc (&w->out, '"');
+}
+
+static void json_quote_id (struct json_writer * w, char prefix, unsigned long id)
+{
+  outbuf_putc (&w->out, '"');
+  outbuf_putc (&w->out, prefix);
+  outbuf_ulong (&w->out, id);
+  outbuf_putc (&w->out, '"');
+}
+
+static void json_colon (struct json_writer * w)
+{
+  outbuf_putc (&w->out, ':');
+  if (w->pretty)
+    outbuf_putc (&w->out, ' ');
+  w->after_key = 1;
+}
+
+void json_key (struct json_writer * w, const char * key)
+{
+  json_separate (w);
+  json_quote (w, key);
+  json_colon (w);
+}
+
+/** Writes a key of the form "<prefix><id>", e.g. "f42" */
+void json_key_id (struct json_writer * w, char prefix, unsigned long id)
+{
+  json_separate (w);
+  json_quote_id (w, prefix, id);
+  json_colon (w);
+}
+
+void json_string (struct json_writer * w, const char * s)
+{
+  json_separate (w);
+  json_quote (w, s);
+}
+
+/** Writes a string value of the form "<prefix><id>", e.g. "f42" */
+void json_id (struct json_writer * w, char prefix, unsigned long id)
+{
+  json_separate (w);
+  json_quote_id (w, prefix, id);
+}
+
+void json_ulong (struct json_writer * w, unsigned long n)
+{
+  json_separate (w);
+  outbuf_ulong (&w->out, n);
+}
+
+void json_long (struct json_writer * w, long n)
+{
+  json_separate (w);
+  if (n < 0)
+    {
+      outbuf_putc (&w->out, '-');
+      outbuf_ulong (&w->out, - (unsigned long) n);
+    }
+  else
+    outbuf_ulong (&w->out, (unsigned long) n);
+}
+
+void json_double (struct json_writer * w, double d)
+{
+  char number[64];
+
+  json_separate (w);
+  /* JSON has no NaN or infinity */
+  if (d != d || d > DBL_MAX || d < -DBL_MAX)
+    {
+      outbuf_puts (&w->out, "null");
+      return;
+    }
+  sprintf (number, "%.6f", d);
+  outbuf_puts (&w->out, number);
+}
+
+void json_bool (struct json_writer * w, int b)
+{
+  json_separate (w);
+  outbuf_puts (&w->out, b ? "true" : "false");
+}
+
+void json_null (struct json_writer * w)
+{
+  json_separate (w);
+  outbuf_puts (&w->out, "null");
+}
+
+void json_raw (struct json_writer * w, const char * s)
+{
+  outbuf_puts (&w->out, s);
+}
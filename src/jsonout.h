@@ -0,0 +1,76 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A large output buffer in front of a stdio stream.  Everything written
+   through it reaches the stream in big fwrite () calls.  Without a
+   stream the buffer grows instead, and holds everything written.  */
+struct outbuf
+{
+  FILE * f;
+  char * buffer;
+  size_t used;
+  size_t capacity;
+  int error;                    /* errno of the first write that failed */
+};
+
+void outbuf_init (struct outbuf * ob, FILE * f);
+void outbuf_write (struct outbuf * ob, const char * s, size_t len);
+void outbuf_puts (struct outbuf * ob, const char * s);
+void outbuf_putc (struct outbuf * ob, char c);
+void outbuf_ulong (struct outbuf * ob, unsigned long n);
+void outbuf_flush (struct outbuf * ob);
+
+/* Flushes and releases the buffer, and returns the errno of the first
+   write that failed, or 0 if all of them succeeded */
+int outbuf_close (struct outbuf * ob);
+
+/* A streaming JSON emitter.  It keeps track of nesting so that commas,
+   colons and (in pretty mode) newlines and indentation are inserted
+   automatically, and it escapes every string it writes.  */
+struct json_writer
+{
+  struct outbuf out;
+  int pretty;
+  unsigned int depth;
+  unsigned int after_key;
+  unsigned char * has_members;  /* per nesting level: written anything yet? */
+  unsigned int max_depth;
+};
+
+void json_init (struct json_writer * w, FILE * f, int pretty);
+
+/* Returns what outbuf_close returns */
+int json_finish (struct json_writer * w);
+
+/* Finishes a writer made without a stream and returns what was written,
+   LENGTH bytes that the caller frees */
+char * json_take (struct json_writer * w, size_t * length);
+
+void json_begin_object (struct json_writer * w);
+void json_end_object (struct json_writer * w);
+void json_begin_array (struct json_writer * w);
+void json_end_array (struct json_writer * w);
+
+void json_key (struct json_writer * w, const char * key);
+void json_key_id (struct json_writer * w, char prefix, unsigned long id);
+
+void json_string (struct json_writer * w, const char * s);
+void json_id (struct json_writer * w, char prefix, unsigned long id);
+void json_ulong (struct json_writer * w, unsigned long n);
+void json_long (struct json_writer * w, long n);
+void json_double (struct json_writer * w, double d);
+void json_bool (struct json_writer * w, int b);
+void json_null (struct json_writer * w);
+
+/* Writes text verbatim, e.g. JavaScript around a JSON value */
+void json_raw (struct json_writer * w, const char * s);
@@ -26,6 +26,17 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "getopt.h"
 #include "ctags.h"
 #include "goaltree.h"
+#include "graph.h"
+#include "history.h"
+#include "trace.h"
+#include "vardefs.h"
+#include "varrefs.h"
+#include "serve.h"
+#include "snapshot.h"
+#include "evalprof.h"
+#include "expcost.h"
+#include "shellcache.h"
+#include "mtimecache.h"
 
 #include <assert.h>
 #ifdef _AMIGA
@@ -282,6 +293,14 @@ char *ctags_filename = NULL;
 
 char * goaltree_filename = NULL;
 
+/* layout of the goaltree file: "dag" (default) or "nested" */
+
+char * goaltree_format = NULL;
+
+/* file name for the binary goal graph */
+
+char * goaltree_binary_filename = NULL;
+
 /* option for running interactive goal tree browser */
 
 int goaltree_browser = 0;
@@ -290,9 +309,59 @@ int goaltree_browser = 0;
 
 char * goaltree_html_dir = NULL;
 
-/* option for detecting multiple definitions of the same variable */
+/* file name for the dependency cycle report, "-" for stdout */
+
+char * cycles_filename = NULL;
+
+/* file name for the graph statistics report, "-" for stdout */
+
+char * graph_stats_filename = NULL;
+
+/* file name of the recipe duration history to append to */
+
+char * durations_filename = NULL;
+
+/* file name of the recipe duration history for the critical path report */
+
+char * critical_path_history = NULL;
+
+/* file name for the trace of the build, shared with sub-makes */
+
+char * trace_events_filename = NULL;
+
+/* file name for the variable reference report, "-" for stdout */
+
+char * variable_refs_filename = NULL;
+
+/* Unix domain socket the analysis daemon listens on */
+
+char * serve_socket = NULL;
+
+/* files to write the parsed data base to, and to read it from */
+
+char * save_db_filename = NULL;
+char * load_db_filename = NULL;
+
+/* file name for the makefile evaluation profile, "-" for stdout */
+
+char * profile_eval_filename = NULL;
+
+/* file name for the recursive variable expansion costs, "-" for stdout */
+
+char * expansion_cost_filename = NULL;
+
+/* file the memoized $(shell) output is kept in, shared with sub-makes */
+
+char * shell_cache_filename = NULL;
+
+/* how modification times are fetched ahead of updating the goals: a
+   number of threads or "io_uring" */
 
-int detect_multiple_definition = 0;
+char * prefetch_mtimes_how = NULL;
+
+/* file name for the multiple definition report, "-" for stdout */
+
+char * multiple_definition_filename = NULL;
 
 /* Maximum load average at which multiple jobs will be run.
    Negative values mean unlimited, while zero means limit to
@@ -320,6 +389,10 @@ static struct stringlist *new_files = 0;
 /* List of strings to be eval'd.  */
 static struct stringlist *eval_strings = 0;
 
+/* List of comma-separated lists of files for --affected-by */
+
+static struct stringlist *affected_files = 0;
+
 /* If nonzero, we should just print usage and exit.  */
 
 static int print_usage_flag = 0;
@@ -490,7 +563,23 @@ static const struct command_switch switches[] =
     { CHAR_MAX+11, string, &goaltree_filename, 1, 1, 0, 0, 0, "goaltree-file" },
     { CHAR_MAX+12, flag, &goaltree_browser, 1, 1, 0, 0, 0, "goaltree-browser" },
     { CHAR_MAX+13, string, &goaltree_html_dir, 1, 1, 0, 0, 0, "goaltree-html-dir" },
-    { CHAR_MAX+14, flag, &detect_multiple_definition, 1, 1, 0, 0, 0, "detect-multiple-definition"},
+    { CHAR_MAX+14, string, &multiple_definition_filename, 1, 0, 0, "-", 0, "detect-multiple-definition"},
+    { CHAR_MAX+15, string, &goaltree_format, 1, 1, 0, 0, 0, "goaltree-format" },
+    { CHAR_MAX+16, string, &cycles_filename, 1, 0, 0, "-", 0, "detect-cycles" },
+    { CHAR_MAX+17, string, &goaltree_binary_filename, 1, 1, 0, 0, 0, "goaltree-binary" },
+    { CHAR_MAX+18, string, &graph_stats_filename, 1, 0, 0, "-", 0, "graph-stats" },
+    { CHAR_MAX+19, string, &durations_filename, 1, 0, 0, 0, 0, "record-durations" },
+    { CHAR_MAX+20, string, &critical_path_history, 1, 0, 0, 0, 0, "critical-path" },
+    { CHAR_MAX+21, string, &trace_events_filename, 1, 1, 0, 0, 0, "trace-events" },
+    { CHAR_MAX+22, string, &variable_refs_filename, 1, 0, 0, "-", 0, "variable-refs" },
+    { CHAR_MAX+23, strlist, &affected_files, 1, 0, 0, 0, 0, "affected-by" },
+    { CHAR_MAX+24, string, &serve_socket, 1, 0, 0, 0, 0, "serve" },
+    { CHAR_MAX+25, string, &save_db_filename, 1, 0, 0, 0, 0, "save-db" },
+    { CHAR_MAX+26, string, &load_db_filename, 1, 0, 0, 0, 0, "load-db" },
+    { CHAR_MAX+27, string, &profile_eval_filename, 1, 0, 0, "-", 0, "profile-eval" },
+    { CHAR_MAX+28, string, &expansion_cost_filename, 1, 0, 0, "-", 0, "expansion-cost" },
+    { CHAR_MAX+29, string, &shell_cache_filename, 1, 1, 0, 0, 0, "shell-cache" },
+    { CHAR_MAX+30, string, &prefetch_mtimes_how, 1, 1, 0, "16", 0, "prefetch-mtimes" },
     { 0, 0, 0, 0, 0, 0, 0, 0, 0 }
   };
 
@@ -826,6 +915,17 @@ decode_output_sync_flags (void)
 #endif
 }
 
+/* Reject an unknown --goaltree-format before anything is written.  */
+
+static void
+decode_goaltree_format (void)
+{
+  if (goaltree_format && !streq (goaltree_format, "dag")
+      && !streq (goaltree_format, "nested"))
+    OS (fatal, NILF,
+        _("unknown goaltree format '%s'"), goaltree_format);
+}
+
 #ifdef WINDOWS32
 
 #ifndef NO_OUTPUT_SYNC
@@ -1615,6 +1715,24 @@ main (int argc, char **argv, char **envp)
   /* We may move, but until we do, here we are.  */
   starting_directory = current_directory;
 
+  /* Sub-makes find the trace through MAKEFLAGS, from any directory */
+  if (trace_events_filename != NULL)
+    {
+      if (trace_events_filename[0] != '/')
+        trace_events_filename = xstrdup (concat (3, current_directory, "/",
+                                                 trace_events_filename));
+      init_trace_events (trace_events_filename, makelevel == 0, restarts > 0);
+    }
+
+  /* Likewise for the $(shell) cache */
+  if (shell_cache_filename != NULL)
+    {
+      if (shell_cache_filename[0] != '/')
+        shell_cache_filename = xstrdup (concat (3, current_directory, "/",
+                                                shell_cache_filename));
+      init_shell_cache (shell_cache_filename);
+    }
+
   /* Validate the arg_job_slots configuration before we define MAKEFLAGS so
      users get an accurate value in their makefiles.
      At this point arg_job_slots is the argv setting, if there is one, else
@@ -1974,13 +2092,56 @@ main (int argc, char **argv, char **envp)
     init_ctags_output (ctags_filename);
   }
 
-  read_files = read_all_makefiles (makefiles == 0 ? 0 : makefiles->list);
+  if (multiple_definition_filename != NULL)
+    {
+      init_definition_history ();
+    }
+
+  if (variable_refs_filename != NULL)
+    {
+      init_variable_references ();
+    }
+
+  if (profile_eval_filename != NULL)
+    {
+      init_eval_profile ();
+    }
+
+  if (expansion_cost_filename != NULL)
+    {
+      init_expansion_costs ();
+    }
+
+  if (save_db_filename != NULL || load_db_filename != NULL)
+    {
+      init_database_snapshot (makefiles == 0 ? 0 : makefiles->list,
+                              save_db_filename != NULL);
+    }
+
+  if (load_db_filename != NULL
+      && load_database (load_db_filename, &read_files))
+    {
+      /* No need to write out what was just read */
+      save_db_filename = NULL;
+    }
+  else
+    read_files = read_all_makefiles (makefiles == 0 ? 0 : makefiles->list);
+
+  if (save_db_filename != NULL)
+    {
+      save_database (save_db_filename, read_files);
+    }
 
   if (ctags_filename != NULL)
   {
     write_out_ctags ();
   }
 
+  if (multiple_definition_filename != NULL)
+    {
+      report_multiple_definitions (multiple_definition_filename);
+    }
+
 #ifdef WINDOWS32
   /* look one last time after reading all Makefiles */
   if (no_default_sh_exe)
@@ -2206,6 +2367,12 @@ main (int argc, char **argv, char **envp)
         }
     }
 
+  /* Stat every file in the data base at once, rather than one at a time
+     as the goals are updated.  */
+
+  if (prefetch_mtimes_how != NULL)
+    prefetch_mtimes (prefetch_mtimes_how);
+
   /* Initialize the remote job module.  */
   remote_setup ();
 
@@ -2291,9 +2458,12 @@ main (int argc, char **argv, char **envp)
         if (! ISDB (DB_MAKEFILES))
           db_level = DB_NONE;
 
+        double start = trace_start ();
+
         rebuilding_makefiles = 1;
         status = update_goal_chain (read_files);
         rebuilding_makefiles = 0;
+        trace_span ("update makefiles", "update", start, NULL);
 
         db_level = orig_db_level;
       }
@@ -2489,6 +2659,8 @@ main (int argc, char **argv, char **envp)
 
           fflush (stdout);
           fflush (stderr);
+          flush_trace_events ();
+          save_shell_cache ();
 
           /* The exec'd "child" will be another make, of course.  */
           jobserver_pre_child(1);
@@ -2630,23 +2802,90 @@ main (int argc, char **argv, char **envp)
   if (goaltree_filename != NULL)
     {
       FILE * f = fopen (goaltree_filename, "w");
-      if (f != NULL)
+      if (f == NULL)
+        perror_with_name (_("fopen (goaltree file): "), goaltree_filename);
+      else
         {
-          print_goal_tree (goals, f);
+          int error;
+
+          if (goaltree_format != NULL && streq (goaltree_format, "nested"))
+            error = print_goal_tree (goals, f);
+          else
+            error = print_goal_dag (goals, f);
+          if (fclose (f) != 0 && error == 0)
+            error = errno;
 
-          printf ("Dumped out goal dependencies in '%s'\nUse visualize-goaltree.py '%s' to inspect the tree\n",
-                  goaltree_filename, goaltree_filename);
-          fclose (f);
+          if (error != 0)
+            {
+              errno = error;
+              perror_with_name (_("write: "), goaltree_filename);
+            }
+          else
+            printf ("Dumped out goal dependencies in '%s'\nUse visualize-goaltree.py '%s' to inspect the tree\n",
+                    goaltree_filename, goaltree_filename);
         }
     }
 
+  if (goaltree_binary_filename != NULL)
+    {
+      write_goal_graph_binary (goals, goaltree_binary_filename);
+    }
+
   if (goaltree_html_dir != NULL)
     {
       print_goal_tree_as_html (goals, goaltree_html_dir);
     }
 
+  if (cycles_filename != NULL)
+    {
+      report_cycles (cycles_filename);
+    }
+
+  if (graph_stats_filename != NULL)
+    {
+      report_graph_stats (goals, graph_stats_filename);
+    }
+
+  if (critical_path_history != NULL)
+    {
+      report_critical_path (goals, critical_path_history);
+    }
+
+  if (affected_files != NULL)
+    {
+      /* The answer comes from the graph alone; nothing is updated */
+      report_affected_by (goals, affected_files->list);
+      die (MAKE_SUCCESS);
+    }
+
+  if (serve_socket != NULL)
+    {
+      serve_analysis (serve_socket);
+
+      /* A makefile changed: a new make reads them all again */
+      save_shell_cache ();
+      if (directory_before_chdir != 0 && chdir (directory_before_chdir) < 0)
+        pfatal_with_name ("chdir");
+      fflush (stdout);
+      fflush (stderr);
+      jobserver_pre_child (1);
+#if !defined (_AMIGA) && !defined (__EMX__)
+      exec_command (argv, environ);
+#endif
+      die (MAKE_FAILURE);
+    }
+
+  if (durations_filename != NULL)
+    {
+      init_duration_history (durations_filename);
+    }
+
   {
-    switch (update_goal_chain (goals))
+    double start = trace_start ();
+    enum update_status status = update_goal_chain (goals);
+
+    trace_span ("update goals", "update", start, NULL);
+    switch (status)
     {
       case us_none:
         /* Nothing happened.  */
@@ -3068,6 +3307,7 @@ decode_switches (int argc, const char **argv, int env)
   /* If there are any options that need to be decoded do it now.  */
   decode_debug_flags ();
   decode_output_sync_flags ();
+  decode_goaltree_format ();
 
   /* Perform any special switch handling.  */
   run_silent = silent_flag;
@@ -3462,6 +3702,9 @@ print_data_base (void)
   print_file_data_base ();
   print_vpath_data_base ();
   strcache_print_stats ("#");
+  shell_cache_print_stats ("#");
+  mtime_cache_print_stats ("#");
+  implicit_print_stats ("#");
 
   when = time ((time_t *) 0);
   printf (_("\n# Finished Make data base on %s\n"), ctime (&when));
@@ -3528,6 +3771,19 @@ die (int status)
       /* Let the remote job module clean up its state.  */
       remote_cleanup ();
 
+      finish_trace_events ();
+
+      if (variable_refs_filename != NULL)
+        report_variable_references (variable_refs_filename);
+
+      if (profile_eval_filename != NULL)
+        report_eval_profile (profile_eval_filename);
+
+      if (expansion_cost_filename != NULL)
+        report_expansion_costs (expansion_cost_filename);
+
+      save_shell_cache ();
+
       /* Remove the intermediate files.  */
       remove_intermediates (0);
 
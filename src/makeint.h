@@ -554,6 +554,10 @@ int dir_file_exists_p (const char *, const char *);
 int file_exists_p (const char *);
 int file_impossible_p (const char *);
 void file_impossible (const char *);
+int dir_has_file_like (const char *prefix, const char *suffix);
+void dir_map_files (const char *dirname,
+                    void (*fn) (const char *name, size_t length, void *arg),
+                    void *arg);
 const char *dir_name (const char *);
 void print_dir_data_base (void);
 void dir_setup_glob (glob_t *);
@@ -567,9 +571,16 @@ void install_default_implicit_rules (void);
 
 void build_vpath_lists (void);
 void construct_vpath_list (char *pattern, char *dirpath);
+void map_vpath_lists (void (*fn) (const char *pattern, const char *path,
+                                  void *arg), void *arg);
 const char *vpath_search (const char *file, FILE_TIMESTAMP *mtime_ptr,
                           unsigned int* vpath_index, unsigned int* path_index);
 int gpath_search (const char *file, size_t len);
+int vpath_in_effect (void);
+void vpath_note_file (const char *name, int entered);
+void vpath_map_candidates (const char *file,
+                           void (*fn) (const char *name, void *arg),
+                           void *arg);
 
 void construct_include_path (const char **arg_dirs);
 
@@ -667,7 +678,6 @@ extern int print_version_flag, print_directory_flag, check_symlink_flag;
 extern int warn_undefined_variables_flag, trace_flag, posix_pedantic;
 extern int not_parallel, second_expansion, clock_skew_detected;
 extern int rebuilding_makefiles, one_shell, output_sync, verify_flag;
-extern int detect_multiple_definition;
 
 extern const char *default_shell;
 
@@ -18,6 +18,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "filedef.h"
 #include "dep.h"
 #include "debug.h"
+#include "evalprof.h"
 
 /* GNU make no longer supports pre-ANSI89 environments.  */
 
@@ -189,6 +190,7 @@ xmalloc (size_t size)
   void *result = malloc (size ? size : 1);
   if (result == 0)
     out_of_memory ();
+  ++allocation_count;
   return result;
 }
 
@@ -200,6 +202,7 @@ xcalloc (size_t size)
   void *result = calloc (size ? size : 1, 1);
   if (result == 0)
     out_of_memory ();
+  ++allocation_count;
   return result;
 }
 
@@ -215,6 +218,7 @@ xrealloc (void *ptr, size_t size)
   result = ptr ? realloc (ptr, size) : malloc (size);
   if (result == 0)
     out_of_memory ();
+  ++allocation_count;
   return result;
 }
 
@@ -232,6 +236,7 @@ xstrdup (const char *ptr)
 
   if (result == 0)
     out_of_memory ();
+  ++allocation_count;
 
 #ifdef HAVE_STRDUP
   return result;
@@ -251,6 +256,7 @@ xstrndup (const char *str, size_t length)
   result = strndup (str, length);
   if (result == 0)
     out_of_memory ();
+  ++allocation_count;
 #else
   result = xmalloc (length + 1);
   if (length > 0)
@@ -0,0 +1,544 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "hash.h"
+#include "mtimecache.h"
+
+#include <stdio.h>
+
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+# include <signal.h>
+#endif
+
+#if defined(HAVE_PTHREAD_H) && HAVE_DECL_IORING_OP_STATX && defined(STATX_MTIME)
+# define USE_IO_URING 1
+# include <fcntl.h>
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+#endif
+
+/* Threads used when io_uring cannot be */
+#define PREFETCH_THREADS 16
+
+/* How many names a thread takes from the list at a time */
+#define PREFETCH_CHUNK 64
+
+/* Entries in the io_uring submission queue */
+#define PREFETCH_RING 256
+
+struct mtimeentry
+{
+  const char * name;            /* in the strcache */
+  time_t seconds;
+  long nanoseconds;
+  int error;                    /* errno of a failed stat, or 0 */
+  unsigned int fetched:1;
+};
+
+static struct hash_table entries;
+static int usable = 0;
+
+/* The names being fetched */
+static struct mtimeentry ** pending = NULL;
+static unsigned long pendingCount = 0;
+static unsigned long pendingSize = 0;
+
+static const char * backend = NULL;
+static unsigned long fetched = 0;
+static unsigned long used = 0;
+
+static unsigned long mtimeentry_hash_1 (const void * keyv)
+{
+  return_STRING_HASH_1 (((const struct mtimeentry *) keyv)->name);
+}
+
+static unsigned long mtimeentry_hash_2 (const void * keyv)
+{
+  return_STRING_HASH_2 (((const struct mtimeentry *) keyv)->name);
+}
+
+static int mtimeentry_hash_cmp (const void * xv, const void * yv)
+{
+  return_STRING_COMPARE (((const struct mtimeentry *) xv)->name,
+                         ((const struct mtimeentry *) yv)->name);
+}
+
+/** Adds name to the names to fetch, unless it is there already */
+static void add_name (const char * name, void * arg UNUSED)
+{
+  struct mtimeentry key;
+  struct mtimeentry ** slot;
+  struct mtimeentry * entry;
+
+  key.name = name;
+  slot = (struct mtimeentry **) hash_find_slot (&entries, &key);
+  if (!HASH_VACANT (*slot))
+    {
+      return;
+    }
+
+  entry = (struct mtimeentry *) xcalloc (sizeof (struct mtimeentry));
+  entry->name = strcache_add (name);
+  hash_insert_at (&entries, entry, slot);
+
+  if (pendingCount == pendingSize)
+    {
+      pendingSize = pendingSize ? pendingSize * 2 : 1024;
+      pending = (struct mtimeentry **)
+        xrealloc (pending, pendingSize * sizeof (struct mtimeentry *));
+    }
+  pending[pendingCount++] = entry;
+}
+
+static void stat_entry (struct mtimeentry * entry)
+{
+  struct stat st;
+  int e;
+
+  EINTRLOOP (e, stat (entry->name, &st));
+  if (e == 0)
+    {
+      entry->seconds = st.st_mtime;
+#ifdef ST_MTIM_NSEC
+      entry->nanoseconds = st.ST_MTIM_NSEC;
+#endif
+    }
+  else
+    entry->error = errno;
+  entry->fetched = 1;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+static unsigned long nextPending = 0;
+static pthread_mutex_t pendingLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Stats the pending names that no other thread took */
+static void * stat_worker (void * arg UNUSED)
+{
+  for (;;)
+    {
+      unsigned long i;
+      unsigned long end;
+
+      pthread_mutex_lock (&pendingLock);
+      i = nextPending;
+      end = pendingCount - i < PREFETCH_CHUNK ? pendingCount : i + PREFETCH_CHUNK;
+      nextPending = end;
+      pthread_mutex_unlock (&pendingLock);
+
+      if (i == end)
+        {
+          return NULL;
+        }
+      for (; i < end; ++i)
+        if (!pending[i]->fetched)
+          stat_entry (pending[i]);
+    }
+}
+
+/** Stats the pending names with count threads, this one included.  The
+ * others block every signal, so that make's handlers only ever run on
+ * this one */
+static void stat_with_threads (unsigned long count)
+{
+  pthread_t * threads;
+  unsigned long started = 0;
+  sigset_t all;
+  sigset_t old;
+
+  if (count > pendingCount / PREFETCH_CHUNK + 1)
+    count = pendingCount / PREFETCH_CHUNK + 1;
+
+  nextPending = 0;
+  threads = (pthread_t *) xmalloc (count * sizeof (pthread_t));
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  while (started + 1 < count
+         && pthread_create (&threads[started], NULL, stat_worker, NULL) == 0)
+    ++started;
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+  stat_worker (NULL);
+  while (started > 0)
+    pthread_join (threads[--started], NULL);
+  free (threads);
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+#ifdef USE_IO_URING
+
+/* The rings shared with the kernel */
+struct uring
+{
+  int fd;
+  unsigned int * sqTail;
+  unsigned int * sqMask;
+  unsigned int * sqArray;
+  unsigned int sqEntries;
+  struct io_uring_sqe * sqes;
+  unsigned int * cqHead;
+  unsigned int * cqTail;
+  unsigned int * cqMask;
+  struct io_uring_cqe * cqes;
+  void * sqRing;
+  size_t sqRingSize;
+  void * cqRing;
+  size_t cqRingSize;
+  size_t sqesSize;
+};
+
+static int uring_open (struct uring * ring, unsigned int entries)
+{
+  struct io_uring_params p;
+  int single = 0;
+
+  memset (&p, 0, sizeof (p));
+  ring->fd = (int) syscall (__NR_io_uring_setup, entries, &p);
+  if (ring->fd < 0)
+    {
+      return 0;
+    }
+
+  ring->sqRingSize = p.sq_off.array + p.sq_entries * sizeof (unsigned int);
+  ring->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      single = 1;
+      if (ring->cqRingSize > ring->sqRingSize)
+        ring->sqRingSize = ring->cqRingSize;
+    }
+#endif
+
+  ring->sqRing = mmap (NULL, ring->sqRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ring->cqRing = ring->sqRing;
+  if (!single && ring->sqRing != MAP_FAILED)
+    ring->cqRing = mmap (NULL, ring->cqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_CQ_RING);
+  ring->sqesSize = p.sq_entries * sizeof (struct io_uring_sqe);
+  ring->sqes = MAP_FAILED;
+  if (ring->cqRing != MAP_FAILED)
+    ring->sqes = (struct io_uring_sqe *)
+      mmap (NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+  if (ring->sqes == MAP_FAILED)
+    {
+      if (ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing)
+        munmap (ring->cqRing, ring->cqRingSize);
+      if (ring->sqRing != MAP_FAILED)
+        munmap (ring->sqRing, ring->sqRingSize);
+      close (ring->fd);
+      return 0;
+    }
+
+  ring->sqTail = (unsigned int *) ((char *) ring->sqRing + p.sq_off.tail);
+  ring->sqMask = (unsigned int *) ((char *) ring->sqRing + p.sq_off.ring_mask);
+  ring->sqArray = (unsigned int *) ((char *) ring->sqRing + p.sq_off.array);
+  ring->sqEntries = p.sq_entries;
+  ring->cqHead = (unsigned int *) ((char *) ring->cqRing + p.cq_off.head);
+  ring->cqTail = (unsigned int *) ((char *) ring->cqRing + p.cq_off.tail);
+  ring->cqMask = (unsigned int *) ((char *) ring->cqRing + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *) ((char *) ring->cqRing + p.cq_off.cqes);
+  return 1;
+}
+
+static void uring_close (struct uring * ring)
+{
+  munmap (ring->sqes, ring->sqesSize);
+  if (ring->cqRing != ring->sqRing)
+    munmap (ring->cqRing, ring->cqRingSize);
+  munmap (ring->sqRing, ring->sqRingSize);
+  close (ring->fd);
+}
+
+/** Stats the pending names with statx requests, as many in flight as the
+ * submission queue holds.  Returns 0 if io_uring cannot be used; names a
+ * kernel without statx requests refused are left for stat_with_threads */
+static int stat_with_uring (void)
+{
+  struct uring ring;
+  struct statx * buffers;
+  struct mtimeentry ** owners;
+  unsigned int * freeSlots;
+  unsigned int freeCount;
+  unsigned int inFlight = 0;
+  unsigned int unsubmitted = 0;
+  unsigned long next = 0;
+  unsigned int i;
+
+  if (!uring_open (&ring, PREFETCH_RING))
+    {
+      return 0;
+    }
+
+  buffers = (struct statx *) xmalloc (ring.sqEntries * sizeof (struct statx));
+  owners = (struct mtimeentry **)
+    xmalloc (ring.sqEntries * sizeof (struct mtimeentry *));
+  freeSlots = (unsigned int *) xmalloc (ring.sqEntries * sizeof (unsigned int));
+  for (i = 0; i < ring.sqEntries; ++i)
+    freeSlots[i] = i;
+  freeCount = ring.sqEntries;
+
+  while (next < pendingCount || inFlight > 0)
+    {
+      unsigned int tail = *ring.sqTail;
+      unsigned int head;
+      unsigned int queued = 0;
+      long r;
+
+      while (next < pendingCount && freeCount > 0)
+        {
+          unsigned int slot = freeSlots[--freeCount];
+          unsigned int index = tail & *ring.sqMask;
+          struct io_uring_sqe * sqe = &ring.sqes[index];
+
+          memset (sqe, 0, sizeof (*sqe));
+          sqe->opcode = IORING_OP_STATX;
+          sqe->fd = AT_FDCWD;
+          sqe->addr = (unsigned long) pending[next]->name;
+          sqe->len = STATX_MTIME;
+          sqe->off = (unsigned long) &buffers[slot];
+          sqe->user_data = slot;
+          ring.sqArray[index] = index;
+          owners[slot] = pending[next++];
+          ++tail;
+          ++queued;
+        }
+      __atomic_store_n (ring.sqTail, tail, __ATOMIC_RELEASE);
+      inFlight += queued;
+      unsubmitted += queued;
+
+      /* Requests the kernel has not taken, because the call was
+         interrupted or took only some, are passed again next time round:
+         waiting for them to complete would never return otherwise */
+      r = syscall (__NR_io_uring_enter, ring.fd, unsubmitted, 1,
+                   IORING_ENTER_GETEVENTS, NULL, 0);
+      if (r < 0 && errno != EINTR)
+        {
+          /* What was not fetched is stat'ed by threads instead */
+          break;
+        }
+      if (r > 0)
+        unsubmitted -= (unsigned int) r;
+
+      head = *ring.cqHead;
+      while (head != __atomic_load_n (ring.cqTail, __ATOMIC_ACQUIRE))
+        {
+          const struct io_uring_cqe * cqe = &ring.cqes[head & *ring.cqMask];
+          unsigned int slot = (unsigned int) cqe->user_data;
+          struct mtimeentry * entry = owners[slot];
+
+          if (cqe->res == 0)
+            {
+              entry->seconds = buffers[slot].stx_mtime.tv_sec;
+#ifdef ST_MTIM_NSEC
+              entry->nanoseconds = buffers[slot].stx_mtime.tv_nsec;
+#endif
+              entry->fetched = 1;
+            }
+          else if (cqe->res != -EINVAL && cqe->res != -EOPNOTSUPP)
+            {
+              entry->error = -cqe->res;
+              entry->fetched = 1;
+            }
+          freeSlots[freeCount++] = slot;
+          --inFlight;
+          ++head;
+        }
+      __atomic_store_n (ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+
+  uring_close (&ring);
+  free (freeSlots);
+  free (owners);
+  /* The kernel may still write to the buffers of requests it has taken */
+  if (inFlight == unsubmitted)
+    free (buffers);
+  return 1;
+}
+
+#endif /* USE_IO_URING */
+
+/** Fetches the pending names, then forgets which they were */
+static void fetch_pending (int uring, unsigned long threads)
+{
+  if (pendingCount == 0)
+    {
+      return;
+    }
+
+#ifdef USE_IO_URING
+  if (uring && stat_with_uring ())
+    {
+      unsigned long i;
+
+      backend = "io_uring";
+      uring = 0;
+      for (i = 0; i < pendingCount && pending[i]->fetched; ++i)
+        ;
+      if (i == pendingCount)
+        goto done;
+    }
+#endif
+  if (uring)
+    backend = _("threads, io_uring being unavailable");
+  else if (backend == NULL)
+    backend = _("threads");
+
+#ifdef HAVE_PTHREAD_H
+  stat_with_threads (threads);
+#else
+  {
+    unsigned long i;
+    for (i = 0; i < pendingCount; ++i)
+      if (!pending[i]->fetched)
+        stat_entry (pending[i]);
+  }
+#endif
+
+#ifdef USE_IO_URING
+ done:
+#endif
+  fetched += pendingCount;
+  pendingCount = 0;
+}
+
+void prefetch_mtimes (const char * how)
+{
+  struct file ** files;
+  unsigned long count;
+  unsigned long threads = PREFETCH_THREADS;
+  int uring = 0;
+  unsigned long i;
+
+  if (streq (how, "io_uring"))
+    uring = 1;
+  else
+    {
+      char * end;
+      threads = strtoul (how, &end, 10);
+      if (*how == '\0' || *end != '\0' || threads == 0)
+        OS (fatal, NILF,
+            _("--prefetch-mtimes takes a number of threads or 'io_uring', not '%s'"),
+            how);
+    }
+
+  forget_prefetched_mtimes ();
+  hash_init (&entries, 1024, mtimeentry_hash_1, mtimeentry_hash_2,
+             mtimeentry_hash_cmp);
+  usable = 1;
+
+  /* Every file whose modification time could be asked for, except
+     archive members, whose archives are in the data base themselves */
+  files = get_all_files (&count);
+  for (i = 0; i < count; ++i)
+    {
+      const struct file * f = files[i];
+      if (f->phony || f->last_mtime != UNKNOWN_MTIME)
+        continue;
+#ifndef NO_ARCHIVES
+      if (ar_name (f->name))
+        continue;
+#endif
+      add_name (f->name, NULL);
+    }
+  fetch_pending (uring, threads);
+
+  /* Then what a VPATH search will look at for those that do not exist */
+  if (vpath_in_effect ())
+    {
+      for (i = 0; i < count; ++i)
+        {
+          const struct file * f = files[i];
+          const struct mtimeentry * entry;
+          struct mtimeentry key;
+
+          if (f->ignore_vpath)
+            continue;
+          key.name = f->name;
+          entry = (const struct mtimeentry *) hash_find_item (&entries, &key);
+          if (entry != NULL
+              && (entry->error == ENOENT || entry->error == ENOTDIR))
+            vpath_map_candidates (f->name, add_name, NULL);
+        }
+      fetch_pending (uring, threads);
+    }
+
+  free (files);
+  free (pending);
+  pending = NULL;
+  pendingSize = 0;
+}
+
+int prefetched_mtime (const char * name, FILE_TIMESTAMP * mtime)
+{
+  struct mtimeentry key;
+  const struct mtimeentry * entry;
+
+  if (!usable)
+    {
+      return 0;
+    }
+
+  key.name = name;
+  entry = (const struct mtimeentry *) hash_find_item (&entries, &key);
+  if (entry == NULL || !entry->fetched)
+    {
+      return 0;
+    }
+
+  /* Other errors are reported by whoever stats the file itself */
+  if (entry->error == ENOENT || entry->error == ENOTDIR)
+    *mtime = NONEXISTENT_MTIME;
+  else if (entry->error != 0)
+    return 0;
+  else
+#if FILE_TIMESTAMP_HI_RES
+    *mtime = file_timestamp_cons (name, entry->seconds, entry->nanoseconds);
+#else
+    *mtime = file_timestamp_cons (name, entry->seconds, 0);
+#endif
+
+  ++used;
+  return 1;
+}
+
+void forget_prefetched_mtimes (void)
+{
+  if (!usable)
+    {
+      return;
+    }
+  usable = 0;
+  hash_free (&entries, 1);
+}
+
+void mtime_cache_print_stats (const char * prefix)
+{
+  if (backend == NULL)
+    {
+      return;
+    }
+
+  printf (_("\n%s Modification times prefetched: %lu names with %s, %lu used\n"),
+          prefix, fetched, backend, used);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Modification times fetched ahead of updating the goals.  Every file in
+   the data base, and every file a VPATH search could find for one that
+   does not exist, is stat'ed at once by a pool of threads or through
+   io_uring.  name_mtime and the VPATH search then take the results
+   instead of calling stat one at a time, until make runs anything that
+   could change a file.  */
+
+/* how is a number of threads, or "io_uring" */
+void prefetch_mtimes (const char * how);
+
+/* Returns nonzero if the modification time of name was fetched, and sets
+   *mtime to it or to NONEXISTENT_MTIME */
+int prefetched_mtime (const char * name, FILE_TIMESTAMP * mtime);
+
+/* Drops what was fetched: called before make runs a command or writes a
+   file */
+void forget_prefetched_mtimes (void);
+
+void mtime_cache_print_stats (const char * prefix);
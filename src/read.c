@@ -27,6 +27,10 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "rule.h"
 #include "debug.h"
 #include "hash.h"
+#include "trace.h"
+#include "ctags.h"
+#include "evalprof.h"
+#include "varrefs.h"
 
 
 #ifdef WINDOWS32
@@ -192,11 +196,13 @@ read_all_makefiles (const char **makefiles)
     {
       /* Turn off --warn-undefined-variables while we expand MAKEFILES.  */
       int save = warn_undefined_variables_flag;
+      unsigned int hidden = hide_variable_references ();
       warn_undefined_variables_flag = 0;
 
       value = allocated_variable_expand ("$(MAKEFILES)");
 
       warn_undefined_variables_flag = save;
+      show_variable_references (hidden);
     }
 
     /* Set NAME to the start of next token and LENGTH to its length.
@@ -321,6 +327,8 @@ eval_makefile (const char *filename, unsigned short flags)
   struct ebuffer ebuf;
   const floc *curfile;
   char *expanded = 0;
+  double start = trace_start ();
+  int profiled;
 
   /* Create a new goaldep entry.  */
   deps = alloc_goaldep ();
@@ -433,12 +441,17 @@ eval_makefile (const char *filename, unsigned short flags)
   curfile = reading_file;
   reading_file = &ebuf.floc;
 
+  profiled = profile_makefile (filename);
   eval (&ebuf, !(flags & RM_NO_DEFAULT_GOAL));
+  if (profiled)
+    profile_leave ();
 
   reading_file = curfile;
 
   fclose (ebuf.fp);
 
+  trace_span (filename, "makefile", start, NULL);
+
   free (ebuf.bufstart);
   alloca (0);
 
@@ -585,6 +598,7 @@ eval (struct ebuffer *ebuf, int set_default)
   const char *pattern_percent;
   floc *fstart;
   floc fi;
+  int lineProfiled = 0;
 
 #define record_waiting_files()                                                \
   do                                                                          \
@@ -632,6 +646,12 @@ eval (struct ebuffer *ebuf, int set_default)
       struct vmodifiers vmod;
 
       /* At the top of this loop, we are starting a brand new line.  */
+      if (lineProfiled)
+        {
+          profile_leave ();
+          lineProfiled = 0;
+        }
+
       /* Grab the next line to be evaluated */
       ebuf->floc.lineno += nlines;
       nlines = readline (ebuf);
@@ -663,6 +683,8 @@ eval (struct ebuffer *ebuf, int set_default)
       if (line[0] == '\0')
         continue;
 
+      lineProfiled = profile_line (&ebuf->floc);
+
       linelen = strlen (line);
 
       /* Check for a shell command line first.
@@ -905,7 +927,11 @@ eval (struct ebuffer *ebuf, int set_default)
                                       | (noerror ? RM_DONTCARE : 0)
                                       | (set_default ? 0 : RM_NO_DEFAULT_GOAL));
 
-              struct goaldep *d = eval_makefile (files->name, flags);
+              struct goaldep *d;
+
+              add_to_ctags (files->name, fstart->filenm, fstart->lineno,
+                            CTAGS_INCLUDE);
+              d = eval_makefile (files->name, flags);
 
               if (errno)
                 d->floc = *fstart;
@@ -1557,6 +1583,8 @@ do_define (char *name, enum variable_origin origin, struct ebuffer *ebuf)
 
   v = do_variable_definition (&defstart, name,
                               definition, origin, var.flavor, 0);
+  if (v != NULL)
+    add_to_ctags (v->name, defstart.filenm, defstart.lineno, CTAGS_DEFINE);
   free (definition);
   free (n);
   return (v);
@@ -1726,6 +1754,7 @@ conditional_line (char *line, size_t len, const floc *flocp)
 
       var[l] = '\0';
       v = lookup_variable (var, l);
+      record_variable_reference (var, l, v != 0, 0);
 
       conditionals->ignoring[o] =
         ((v != 0 && *v->value != '\0') == (cmdtype == c_ifndef));
@@ -2190,6 +2219,7 @@ record_files (struct nameseq *filenames, int are_also_makes,
         }
 
       f->is_target = 1;
+      add_to_ctags (f->name, flocp->filenm, flocp->lineno, CTAGS_TARGET);
 
       /* If this is a static pattern rule, set the stem to the part of its
          name that matched the '%' in the pattern, so you can use $* in the
@@ -3034,11 +3064,13 @@ tilde_expand (const char *name)
       {
         /* Turn off --warn-undefined-variables while we expand HOME.  */
         int save = warn_undefined_variables_flag;
+        unsigned int hidden = hide_variable_references ();
         warn_undefined_variables_flag = 0;
 
         home_dir = allocated_variable_expand ("$(HOME)");
 
         warn_undefined_variables_flag = save;
+        show_variable_references (hidden);
       }
 
       is_variable = home_dir[0] != '\0';
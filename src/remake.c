@@ -21,6 +21,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "dep.h"
 #include "variable.h"
 #include "debug.h"
+#include "mtimecache.h"
 
 #include <assert.h>
 
@@ -1151,6 +1152,8 @@ touch_file (struct file *file)
   if (just_print_flag)
     return us_success;
 
+  forget_prefetched_mtimes ();
+
 #ifndef NO_ARCHIVES
   if (ar_name (file->name))
     return ar_touch (file->name) ? us_failed : us_success;
@@ -1468,6 +1471,7 @@ name_mtime (const char *name)
   FILE_TIMESTAMP mtime;
   struct stat st;
   int e;
+  int prefetched = 0;
 
 #if defined(WINDOWS32)
   {
@@ -1506,9 +1510,13 @@ name_mtime (const char *name)
       }
   }
 #else
-  EINTRLOOP (e, stat (name, &st));
+  prefetched = prefetched_mtime (name, &mtime);
+  if (!prefetched)
+    EINTRLOOP (e, stat (name, &st));
 #endif
-  if (e == 0)
+  if (prefetched)
+    /* It was stat'ed before the goals were updated.  */;
+  else if (e == 0)
     mtime = FILE_TIMESTAMP_STAT_MODTIME (name, st);
   else if (errno == ENOENT || errno == ENOTDIR)
     mtime = NONEXISTENT_MTIME;
@@ -26,6 +26,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "rule.h"
 
 static void freerule (struct rule *rule, struct rule *lastrule);
+static void index_pattern_rules (void);
 
 /* Chain of all pattern rules.  */
 
@@ -39,6 +40,10 @@ struct rule *last_pattern_rule;
 
 unsigned int num_pattern_rules;
 
+/* Incremented whenever a pattern rule is added or replaced.  */
+
+unsigned long pattern_rules_changenum;
+
 /* Maximum number of target patterns of any pattern rule.  */
 
 unsigned int max_pattern_targets;
@@ -141,6 +146,150 @@ count_implicit_rule_limits (void)
     }
 
   free (name);
+
+  index_pattern_rules ();
+}
+
+/* The target patterns of all pattern rules, indexed by the last char of
+   their suffix: the text after the %.  A name can only match patterns
+   whose suffix it ends with, so only the patterns under its last char,
+   and those with an empty suffix, need be tried, rather than every pattern
+   of every rule.  Each list is in the order of the rules.  */
+
+struct pattern_list
+  {
+    unsigned int first;         /* Index of its first pattern.  */
+    unsigned int count;
+  };
+
+static struct pattern_list patterns_by_last_char[UCHAR_MAX + 1];
+static struct pattern_list empty_suffix_patterns;
+
+/* The patterns, list by list.  */
+static struct pattern_target *indexed_targets;
+
+/* Nonzero if pattern rules were added or removed since the index was
+   built.  */
+static int pattern_index_stale = 1;
+
+/* Where find_pattern_targets puts the patterns it finds.  */
+static struct pattern_target *found_targets;
+
+/* Return the list that the pattern with SUFFIX belongs in.  */
+
+static struct pattern_list *
+pattern_list_for (const char *suffix, size_t length)
+{
+  if (length == 0)
+    return &empty_suffix_patterns;
+  return &patterns_by_last_char[(unsigned char) suffix[length - 1]];
+}
+
+/* Build the index of the target patterns of all pattern rules.  */
+
+static void
+index_pattern_rules (void)
+{
+  struct rule *rule;
+  unsigned int total = 0;
+  unsigned int order = 0;
+  unsigned int ti;
+  unsigned int c;
+
+  memset (patterns_by_last_char, 0, sizeof (patterns_by_last_char));
+  memset (&empty_suffix_patterns, 0, sizeof (empty_suffix_patterns));
+
+  for (rule = pattern_rules; rule != 0; rule = rule->next)
+    for (ti = 0; ti < rule->num; ++ti)
+      {
+        const char *suffix = rule->suffixes[ti];
+        ++pattern_list_for (suffix, strlen (suffix))->count;
+      }
+
+  /* Give each list its place.  */
+  empty_suffix_patterns.first = total;
+  total += empty_suffix_patterns.count;
+  empty_suffix_patterns.count = 0;
+  for (c = 0; c <= UCHAR_MAX; ++c)
+    {
+      patterns_by_last_char[c].first = total;
+      total += patterns_by_last_char[c].count;
+      patterns_by_last_char[c].count = 0;
+    }
+
+  free (indexed_targets);
+  free (found_targets);
+  indexed_targets = xmalloc ((total + 1) * sizeof (struct pattern_target));
+  found_targets = xmalloc ((total + 1) * sizeof (struct pattern_target));
+
+  for (rule = pattern_rules; rule != 0; rule = rule->next)
+    for (ti = 0; ti < rule->num; ++ti)
+      {
+        size_t length = strlen (rule->suffixes[ti]);
+        struct pattern_list *list = pattern_list_for (rule->suffixes[ti],
+                                                      length);
+        struct pattern_target *t = &indexed_targets[list->first
+                                                    + list->count++];
+        t->rule = rule;
+        t->target = ti;
+        t->order = order++;
+        t->suffix_length = length;
+      }
+
+  pattern_index_stale = 0;
+}
+
+/* Find the target patterns of pattern rules that NAME, which is NAMELEN
+   chars long, could match: those whose suffix NAME ends with.  They are
+   returned in the order of the rules, and of the targets of each rule, in
+   a vector that is valid until the next call.  The number of them is put
+   in *COUNT.  */
+
+const struct pattern_target *
+find_pattern_targets (const char *name, size_t namelen, unsigned int *count)
+{
+  const struct pattern_target *any;
+  const struct pattern_target *any_end;
+  const struct pattern_target *some;
+  const struct pattern_target *some_end;
+  unsigned int n = 0;
+
+  if (pattern_index_stale)
+    index_pattern_rules ();
+
+  any = &indexed_targets[empty_suffix_patterns.first];
+  any_end = any + empty_suffix_patterns.count;
+  some = some_end = any_end;
+  if (namelen > 0)
+    {
+      const struct pattern_list *list
+        = &patterns_by_last_char[(unsigned char) name[namelen - 1]];
+      some = &indexed_targets[list->first];
+      some_end = some + list->count;
+    }
+
+  /* Merge the patterns that match any name with those whose suffix
+     NAME ends with, keeping them in order.  */
+  while (any < any_end || some < some_end)
+    {
+      const struct pattern_target *t;
+
+      if (some == some_end || (any < any_end && any->order < some->order))
+        t = any++;
+      else
+        {
+          t = some++;
+          if (t->suffix_length > namelen
+              || !strneq (t->rule->suffixes[t->target],
+                          name + namelen - t->suffix_length,
+                          t->suffix_length))
+            continue;
+        }
+      found_targets[n++] = *t;
+    }
+
+  *count = n;
+  return found_targets;
 }
 
 /* Create a pattern rule from a suffix rule.
@@ -286,6 +435,9 @@ new_pattern_rule (struct rule *rule, int override)
   struct rule *r, *lastrule;
   unsigned int i, j;
 
+  pattern_index_stale = 1;
+  ++pattern_rules_changenum;
+
   rule->in_use = 0;
   rule->terminal = 0;
 
@@ -30,6 +30,16 @@ struct rule
     char in_use;                /* If in use by a parent pattern_search.  */
   };
 
+/* One target pattern of a pattern rule, as found by
+   find_pattern_targets.  */
+struct pattern_target
+  {
+    struct rule *rule;
+    unsigned int target;        /* Index of the pattern in RULE's targets.  */
+    unsigned int order;         /* Position among all patterns.  */
+    size_t suffix_length;
+  };
+
 /* For calling install_pattern_rule.  */
 struct pspec
   {
@@ -40,6 +50,7 @@ struct pspec
 extern struct rule *pattern_rules;
 extern struct rule *last_pattern_rule;
 extern unsigned int num_pattern_rules;
+extern unsigned long pattern_rules_changenum;
 
 extern unsigned int max_pattern_deps;
 extern unsigned int max_pattern_targets;
@@ -49,6 +60,9 @@ extern struct file *suffix_file;
 
 
 void count_implicit_rule_limits (void);
+const struct pattern_target *find_pattern_targets (const char *name,
+                                                   size_t namelen,
+                                                   unsigned int *count);
 void convert_to_pattern (void);
 void install_pattern_rule (struct pspec *p, int terminal);
 void create_pattern_rule (const char **targets, const char **target_percents,
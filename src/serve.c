@@ -0,0 +1,754 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "variable.h"
+#include "rule.h"
+#include "job.h"
+#include "commands.h"
+#include "debug.h"
+#include "os.h"
+#include "graph.h"
+#include "jsonout.h"
+#include "vardefs.h"
+#include "serve.h"
+
+#include <stdio.h>
+
+#if !defined (WINDOWS32) && !defined (VMS) && !defined (_AMIGA) \
+    && !defined (__MSDOS__)
+# define SERVE_SUPPORTED 1
+# include <fcntl.h>
+# include <signal.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <sys/select.h>
+#endif
+
+#ifdef SERVE_SUPPORTED
+
+/* Clients connected at once; more are turned away */
+#define SERVE_MAX_CLIENTS 32
+
+/* The longest query line accepted */
+#define SERVE_LINE_MAX (64 * 1024)
+
+/* A client that leaves more than this many bytes of answers unread is
+   dropped */
+#define SERVE_OUTPUT_MAX (16 * 1024 * 1024)
+
+/* Seconds between looks at the makefiles' modification times */
+#define SERVE_CHECK_INTERVAL 1
+
+struct client
+{
+  int fd;                       /* -1 if the slot is free; non-blocking */
+  char * line;
+  size_t used;
+  size_t size;
+  struct outbuf out;            /* answers not yet written to fd */
+  size_t sent;                  /* how much of out has been written */
+};
+
+struct watched
+{
+  const char * name;
+  FILE_TIMESTAMP mtime;
+};
+
+static struct file_graph graph;
+static unsigned long * firstReverse;
+static unsigned long * reverse;
+
+static struct watched * watchedFiles;
+static unsigned long watchedCount;
+
+static FILE_TIMESTAMP makefile_mtime (const char * name)
+{
+  struct stat st;
+  int e;
+
+  EINTRLOOP (e, stat (name, &st));
+  if (e != 0)
+    return NONEXISTENT_MTIME;
+  return FILE_TIMESTAMP_STAT_MODTIME (name, st);
+}
+
+/** Remembers the modification time of every makefile read, as listed
+ * in MAKEFILE_LIST */
+static void watch_makefiles (void)
+{
+  struct variable * v = lookup_variable ("MAKEFILE_LIST", 13);
+  const char * p = v != NULL ? v->value : "";
+  const char * name;
+  size_t length;
+  unsigned long capacity = 16;
+
+  watchedFiles = (struct watched *) xmalloc (capacity * sizeof (struct watched));
+  watchedCount = 0;
+  while ((name = find_next_token (&p, &length)) != NULL)
+    {
+      if (watchedCount == capacity)
+        {
+          capacity *= 2;
+          watchedFiles = (struct watched *) xrealloc (watchedFiles,
+                                                      capacity * sizeof (struct watched));
+        }
+      watchedFiles[watchedCount].name = strcache_add_len (name, length);
+      watchedFiles[watchedCount].mtime = makefile_mtime (watchedFiles[watchedCount].name);
+      ++watchedCount;
+    }
+}
+
+static int makefiles_changed (void)
+{
+  unsigned long i;
+
+  for (i = 0; i < watchedCount; ++i)
+    if (makefile_mtime (watchedFiles[i].name) != watchedFiles[i].mtime)
+      {
+        DB (DB_BASIC, (_("Makefile '%s' changed, reading the makefiles again.\n"),
+                       watchedFiles[i].name));
+        return 1;
+      }
+  return 0;
+}
+
+static char * skip_space (char * p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\r')
+    ++p;
+  return p;
+}
+
+static int hex_digit (char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/** Decodes the JSON string at *P in place and leaves *P after it.
+ * Returns NULL if it is not a string, or if it escapes anything beyond
+ * ASCII, which no file or variable name of interest needs */
+static char * parse_string (char ** p)
+{
+  char * in = *p;
+  char * out;
+  char * start;
+
+  if (*in != '"')
+    return NULL;
+
+  start = out = ++in;
+  while (*in != '"')
+    {
+      if (*in == '\0')
+        return NULL;
+      if (*in != '\\')
+        {
+          *out++ = *in++;
+          continue;
+        }
+
+      ++in;
+      switch (*in)
+        {
+        case '"':
+        case '\\':
+        case '/':
+          *out++ = *in;
+          break;
+        case 'b':
+          *out++ = '\b';
+          break;
+        case 'f':
+          *out++ = '\f';
+          break;
+        case 'n':
+          *out++ = '\n';
+          break;
+        case 'r':
+          *out++ = '\r';
+          break;
+        case 't':
+          *out++ = '\t';
+          break;
+        case 'u':
+          {
+            int c = 0;
+            int i;
+            for (i = 1; i <= 4; ++i)
+              {
+                int digit = hex_digit (in[i]);
+                if (digit < 0)
+                  return NULL;
+                c = c * 16 + digit;
+              }
+            if (c == 0 || c >= 0x80)
+              return NULL;
+            *out++ = (char) c;
+            in += 4;
+            break;
+          }
+        default:
+          return NULL;
+        }
+      ++in;
+    }
+
+  *out = '\0';
+  *p = in + 1;
+  return start;
+}
+
+/** Reads a query, an object whose members are all strings.  Returns
+ * what is wrong with it, or NULL */
+static const char * parse_request (char * line, char ** query, char ** name)
+{
+  char * p = skip_space (line);
+
+  *query = NULL;
+  *name = NULL;
+  if (*p != '{')
+    return "expected an object";
+
+  p = skip_space (p + 1);
+  if (*p != '}')
+    for (;;)
+      {
+        char * key = parse_string (&p);
+        char * value;
+
+        if (key == NULL)
+          return "expected a string key";
+        p = skip_space (p);
+        if (*p != ':')
+          return "expected ':'";
+        p = skip_space (p + 1);
+        value = parse_string (&p);
+        if (value == NULL)
+          return "expected a string value";
+
+        if (streq (key, "query"))
+          *query = value;
+        else if (streq (key, "name"))
+          *name = value;
+
+        p = skip_space (p);
+        if (*p == '}')
+          break;
+        if (*p != ',')
+          return "expected ',' or '}'";
+        p = skip_space (p + 1);
+      }
+
+  p = skip_space (p + 1);
+  if (*p != '\0')
+    return "unexpected text after the object";
+  if (*query == NULL)
+    return "missing \"query\"";
+  return NULL;
+}
+
+static void write_location (struct json_writer * w, const floc * location)
+{
+  if (location == NULL || location->filenm == NULL)
+    {
+      json_null (w);
+      return;
+    }
+
+  json_begin_object (w);
+  json_key (w, "file");
+  json_string (w, location->filenm);
+  json_key (w, "line");
+  json_ulong (w, location->lineno);
+  json_end_object (w);
+}
+
+static void answer_deps (struct json_writer * w, struct file * f)
+{
+  unsigned long v = file_graph_node (f);
+  unsigned long e;
+
+  json_key (w, "deps");
+  json_begin_array (w);
+  for (e = graph.first_edge[v]; e < graph.first_edge[v + 1]; ++e)
+    {
+      json_begin_object (w);
+      json_key (w, "name");
+      json_string (w, graph.nodes[graph.edge_target[e]]->name);
+      json_key (w, "order_only");
+      json_bool (w, graph.edge_dep[e]->ignore_mtime);
+      json_end_object (w);
+    }
+  json_end_array (w);
+}
+
+static void answer_rdeps (struct json_writer * w, struct file * f)
+{
+  unsigned long v = file_graph_node (f);
+  unsigned long e;
+
+  json_key (w, "rdeps");
+  json_begin_array (w);
+  for (e = firstReverse[v]; e < firstReverse[v + 1]; ++e)
+    json_string (w, graph.nodes[reverse[e]]->name);
+  json_end_array (w);
+}
+
+static void answer_variable (struct json_writer * w, struct variable * v)
+{
+  json_key (w, "value");
+  json_string (w, v->value);
+  json_key (w, "flavor");
+  json_string (w, v->recursive ? "recursive" : "simple");
+  json_key (w, "origin");
+  json_string (w, variable_origin_name (v->origin));
+  json_key (w, "location");
+  write_location (w, &v->fileinfo);
+}
+
+static void answer_where (struct json_writer * w, const char * name)
+{
+  struct variable * v = lookup_variable (name, strlen (name));
+  struct file * f = lookup_file (name);
+
+  json_key (w, "variable");
+  write_location (w, v != NULL ? &v->fileinfo : NULL);
+  json_key (w, "recipe");
+  write_location (w, f != NULL && f->cmds != NULL ? &f->cmds->fileinfo : NULL);
+}
+
+/** Writes DIR (of length DIRLENGTH, which may be 0) followed by PATTERN
+ * with its first '%' replaced by the STEMLENGTH chars at STEM */
+static void write_substituted (struct json_writer * w, const char * dir,
+                               size_t dirLength, const char * pattern,
+                               const char * stem, size_t stemLength)
+{
+  const char * percent = strchr (pattern, '%');
+  size_t patternLength = strlen (pattern);
+  char * name = (char *) xmalloc (dirLength + patternLength + stemLength + 1);
+  char * o = name;
+
+  memcpy (o, dir, dirLength);
+  o += dirLength;
+  if (percent == NULL)
+    memcpy (o, pattern, patternLength + 1);
+  else
+    {
+      memcpy (o, pattern, percent - pattern);
+      o += percent - pattern;
+      memcpy (o, stem, stemLength);
+      o += stemLength;
+      strcpy (o, percent + 1);
+    }
+
+  json_string (w, name);
+  free (name);
+}
+
+/** Lists the pattern rules whose targets match NAME the way
+ * pattern_search () matches them, in the order they are defined.  Whether
+ * their prerequisites exist or can be made is not examined */
+static void answer_pattern (struct json_writer * w, const char * name)
+{
+  size_t nameLength = strlen (name);
+  const char * lastSlash = strrchr (name, '/');
+  size_t dirLength;
+  struct rule * rule;
+
+  if (lastSlash != NULL && lastSlash[1] == '\0')
+    lastSlash = NULL;
+  dirLength = lastSlash != NULL ? (size_t) (lastSlash - name + 1) : 0;
+
+  json_key (w, "rules");
+  json_begin_array (w);
+  for (rule = pattern_rules; rule != NULL; rule = rule->next)
+    {
+      unsigned int ti;
+
+      /* pattern_search () skips these too */
+      if (rule->cmds == NULL)
+        continue;
+
+      for (ti = 0; ti < rule->num; ++ti)
+        {
+          const char * target = rule->targets[ti];
+          const char * suffix = rule->suffixes[ti];
+          size_t prefixLength = suffix - target - 1;
+          size_t suffixLength = strlen (suffix);
+          const char * file = name;
+          size_t fileLength = nameLength;
+          size_t used = 0;
+          struct dep * d;
+
+          /* A pattern without a directory matches the name without its */
+          if (lastSlash != NULL && strchr (target, '/') == NULL)
+            {
+              file = lastSlash + 1;
+              fileLength = nameLength - dirLength;
+              used = dirLength;
+            }
+
+          if (prefixLength + suffixLength > fileLength
+              || !strneq (file, target, prefixLength)
+              || !streq (file + fileLength - suffixLength, suffix))
+            continue;
+
+          json_begin_object (w);
+          json_key (w, "target");
+          json_string (w, target);
+          json_key (w, "stem");
+          write_substituted (w, name, used, "%", file + prefixLength,
+                             fileLength - prefixLength - suffixLength);
+          json_key (w, "deps");
+          json_begin_array (w);
+          for (d = rule->deps; d != NULL; d = d->next)
+            write_substituted (w, name, strchr (dep_name (d), '/') ? 0 : used,
+                               dep_name (d), file + prefixLength,
+                               fileLength - prefixLength - suffixLength);
+          json_end_array (w);
+          json_key (w, "terminal");
+          json_bool (w, rule->terminal);
+          json_key (w, "location");
+          write_location (w, &rule->cmds->fileinfo);
+          json_end_object (w);
+          break;
+        }
+    }
+  json_end_array (w);
+}
+
+/** Answers one query line with one line of JSON, queued in OUT */
+static void answer (struct outbuf * out, char * line)
+{
+  struct json_writer w;
+  char * query;
+  char * name;
+  char * text;
+  size_t length;
+  const char * error = parse_request (line, &query, &name);
+
+  json_init (&w, NULL, 0);
+  json_begin_object (&w);
+  if (error == NULL)
+    {
+      json_key (&w, "query");
+      json_string (&w, query);
+      if (name != NULL)
+        {
+          json_key (&w, "name");
+          json_string (&w, name);
+        }
+
+      if (name == NULL)
+        error = "missing \"name\"";
+      else if (streq (query, "deps") || streq (query, "rdeps"))
+        {
+          struct file * f = lookup_file (name);
+          json_key (&w, "found");
+          json_bool (&w, f != NULL);
+          if (f != NULL && query[0] == 'd')
+            answer_deps (&w, f);
+          else if (f != NULL)
+            answer_rdeps (&w, f);
+        }
+      else if (streq (query, "variable"))
+        {
+          struct variable * v = lookup_variable (name, strlen (name));
+          json_key (&w, "found");
+          json_bool (&w, v != NULL);
+          if (v != NULL)
+            answer_variable (&w, v);
+        }
+      else if (streq (query, "where"))
+        answer_where (&w, name);
+      else if (streq (query, "pattern"))
+        answer_pattern (&w, name);
+      else
+        error = "unknown query";
+    }
+
+  if (error != NULL)
+    {
+      json_key (&w, "error");
+      json_string (&w, error);
+    }
+  json_end_object (&w);
+  text = json_take (&w, &length);
+  outbuf_write (out, text, length);
+  outbuf_putc (out, '\n');
+  free (text);
+}
+
+static void drop_client (struct client * c)
+{
+  outbuf_close (&c->out);
+  close (c->fd);
+  free (c->line);
+  memset (c, 0, sizeof (*c));
+  c->fd = -1;
+}
+
+/** Reads what the client sent and answers every complete line.
+ * Returns 0 if the client is gone or sent a line too long */
+static int serve_client (struct client * c)
+{
+  ssize_t got;
+  char * start;
+  char * newline;
+
+  if (c->size - c->used < 4096)
+    {
+      c->size *= 2;
+      c->line = (char *) xrealloc (c->line, c->size);
+    }
+
+  EINTRLOOP (got, read (c->fd, c->line + c->used, c->size - c->used - 1));
+  if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return 1;
+  if (got <= 0)
+    return 0;
+  c->used += got;
+  c->line[c->used] = '\0';
+
+  start = c->line;
+  while ((newline = strchr (start, '\n')) != NULL)
+    {
+      *newline = '\0';
+      if (*skip_space (start) != '\0')
+        answer (&c->out, start);
+      start = newline + 1;
+    }
+
+  c->used -= start - c->line;
+  memmove (c->line, start, c->used);
+  return c->used < SERVE_LINE_MAX;
+}
+
+/** Writes as much of the queued answers as the socket takes without
+ * blocking.  Returns 0 if the client is gone or reads too slowly */
+static int flush_client (struct client * c)
+{
+  while (c->sent < c->out.used)
+    {
+      ssize_t n;
+      EINTRLOOP (n, write (c->fd, c->out.buffer + c->sent, c->out.used - c->sent));
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return c->out.used - c->sent <= SERVE_OUTPUT_MAX;
+      if (n <= 0)
+        return 0;
+      c->sent += n;
+    }
+
+  c->out.used = 0;
+  c->sent = 0;
+  return 1;
+}
+
+static void accept_client (int listener, struct client * clients)
+{
+  int fd;
+  int flags;
+  int i;
+
+  EINTRLOOP (fd, accept (listener, NULL, NULL));
+  if (fd < 0)
+    return;
+  fd_noinherit (fd);
+
+  /* One client that stops reading must not stall the others */
+  EINTRLOOP (flags, fcntl (fd, F_GETFL));
+  if (flags >= 0)
+    EINTRLOOP (flags, fcntl (fd, F_SETFL, flags | O_NONBLOCK));
+
+  for (i = 0; i < SERVE_MAX_CLIENTS && flags >= 0; ++i)
+    if (clients[i].fd < 0)
+      {
+        outbuf_init (&clients[i].out, NULL);
+        clients[i].sent = 0;
+        clients[i].fd = fd;
+        clients[i].size = 8192;
+        clients[i].used = 0;
+        clients[i].line = (char *) xmalloc (clients[i].size);
+        return;
+      }
+
+  /* No room, or the socket could not be made non-blocking */
+  close (fd);
+}
+
+static int open_socket (const char * socket_path)
+{
+  struct sockaddr_un address;
+  struct stat st;
+  int listener;
+
+  if (strlen (socket_path) >= sizeof (address.sun_path))
+    OS (fatal, NILF, _("socket path '%s' is too long"), socket_path);
+
+  /* A socket left behind by a daemon that did not exit cleanly */
+  if (stat (socket_path, &st) == 0 && S_ISSOCK (st.st_mode))
+    unlink (socket_path);
+
+  listener = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    pfatal_with_name ("socket");
+  fd_noinherit (listener);
+
+  memset (&address, 0, sizeof (address));
+  address.sun_family = AF_UNIX;
+  strcpy (address.sun_path, socket_path);
+  if (bind (listener, (struct sockaddr *) &address, sizeof (address)) < 0)
+    pfatal_with_name (socket_path);
+  if (listen (listener, SERVE_MAX_CLIENTS) < 0)
+    pfatal_with_name ("listen");
+
+  return listener;
+}
+
+/** Searches for implicit rules from every target, as updating it would,
+ * so that deps and rdeps include what pattern rules add */
+static void search_implicit_rules (void)
+{
+  struct file ** files;
+  struct goaldep * targets;
+  struct goaldep * chain = NULL;
+  unsigned long count;
+  unsigned long i;
+
+  files = get_all_files (&count);
+  targets = (struct goaldep *) xcalloc ((count + 1) * sizeof (struct goaldep));
+  for (i = 0; i < count; ++i)
+    if (files[i]->is_target)
+      {
+        targets[i].file = files[i];
+        targets[i].next = chain;
+        chain = &targets[i];
+      }
+  free (files);
+
+  file_graph_add_implicit_dependencies (chain);
+  free (targets);
+}
+
+/** One process, one thread: select () multiplexes the clients, and
+ * wakes up every SERVE_CHECK_INTERVAL seconds to look at the makefiles.
+ * Answers are queued per client and written as its socket takes them;
+ * a client with answers waiting sends no more queries until it has
+ * read them */
+void serve_analysis (const char * socket_path)
+{
+  struct client clients[SERVE_MAX_CLIENTS];
+  int listener;
+  time_t lastCheck = time (NULL);
+  int i;
+
+  /* A client that goes away must not kill the daemon */
+  signal (SIGPIPE, SIG_IGN);
+
+  listener = open_socket (socket_path);
+  for (i = 0; i < SERVE_MAX_CLIENTS; ++i)
+    {
+      memset (&clients[i], 0, sizeof (clients[i]));
+      clients[i].fd = -1;
+    }
+
+  search_implicit_rules ();
+  file_graph_build (&graph);
+  firstReverse = file_graph_reverse (&graph, NULL, &reverse, NULL);
+  watch_makefiles ();
+
+  printf (_("%s: answering queries on '%s'\n"), program, socket_path);
+  fflush (stdout);
+
+  for (;;)
+    {
+      fd_set readable;
+      fd_set writable;
+      struct timeval timeout;
+      int maxFd = listener;
+      int ready;
+
+      FD_ZERO (&readable);
+      FD_ZERO (&writable);
+      FD_SET (listener, &readable);
+      for (i = 0; i < SERVE_MAX_CLIENTS; ++i)
+        if (clients[i].fd >= 0)
+          {
+            if (clients[i].out.used > 0)
+              FD_SET (clients[i].fd, &writable);
+            else
+              FD_SET (clients[i].fd, &readable);
+            if (clients[i].fd > maxFd)
+              maxFd = clients[i].fd;
+          }
+
+      timeout.tv_sec = SERVE_CHECK_INTERVAL;
+      timeout.tv_usec = 0;
+      ready = select (maxFd + 1, &readable, &writable, NULL, &timeout);
+      if (ready < 0 && errno != EINTR)
+        pfatal_with_name ("select");
+
+      if (time (NULL) - lastCheck >= SERVE_CHECK_INTERVAL)
+        {
+          if (makefiles_changed ())
+            break;
+          lastCheck = time (NULL);
+        }
+      if (ready <= 0)
+        continue;
+
+      for (i = 0; i < SERVE_MAX_CLIENTS; ++i)
+        {
+          struct client * c = &clients[i];
+          if (c->fd < 0)
+            continue;
+          if ((FD_ISSET (c->fd, &readable) && !serve_client (c))
+              || (c->out.used > 0 && !flush_client (c)))
+            drop_client (c);
+        }
+
+      if (FD_ISSET (listener, &readable))
+        accept_client (listener, clients);
+    }
+
+  for (i = 0; i < SERVE_MAX_CLIENTS; ++i)
+    if (clients[i].fd >= 0)
+      drop_client (&clients[i]);
+  close (listener);
+  unlink (socket_path);
+
+  free (watchedFiles);
+  free (reverse);
+  free (firstReverse);
+  file_graph_free (&graph);
+}
+
+#else /* !SERVE_SUPPORTED */
+
+void serve_analysis (const char * socket_path)
+{
+  OS (fatal, NILF, _("--serve=%s: Unix domain sockets are not supported on this system"),
+      socket_path);
+}
+
+#endif /* SERVE_SUPPORTED */
@@ -0,0 +1,29 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Keeps the data base read from the makefiles and answers queries about
+   it on a Unix domain socket, one JSON object per line each way.  A
+   query names what it wants and the file, variable or target it wants
+   it for:
+
+     {"query": "deps", "name": "main.o"}
+
+   The queries are deps, rdeps (the files depending on name), variable
+   (its unexpanded value, flavor, origin and location), where (the
+   locations of the variable and of the target's recipe) and pattern
+   (the pattern rules that could make name).
+
+   Returns when one of the makefiles read changed on disk, or could no
+   longer be examined, after closing and removing the socket.  The
+   caller is expected to start over then.  */
+void serve_analysis (const char * socket_path);
@@ -0,0 +1,494 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "variable.h"
+#include "hash.h"
+#include "jsonout.h"
+#include "shellcache.h"
+
+#include <stdio.h>
+
+/* The file holds the magic string, the version and then every entry as
+   its environment hash followed by its command, directory, inputs and
+   output, each a length and that many bytes.  Numbers are written in
+   the host's byte order.  */
+#define SHELL_CACHE_MAGIC "MKASH\r\n"
+#define SHELL_CACHE_VERSION 1
+
+struct shellentry
+{
+  char * command;
+  char * directory;
+  char * inputs;                /* "mtime size name\n" per input file */
+  unsigned long environment;    /* hash of the environment */
+  char * output;
+  size_t length;
+  unsigned int used:1;          /* found or stored by this run */
+};
+
+static int initialized = 0;
+static struct hash_table entries;
+static const char * cacheFilename = NULL;
+static int dirty = 0;
+
+/* What find_shell_output last missed */
+static struct shellentry * pending = NULL;
+
+static unsigned long hits = 0;
+static unsigned long misses = 0;
+static unsigned long loaded = 0;
+
+static unsigned long shellentry_hash_1 (const void * keyv)
+{
+  const struct shellentry * key = (const struct shellentry *) keyv;
+  unsigned long result = key->environment;
+  STRING_HASH_1 (key->command, result);
+  STRING_HASH_1 (key->inputs, result);
+  return result;
+}
+
+static unsigned long shellentry_hash_2 (const void * keyv)
+{
+  const struct shellentry * key = (const struct shellentry *) keyv;
+  unsigned long result = 0;
+  STRING_HASH_1 (key->directory, result);
+  return result;
+}
+
+static int shellentry_hash_cmp (const void * xv, const void * yv)
+{
+  const struct shellentry * x = (const struct shellentry *) xv;
+  const struct shellentry * y = (const struct shellentry *) yv;
+  int result;
+
+  if (x->environment != y->environment)
+    return x->environment < y->environment ? -1 : 1;
+  result = strcmp (x->command, y->command);
+  if (result == 0)
+    result = strcmp (x->directory, y->directory);
+  if (result == 0)
+    result = strcmp (x->inputs, y->inputs);
+  return result;
+}
+
+static void free_entry (struct shellentry * entry)
+{
+  free (entry->command);
+  free (entry->directory);
+  free (entry->inputs);
+  free (entry->output);
+  free (entry);
+}
+
+static void init_entries (void)
+{
+  if (!initialized)
+    {
+      hash_init (&entries, 256, shellentry_hash_1, shellentry_hash_2,
+                 shellentry_hash_cmp);
+      initialized = 1;
+    }
+}
+
+/** The environment $(shell) commands run with, independent of the
+ * order of its strings */
+static unsigned long environment_hash (void)
+{
+  unsigned long result = 0;
+  char ** e;
+
+  for (e = environ; *e != NULL; ++e)
+    result += jhash_string ((const unsigned char *) *e) * 2 + 1;
+  return result;
+}
+
+/** Appends the state of the file NAME to the xmalloc'ed *INPUTS */
+static void append_input (char ** inputs, size_t * length, const char * name,
+                          size_t nameLength)
+{
+  struct stat st;
+  char state[64];
+  size_t stateLength;
+  char * copy = alloca (nameLength + 1);
+  int e;
+
+  memcpy (copy, name, nameLength);
+  copy[nameLength] = '\0';
+  EINTRLOOP (e, stat (copy, &st));
+  if (e != 0)
+    strcpy (state, "- - ");
+  else
+    sprintf (state, "%lu %lu ",
+             (unsigned long) FILE_TIMESTAMP_STAT_MODTIME (copy, st),
+             (unsigned long) st.st_size);
+  stateLength = strlen (state);
+
+  *inputs = (char *) xrealloc (*inputs, *length + stateLength + nameLength + 2);
+  memcpy (*inputs + *length, state, stateLength);
+  *length += stateLength;
+  memcpy (*inputs + *length, name, nameLength);
+  *length += nameLength;
+  (*inputs)[(*length)++] = '\n';
+  (*inputs)[*length] = '\0';
+}
+
+/** Returns the expanded value of the variable NAME, or NULL if it is
+ * not defined */
+static char * expand_special (const char * name, size_t length)
+{
+  struct variable * v = lookup_variable (name, length);
+
+  if (v == NULL)
+    return NULL;
+  if (!v->recursive)
+    return xstrdup (v->value);
+  return allocated_variable_expand (v->value);
+}
+
+/** The state of the files named by .SHELL_CACHE_INPUTS now, in the
+ * order they are named */
+static char * current_inputs (void)
+{
+  char * names = expand_special (STRING_SIZE_TUPLE (".SHELL_CACHE_INPUTS"));
+  char * inputs = xstrdup ("");
+  size_t length = 0;
+  const char * p;
+  const char * word;
+  size_t wordLength;
+
+  if (names == NULL)
+    return inputs;
+
+  p = names;
+  while ((word = find_next_token (&p, &wordLength)) != NULL)
+    append_input (&inputs, &length, word, wordLength);
+  free (names);
+  return inputs;
+}
+
+int find_shell_output (const char * command, const char ** output,
+                       size_t * length)
+{
+  struct shellentry key;
+  struct shellentry ** slot;
+  char * enabled = expand_special (STRING_SIZE_TUPLE (".SHELL_CACHE"));
+  const char * p;
+
+  if (enabled == NULL)
+    return 0;
+  p = enabled;
+  NEXT_TOKEN (p);
+  if (*p == '\0')
+    {
+      free (enabled);
+      return 0;
+    }
+  free (enabled);
+
+  init_entries ();
+  if (pending != NULL)
+    {
+      free_entry (pending);
+      pending = NULL;
+    }
+
+  key.command = (char *) command;
+  key.directory = starting_directory != NULL ? starting_directory : (char *) "";
+  key.inputs = current_inputs ();
+  key.environment = environment_hash ();
+
+  slot = (struct shellentry **) hash_find_slot (&entries, &key);
+  if (!HASH_VACANT (*slot))
+    {
+      free (key.inputs);
+      ++hits;
+      (*slot)->used = 1;
+      *output = (*slot)->output;
+      *length = (*slot)->length;
+      return 1;
+    }
+
+  ++misses;
+  pending = (struct shellentry *) xcalloc (sizeof (struct shellentry));
+  pending->command = xstrdup (key.command);
+  pending->directory = xstrdup (key.directory);
+  pending->inputs = key.inputs;
+  pending->environment = key.environment;
+  *output = NULL;
+  return 1;
+}
+
+void store_shell_output (const char * output, size_t length, int succeeded)
+{
+  struct shellentry ** slot;
+
+  if (pending == NULL)
+    {
+      return;
+    }
+
+  slot = (struct shellentry **) hash_find_slot (&entries, pending);
+  if (!succeeded || !HASH_VACANT (*slot))
+    {
+      free_entry (pending);
+      pending = NULL;
+      return;
+    }
+
+  pending->output = (char *) xmalloc (length + 1);
+  memcpy (pending->output, output, length);
+  pending->output[length] = '\0';
+  pending->length = length;
+  pending->used = 1;
+  hash_insert_at (&entries, pending, slot);
+  pending = NULL;
+  dirty = 1;
+}
+
+/** Reads LENGTH bytes at *P as a string, or returns NULL if they are
+ * not all there */
+static char * get_bytes (const char ** p, const char * end, size_t length)
+{
+  char * s;
+
+  if ((size_t) (end - *p) < length)
+    return NULL;
+  s = (char *) xmalloc (length + 1);
+  memcpy (s, *p, length);
+  s[length] = '\0';
+  *p += length;
+  return s;
+}
+
+static int get_string (const char ** p, const char * end, char ** s,
+                       size_t * length)
+{
+  uint64_t n;
+
+  if ((size_t) (end - *p) < sizeof (n))
+    return 0;
+  memcpy (&n, *p, sizeof (n));
+  *p += sizeof (n);
+  *s = get_bytes (p, end, (size_t) n);
+  if (length != NULL)
+    *length = (size_t) n;
+  return *s != NULL;
+}
+
+/** Adds the entries of the cache file to the ones known, which take
+ * precedence.  Returns nonzero if the file could be read, or does not
+ * exist */
+static int load_entries (const char * filename)
+{
+  FILE * f = fopen (filename, "rb");
+  char * buffer = NULL;
+  size_t size = 0;
+  size_t capacity = 0;
+  size_t got;
+  const char * p;
+  const char * end;
+  uint32_t version;
+  int ok = 1;
+
+  if (f == NULL)
+    return errno == ENOENT;
+
+  do
+    {
+      if (size == capacity)
+        {
+          capacity = capacity ? capacity * 2 : 64 * 1024;
+          buffer = (char *) xrealloc (buffer, capacity);
+        }
+      got = fread (buffer + size, 1, capacity - size, f);
+      size += got;
+    }
+  while (got > 0);
+  if (ferror (f))
+    ok = 0;
+  fclose (f);
+
+  p = buffer;
+  end = buffer + size;
+  if (!ok || size < CSTRLEN (SHELL_CACHE_MAGIC) + sizeof (version)
+      || memcmp (p, SHELL_CACHE_MAGIC, CSTRLEN (SHELL_CACHE_MAGIC)) != 0)
+    {
+      free (buffer);
+      return 0;
+    }
+  p += CSTRLEN (SHELL_CACHE_MAGIC);
+  memcpy (&version, p, sizeof (version));
+  p += sizeof (version);
+  if (version != SHELL_CACHE_VERSION)
+    {
+      free (buffer);
+      return 0;
+    }
+
+  while (p < end)
+    {
+      struct shellentry * entry = (struct shellentry *) xcalloc (sizeof (struct shellentry));
+      struct shellentry ** slot;
+      uint64_t environment;
+
+      if ((size_t) (end - p) < sizeof (environment)
+          || (memcpy (&environment, p, sizeof (environment)),
+              p += sizeof (environment),
+              !get_string (&p, end, &entry->command, NULL))
+          || !get_string (&p, end, &entry->directory, NULL)
+          || !get_string (&p, end, &entry->inputs, NULL)
+          || !get_string (&p, end, &entry->output, &entry->length))
+        {
+          free_entry (entry);
+          ok = 0;
+          break;
+        }
+      entry->environment = (unsigned long) environment;
+
+      slot = (struct shellentry **) hash_find_slot (&entries, entry);
+      if (HASH_VACANT (*slot))
+        {
+          hash_insert_at (&entries, entry, slot);
+          ++loaded;
+        }
+      else
+        free_entry (entry);
+    }
+
+  free (buffer);
+  return ok;
+}
+
+void init_shell_cache (const char * filename)
+{
+  init_entries ();
+  cacheFilename = filename;
+  if (!load_entries (filename))
+    OS (error, NILF, _("warning: ignoring unreadable $(shell) cache '%s'"),
+        filename);
+}
+
+/** Whether the files ENTRY depends on are still as they were */
+static int inputs_unchanged (const struct shellentry * entry)
+{
+  char * now = xstrdup ("");
+  size_t length = 0;
+  const char * p = entry->inputs;
+  int result;
+
+  while (*p != '\0')
+    {
+      const char * name = strchr (p, ' ');
+      const char * eol;
+
+      if (name == NULL || (name = strchr (name + 1, ' ')) == NULL
+          || (eol = strchr (name, '\n')) == NULL)
+        break;
+      ++name;
+      append_input (&now, &length, name, eol - name);
+      p = eol + 1;
+    }
+
+  result = streq (now, entry->inputs);
+  free (now);
+  return result;
+}
+
+static void put_string (struct outbuf * out, const char * s, size_t length)
+{
+  uint64_t n = length;
+  outbuf_write (out, (const char *) &n, sizeof (n));
+  outbuf_write (out, s, length);
+}
+
+/** Writes out the entries used by this run, and the others whose input
+ * files have not changed since.  Entries another make added to the file
+ * in the meantime are kept */
+void save_shell_cache (void)
+{
+  struct shellentry ** all;
+  unsigned long count;
+  unsigned long i;
+  uint32_t version = SHELL_CACHE_VERSION;
+  struct outbuf out;
+  char * temporary;
+  FILE * f;
+
+  if (cacheFilename == NULL || !dirty)
+    {
+      return;
+    }
+  dirty = 0;
+
+  load_entries (cacheFilename);
+
+  temporary = xmalloc (strlen (cacheFilename) + 32);
+  sprintf (temporary, "%s.%ld.tmp", cacheFilename, (long) getpid ());
+  f = fopen (temporary, "wb");
+  if (f == NULL)
+    {
+      perror_with_name (_("fopen ($(shell) cache file): "), temporary);
+      free (temporary);
+      return;
+    }
+
+  outbuf_init (&out, f);
+  outbuf_write (&out, SHELL_CACHE_MAGIC, CSTRLEN (SHELL_CACHE_MAGIC));
+  outbuf_write (&out, (const char *) &version, sizeof (version));
+
+  count = entries.ht_fill;
+  all = (struct shellentry **) hash_dump (&entries, NULL, NULL);
+  for (i = 0; i < count; ++i)
+    {
+      const struct shellentry * entry = all[i];
+      uint64_t environment = entry->environment;
+
+      if (!entry->used && !inputs_unchanged (entry))
+        continue;
+      outbuf_write (&out, (const char *) &environment, sizeof (environment));
+      put_string (&out, entry->command, strlen (entry->command));
+      put_string (&out, entry->directory, strlen (entry->directory));
+      put_string (&out, entry->inputs, strlen (entry->inputs));
+      put_string (&out, entry->output, entry->length);
+    }
+  free (all);
+  outbuf_close (&out);
+
+  if (ferror (f) | fclose (f))
+    {
+      perror_with_name (_("write ($(shell) cache file): "), temporary);
+      unlink (temporary);
+    }
+  else if (rename (temporary, cacheFilename) != 0)
+    {
+      perror_with_name (_("rename ($(shell) cache file): "), cacheFilename);
+      unlink (temporary);
+    }
+  free (temporary);
+}
+
+void shell_cache_print_stats (const char * prefix)
+{
+  if (!initialized)
+    {
+      return;
+    }
+
+  printf (_("\n%s $(shell) cache: %lu hits, %lu misses, %lu entries"),
+          prefix, hits, misses, entries.ht_fill);
+  if (cacheFilename != NULL)
+    printf (_(", %lu read from '%s'"), loaded, cacheFilename);
+  putchar ('\n');
+}
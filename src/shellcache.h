@@ -0,0 +1,38 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Memoized $(shell) calls.  A call is memoized while the variable
+   .SHELL_CACHE expands to something other than spaces.  Its output is
+   then reused by any later call with the same command, run in the same
+   directory with the same environment, while the files named by
+   .SHELL_CACHE_INPUTS keep the modification times and sizes they had.
+   Only the output of commands that exited with status 0 is kept.  */
+
+/* Keeps the cache in filename across runs.  Without it the cache only
+   lives as long as make does */
+void init_shell_cache (const char * filename);
+
+/* Returns nonzero if $(shell COMMAND) is to be memoized.  If its output
+   is known *output and *length are set; otherwise *output is set to NULL
+   and the caller runs COMMAND and then calls store_shell_output */
+int find_shell_output (const char * command, const char ** output,
+                       size_t * length);
+
+/* Records the output of the command find_shell_output last missed, if
+   it succeeded */
+void store_shell_output (const char * output, size_t length, int succeeded);
+
+/* Writes the cache back to its file, if it has one */
+void save_shell_cache (void);
+
+void shell_cache_print_stats (const char * prefix);
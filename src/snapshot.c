@@ -0,0 +1,1151 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "dep.h"
+#include "variable.h"
+#include "rule.h"
+#include "job.h"
+#include "commands.h"
+#include "debug.h"
+#include "hash.h"
+#include "jsonout.h"
+#include "snapshot.h"
+
+#include <stdio.h>
+
+/* The layout is private to make-analyze and to one build of it: numbers
+   are written in the host's byte order, and the version changes with
+   any change to the layout.  Every string is written once, as
+   SNAPSHOT_NEW_STRING, its length and its bytes with a terminating nul;
+   later uses of it write only its index.  */
+#define SNAPSHOT_MAGIC "MKADB\r\n"
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_NO_STRING 0xffffffffU
+#define SNAPSHOT_NEW_STRING 0xfffffffeU
+
+/* Flags of a file entry */
+#define ENTRY_TARGET 1
+#define ENTRY_DONTCARE 2
+#define ENTRY_DOUBLE_COLON 4
+
+/* Flags of a dependency, above its own 8 flag bits */
+#define DEP_CHANGED 0x100
+#define DEP_IGNORE_MTIME 0x200
+#define DEP_STATICPATTERN 0x400
+#define DEP_2ND_EXPANSION 0x800
+#define DEP_HAS_NAME 0x1000
+#define DEP_HAS_FILE 0x2000
+
+/* Flags of a variable; its flavor, origin and export are stored above */
+#define VAR_RECURSIVE 1
+#define VAR_APPEND 2
+#define VAR_CONDITIONAL 4
+#define VAR_PER_TARGET 8
+#define VAR_PRIVATE 16
+#define VAR_FLAVOR_SHIFT 8
+#define VAR_ORIGIN_SHIFT 12
+#define VAR_EXPORT_SHIFT 16
+
+/* Flags of the whole data base */
+#define DB_POSIX 1
+#define DB_SECOND_EXPANSION 2
+#define DB_ONE_SHELL 4
+#define DB_EXPORT_ALL 8
+
+struct saved_string
+{
+  unsigned int index;
+  char s[1];
+};
+
+struct snapshot_writer
+{
+  struct outbuf out;
+  struct hash_table strings;
+  unsigned int stringCount;
+};
+
+struct snapshot_reader
+{
+  const char * p;
+  const char * end;
+  const char ** strings;
+  unsigned int stringCount;
+  unsigned int stringCapacity;
+  int bad;
+};
+
+/* What reading the makefiles depends on besides their contents */
+static char * snapshotKey = NULL;
+
+/* Set while makefiles are read for a snapshot to be written */
+static int recording = 0;
+
+/* Files and directories the makefiles looked at besides themselves,
+   in the strcache, and how many there are */
+static struct hash_table inputs;
+static unsigned long inputCount = 0;
+
+/* Why the makefiles cannot be snapshot, or NULL */
+static const char * sideEffect = NULL;
+
+static unsigned long input_hash_1 (const void * key)
+{
+  return_STRING_HASH_1 ((const char *) key);
+}
+
+static unsigned long input_hash_2 (const void * key)
+{
+  return_STRING_HASH_2 ((const char *) key);
+}
+
+static int input_hash_cmp (const void * x, const void * y)
+{
+  return_STRING_COMPARE ((const char *) x, (const char *) y);
+}
+
+static unsigned long saved_string_hash_1 (const void * keyv)
+{
+  const struct saved_string * key = (const struct saved_string *) keyv;
+  return_STRING_HASH_1 (key->s);
+}
+
+static unsigned long saved_string_hash_2 (const void * keyv)
+{
+  const struct saved_string * key = (const struct saved_string *) keyv;
+  return_STRING_HASH_2 (key->s);
+}
+
+static int saved_string_hash_cmp (const void * xv, const void * yv)
+{
+  const struct saved_string * x = (const struct saved_string *) xv;
+  const struct saved_string * y = (const struct saved_string *) yv;
+  return_STRING_COMPARE (x->s, y->s);
+}
+
+static void put_u32 (struct snapshot_writer * w, uint32_t n)
+{
+  outbuf_write (&w->out, (const char *) &n, sizeof (n));
+}
+
+static void put_u64 (struct snapshot_writer * w, uint64_t n)
+{
+  outbuf_write (&w->out, (const char *) &n, sizeof (n));
+}
+
+static void put_string (struct snapshot_writer * w, const char * s)
+{
+  struct saved_string ** slot;
+  struct saved_string * saved;
+  size_t length;
+
+  if (s == NULL)
+    {
+      put_u32 (w, SNAPSHOT_NO_STRING);
+      return;
+    }
+
+  /* Strings are looked up by their contents */
+  length = strlen (s);
+  saved = (struct saved_string *) xmalloc (sizeof (struct saved_string) + length);
+  memcpy (saved->s, s, length + 1);
+  slot = (struct saved_string **) hash_find_slot (&w->strings, saved);
+  if (!HASH_VACANT (*slot))
+    {
+      put_u32 (w, (*slot)->index);
+      free (saved);
+      return;
+    }
+
+  saved->index = w->stringCount++;
+  hash_insert_at (&w->strings, saved, slot);
+  put_u32 (w, SNAPSHOT_NEW_STRING);
+  put_u32 (w, (uint32_t) length);
+  outbuf_write (&w->out, s, length + 1);
+}
+
+static void put_floc (struct snapshot_writer * w, const floc * location)
+{
+  put_string (w, location->filenm);
+  put_u64 (w, location->lineno);
+}
+
+static uint32_t get_u32 (struct snapshot_reader * r)
+{
+  uint32_t n = 0;
+
+  if ((size_t) (r->end - r->p) < sizeof (n))
+    r->bad = 1;
+  else
+    {
+      memcpy (&n, r->p, sizeof (n));
+      r->p += sizeof (n);
+    }
+  return n;
+}
+
+static uint64_t get_u64 (struct snapshot_reader * r)
+{
+  uint64_t n = 0;
+
+  if ((size_t) (r->end - r->p) < sizeof (n))
+    r->bad = 1;
+  else
+    {
+      memcpy (&n, r->p, sizeof (n));
+      r->p += sizeof (n);
+    }
+  return n;
+}
+
+/** Returns a string in the snapshot's buffer, valid while it is loaded */
+static const char * get_string (struct snapshot_reader * r)
+{
+  uint32_t tag = get_u32 (r);
+  uint32_t length;
+  const char * s;
+
+  if (r->bad || tag == SNAPSHOT_NO_STRING)
+    return NULL;
+
+  if (tag != SNAPSHOT_NEW_STRING)
+    {
+      if (tag >= r->stringCount)
+        {
+          r->bad = 1;
+          return NULL;
+        }
+      return r->strings[tag];
+    }
+
+  length = get_u32 (r);
+  if (r->bad || (size_t) (r->end - r->p) <= length || r->p[length] != '\0')
+    {
+      r->bad = 1;
+      return NULL;
+    }
+  s = r->p;
+  r->p += length + 1;
+
+  if (r->stringCount == r->stringCapacity)
+    {
+      r->stringCapacity = r->stringCapacity ? r->stringCapacity * 2 : 1024;
+      r->strings = (const char **) xrealloc (r->strings,
+                                             r->stringCapacity * sizeof (const char *));
+    }
+  r->strings[r->stringCount++] = s;
+  return s;
+}
+
+/** Reads a string that must be there, and puts it in the strcache */
+static const char * get_name (struct snapshot_reader * r)
+{
+  const char * s = get_string (r);
+  if (s == NULL)
+    {
+      r->bad = 1;
+      return "?";
+    }
+  return strcache_add (s);
+}
+
+static void get_floc (struct snapshot_reader * r, floc * location)
+{
+  const char * filenm = get_string (r);
+  location->filenm = filenm != NULL ? strcache_add (filenm) : NULL;
+  location->lineno = (unsigned long) get_u64 (r);
+  location->offset = 0;
+}
+
+static void append_key (char ** key, size_t * length, const char * name,
+                        const char * value)
+{
+  size_t nameLength = strlen (name);
+  size_t valueLength = value != NULL ? strlen (value) : 0;
+
+  *key = (char *) xrealloc (*key, *length + nameLength + valueLength + 3);
+  memcpy (*key + *length, name, nameLength);
+  *length += nameLength;
+  (*key)[(*length)++] = '=';
+  if (value != NULL)
+    memcpy (*key + *length, value, valueLength);
+  *length += valueLength;
+  (*key)[(*length)++] = '\n';
+  (*key)[*length] = '\0';
+}
+
+static const char * variable_value (const char * name)
+{
+  struct variable * v = lookup_variable (name, strlen (name));
+  return v != NULL ? v->value : NULL;
+}
+
+static int variable_name_compare (const void * a, const void * b)
+{
+  const struct variable * x = *(const struct variable * const *) a;
+  const struct variable * y = *(const struct variable * const *) b;
+  return strcmp (x->name, y->name);
+}
+
+/** A 64-bit FNV-1a hash of the names and values of the environment
+ * variables, so that the key does not copy them into the snapshot */
+static char * environment_hash (void)
+{
+  struct variable ** vars;
+  struct variable ** itr;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  char * text = (char *) xmalloc (17);
+
+  vars = (struct variable **) hash_dump (&current_variable_set_list->set->table,
+                                         NULL, variable_name_compare);
+  for (itr = vars; *itr != NULL; ++itr)
+    if ((*itr)->origin == o_env || (*itr)->origin == o_env_override)
+      {
+        const char * p;
+        for (p = (*itr)->name; *p != '\0'; ++p)
+          hash = (hash ^ (unsigned char) *p) * 0x100000001b3ULL;
+        hash = (hash ^ '=') * 0x100000001b3ULL;
+        for (p = (*itr)->value; *p != '\0'; ++p)
+          hash = (hash ^ (unsigned char) *p) * 0x100000001b3ULL;
+        hash = (hash ^ '\n') * 0x100000001b3ULL;
+      }
+  free (vars);
+
+  sprintf (text, "%08lx%08lx", (unsigned long) (hash >> 32),
+           (unsigned long) (hash & 0xffffffffU));
+  return text;
+}
+
+/** The key is a block of name=value lines, compared as a whole */
+void init_database_snapshot (const char ** makefiles, int saving)
+{
+  static const char * const names[] = {
+    "MAKEFLAGS", "MAKEFILES", "MAKELEVEL", "MAKE_COMMAND",
+    "-*-command-variables-*-", "-*-eval-flags-*-", NULL
+  };
+  const char * const * name;
+  char * environment = environment_hash ();
+  size_t length = 0;
+
+  free (snapshotKey);
+  snapshotKey = NULL;
+  append_key (&snapshotKey, &length, "directory", starting_directory);
+  append_key (&snapshotKey, &length, "environment", environment);
+  for (name = names; *name != NULL; ++name)
+    append_key (&snapshotKey, &length, *name, variable_value (*name));
+  for (; makefiles != NULL && *makefiles != NULL; ++makefiles)
+    append_key (&snapshotKey, &length, "-f", *makefiles);
+  free (environment);
+
+  if (saving)
+    {
+      hash_init (&inputs, 256, input_hash_1, input_hash_2, input_hash_cmp);
+      inputCount = 0;
+      sideEffect = NULL;
+      recording = 1;
+    }
+}
+
+void snapshot_note_input (const char * name)
+{
+  const char ** slot;
+
+  if (!recording)
+    {
+      return;
+    }
+
+  slot = (const char **) hash_find_slot (&inputs, name);
+  if (HASH_VACANT (*slot))
+    {
+      hash_insert_at (&inputs, strcache_add (name), slot);
+      ++inputCount;
+    }
+}
+
+void snapshot_note_side_effect (const char * what)
+{
+  if (recording && sideEffect == NULL)
+    sideEffect = what;
+}
+
+static void makefile_state (const char * name, uint64_t * mtime, uint64_t * size)
+{
+  struct stat st;
+  int e;
+
+  EINTRLOOP (e, stat (name, &st));
+  if (e != 0)
+    {
+      *mtime = NONEXISTENT_MTIME;
+      *size = 0;
+      return;
+    }
+  *mtime = FILE_TIMESTAMP_STAT_MODTIME (name, st);
+  *size = st.st_size;
+}
+
+/** Every makefile read, every one that was looked for, and every other
+ * file or directory the makefiles looked at, with its modification time
+ * and size now */
+static void save_makefiles (struct snapshot_writer * w, struct goaldep * read_files)
+{
+  const char * p = variable_value ("MAKEFILE_LIST");
+  const char * name;
+  const char ** input;
+  const char ** end;
+  size_t length;
+  struct goaldep * d;
+  uint32_t count = inputCount;
+
+  if (p == NULL)
+    p = "";
+  {
+    const char * q = p;
+    while (find_next_token (&q, &length) != NULL)
+      ++count;
+  }
+  for (d = read_files; d != NULL; d = d->next)
+    ++count;
+
+  put_u32 (w, count);
+  while ((name = find_next_token (&p, &length)) != NULL)
+    {
+      char * copy = xstrndup (name, length);
+      uint64_t mtime;
+      uint64_t size;
+
+      makefile_state (copy, &mtime, &size);
+      put_string (w, copy);
+      put_u64 (w, mtime);
+      put_u64 (w, size);
+      free (copy);
+    }
+  for (d = read_files; d != NULL; d = d->next)
+    {
+      uint64_t mtime;
+      uint64_t size;
+
+      makefile_state (d->file->name, &mtime, &size);
+      put_string (w, d->file->name);
+      put_u64 (w, mtime);
+      put_u64 (w, size);
+    }
+
+  input = (const char **) inputs.ht_vec;
+  end = input + inputs.ht_size;
+  for (; input < end; ++input)
+    if (!HASH_VACANT (*input))
+      {
+        uint64_t mtime;
+        uint64_t size;
+
+        makefile_state (*input, &mtime, &size);
+        put_string (w, *input);
+        put_u64 (w, mtime);
+        put_u64 (w, size);
+      }
+}
+
+static void save_variable (struct snapshot_writer * w, const struct variable * v,
+                           int withValue)
+{
+  uint32_t flags = 0;
+
+  if (v->recursive)
+    flags |= VAR_RECURSIVE;
+  if (v->append)
+    flags |= VAR_APPEND;
+  if (v->conditional)
+    flags |= VAR_CONDITIONAL;
+  if (v->per_target)
+    flags |= VAR_PER_TARGET;
+  if (v->private_var)
+    flags |= VAR_PRIVATE;
+  flags |= (uint32_t) v->flavor << VAR_FLAVOR_SHIFT;
+  flags |= (uint32_t) v->origin << VAR_ORIGIN_SHIFT;
+  flags |= (uint32_t) v->export << VAR_EXPORT_SHIFT;
+
+  put_string (w, v->name);
+  put_string (w, withValue ? v->value : NULL);
+  put_floc (w, &v->fileinfo);
+  put_u32 (w, flags);
+}
+
+/** Variables the makefiles set, and the export flags of the environment
+ * variables (which they can change with export and unexport); not the
+ * values of the environment, which are taken from the environment of
+ * the run loading the snapshot */
+static void save_variable_set (struct snapshot_writer * w,
+                               struct variable_set * set, int global)
+{
+  struct variable ** vars = (struct variable **) hash_dump (&set->table, NULL, NULL);
+  struct variable ** itr;
+  uint32_t count = 0;
+
+  for (itr = vars; *itr != NULL; ++itr)
+    if (!global || (*itr)->origin != o_automatic)
+      ++count;
+
+  put_u32 (w, count);
+  for (itr = vars; *itr != NULL; ++itr)
+    if (!global || (*itr)->origin != o_automatic)
+      save_variable (w, *itr, !global || ((*itr)->origin != o_env
+                                          && (*itr)->origin != o_env_override));
+
+  free (vars);
+}
+
+static void save_commands (struct snapshot_writer * w, const struct commands * cmds)
+{
+  put_u32 (w, cmds != NULL);
+  if (cmds == NULL)
+    return;
+
+  put_floc (w, &cmds->fileinfo);
+  put_string (w, cmds->commands);
+  put_u32 (w, (unsigned char) cmds->recipe_prefix);
+}
+
+static void save_deps (struct snapshot_writer * w, const struct dep * deps)
+{
+  const struct dep * d;
+  uint32_t count = 0;
+
+  for (d = deps; d != NULL; d = d->next)
+    ++count;
+
+  put_u32 (w, count);
+  for (d = deps; d != NULL; d = d->next)
+    {
+      uint32_t flags = d->flags;
+
+      if (d->changed)
+        flags |= DEP_CHANGED;
+      if (d->ignore_mtime)
+        flags |= DEP_IGNORE_MTIME;
+      if (d->staticpattern)
+        flags |= DEP_STATICPATTERN;
+      if (d->need_2nd_expansion)
+        flags |= DEP_2ND_EXPANSION;
+      if (d->name != NULL)
+        flags |= DEP_HAS_NAME;
+      if (d->file != NULL)
+        flags |= DEP_HAS_FILE;
+
+      put_string (w, dep_name (d));
+      put_string (w, d->stem);
+      put_u32 (w, flags);
+    }
+}
+
+/** A file and all of its double-colon entries */
+static void save_file (struct snapshot_writer * w, struct file * file)
+{
+  struct file * f;
+  uint32_t count = 0;
+
+  for (f = file; f != NULL; f = f->prev)
+    ++count;
+
+  put_string (w, file->name);
+  put_u32 (w, count);
+  for (f = file; f != NULL; f = f->prev)
+    {
+      uint32_t flags = 0;
+
+      if (f->is_target)
+        flags |= ENTRY_TARGET;
+      if (f->dontcare)
+        flags |= ENTRY_DONTCARE;
+      if (f->double_colon)
+        flags |= ENTRY_DOUBLE_COLON;
+
+      put_u32 (w, flags);
+      put_string (w, f->stem);
+      save_commands (w, f->cmds);
+      save_deps (w, f->deps);
+      save_deps (w, f->also_make);
+      put_u32 (w, f->variables != NULL);
+      if (f->variables != NULL)
+        save_variable_set (w, f->variables->set, 0);
+    }
+}
+
+static void save_pattern_rules (struct snapshot_writer * w)
+{
+  struct rule * rule;
+  uint32_t count = 0;
+
+  for (rule = pattern_rules; rule != NULL; rule = rule->next)
+    ++count;
+
+  put_u32 (w, count);
+  for (rule = pattern_rules; rule != NULL; rule = rule->next)
+    {
+      unsigned int i;
+
+      put_u32 (w, rule->num);
+      for (i = 0; i < rule->num; ++i)
+        {
+          put_string (w, rule->targets[i]);
+          put_u32 (w, (uint32_t) (rule->suffixes[i] - 1 - rule->targets[i]));
+        }
+      put_u32 (w, rule->terminal);
+      save_deps (w, rule->deps);
+      save_commands (w, rule->cmds);
+    }
+}
+
+static void save_pattern_vars (struct snapshot_writer * w)
+{
+  struct pattern_var * p;
+  uint32_t count = 0;
+
+  for (p = first_pattern_var (); p != NULL; p = p->next)
+    ++count;
+
+  put_u32 (w, count);
+  for (p = first_pattern_var (); p != NULL; p = p->next)
+    {
+      put_string (w, p->target);
+      put_u32 (w, (uint32_t) (p->suffix - 1 - p->target));
+      save_variable (w, &p->variable, 1);
+    }
+}
+
+static void count_vpath (const char * pattern UNUSED, const char * path UNUSED,
+                         void * arg)
+{
+  ++*(uint32_t *) arg;
+}
+
+static void save_vpath (const char * pattern, const char * path, void * arg)
+{
+  struct snapshot_writer * w = (struct snapshot_writer *) arg;
+  put_string (w, pattern);
+  put_string (w, path);
+}
+
+/** Writes to a temporary file renamed over filename at the end, so that
+ * a make loading the snapshot meanwhile never sees half of it */
+void save_database (const char * filename, struct goaldep * read_files)
+{
+  struct snapshot_writer w;
+  struct file ** files;
+  struct goaldep * d;
+  unsigned long fileCount;
+  unsigned long i;
+  uint32_t flags = 0;
+  uint32_t count = 0;
+  const char * loaded = variable_value (".LOADED");
+  char * temporary;
+  FILE * f;
+
+  recording = 0;
+  if (loaded != NULL && *loaded != '\0')
+    {
+      OS (error, NILF,
+          _("warning: not writing snapshot '%s': makefiles loaded objects"),
+          filename);
+      goto done;
+    }
+  if (sideEffect != NULL)
+    {
+      OSS (error, NILF,
+           _("warning: not writing snapshot '%s': reading the makefiles ran %s"),
+           filename, sideEffect);
+      goto done;
+    }
+
+  temporary = xstrdup (concat (2, filename, ".tmp"));
+  f = fopen (temporary, "wb");
+  if (f == NULL)
+    {
+      perror_with_name (_("fopen (snapshot file): "), temporary);
+      free (temporary);
+      goto done;
+    }
+
+  outbuf_init (&w.out, f);
+  hash_init (&w.strings, 4096, saved_string_hash_1, saved_string_hash_2,
+             saved_string_hash_cmp);
+  w.stringCount = 0;
+
+  outbuf_write (&w.out, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC));
+  put_u32 (&w, SNAPSHOT_VERSION);
+  put_string (&w, snapshotKey);
+  save_makefiles (&w, read_files);
+
+  if (posix_pedantic)
+    flags |= DB_POSIX;
+  if (second_expansion)
+    flags |= DB_SECOND_EXPANSION;
+  if (one_shell)
+    flags |= DB_ONE_SHELL;
+  if (export_all_variables)
+    flags |= DB_EXPORT_ALL;
+  put_u32 (&w, flags);
+
+  save_variable_set (&w, current_variable_set_list->set, 1);
+
+  /* The built-in suffix rules are there before reading; files the
+     makefiles mention are not built-in any more */
+  files = get_all_files (&fileCount);
+  for (i = 0; i < fileCount; ++i)
+    if (!files[i]->builtin)
+      ++count;
+  put_u32 (&w, count);
+  for (i = 0; i < fileCount; ++i)
+    if (!files[i]->builtin)
+      save_file (&w, files[i]);
+  free (files);
+
+  save_pattern_rules (&w);
+  save_pattern_vars (&w);
+
+  count = 0;
+  map_vpath_lists (count_vpath, &count);
+  put_u32 (&w, count);
+  map_vpath_lists (save_vpath, &w);
+
+  count = 0;
+  for (d = read_files; d != NULL; d = d->next)
+    ++count;
+  put_u32 (&w, count);
+  for (d = read_files; d != NULL; d = d->next)
+    {
+      put_string (&w, d->file->name);
+      put_u32 (&w, d->flags);
+      put_u32 (&w, (uint32_t) d->error);
+      put_floc (&w, &d->floc);
+    }
+
+  outbuf_close (&w.out);
+  hash_free (&w.strings, 1);
+
+  if (ferror (f) | fclose (f))
+    {
+      perror_with_name (_("write (snapshot file): "), temporary);
+      unlink (temporary);
+    }
+  else if (rename (temporary, filename) != 0)
+    {
+      perror_with_name (_("rename (snapshot file): "), filename);
+      unlink (temporary);
+    }
+  free (temporary);
+
+ done:
+  hash_free (&inputs, 0);
+}
+
+/** Checks the header, the key and the makefiles.  Nothing has been
+ * changed if this fails */
+static const char * check_snapshot (struct snapshot_reader * r)
+{
+  const char * key;
+  uint32_t count;
+  uint32_t i;
+
+  if ((size_t) (r->end - r->p) < sizeof (SNAPSHOT_MAGIC)
+      || memcmp (r->p, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC)) != 0)
+    return _("not a snapshot");
+  r->p += sizeof (SNAPSHOT_MAGIC);
+  if (get_u32 (r) != SNAPSHOT_VERSION)
+    return _("written by another version");
+
+  key = get_string (r);
+  if (key == NULL || snapshotKey == NULL || !streq (key, snapshotKey))
+    return _("taken with other flags, variables or makefiles");
+
+  count = get_u32 (r);
+  for (i = 0; i < count && !r->bad; ++i)
+    {
+      const char * name = get_string (r);
+      uint64_t mtime = get_u64 (r);
+      uint64_t size = get_u64 (r);
+      uint64_t nowMtime;
+      uint64_t nowSize;
+
+      if (name == NULL)
+        break;
+      makefile_state (name, &nowMtime, &nowSize);
+      if (nowMtime != mtime || nowSize != size)
+        {
+          DB (DB_BASIC, (_("'%s' changed since the snapshot.\n"), name));
+          return _("a makefile or a file it looked at changed");
+        }
+    }
+
+  return r->bad ? _("truncated") : NULL;
+}
+
+static void load_variable (struct snapshot_reader * r, struct variable_set * set)
+{
+  const char * name = get_string (r);
+  const char * value = get_string (r);
+  floc location;
+  uint32_t flags;
+  enum variable_origin origin;
+  struct variable * v;
+
+  get_floc (r, &location);
+  flags = get_u32 (r);
+  if (r->bad || name == NULL)
+    return;
+
+  origin = (enum variable_origin) ((flags >> VAR_ORIGIN_SHIFT) & 7);
+  if (value == NULL)
+    {
+      /* Only its export flag; the value comes from this environment */
+      v = lookup_variable_in_set (name, strlen (name), set);
+      if (v != NULL)
+        v->export = (enum variable_export) ((flags >> VAR_EXPORT_SHIFT) & 3);
+      return;
+    }
+
+  v = define_variable_in_set (name, strlen (name), value, origin,
+                              (flags & VAR_RECURSIVE) != 0, set, &location);
+  if (v->origin != origin)
+    /* Something of a higher priority, like the command line, has it */
+    return;
+
+  v->append = (flags & VAR_APPEND) != 0;
+  v->conditional = (flags & VAR_CONDITIONAL) != 0;
+  v->per_target = (flags & VAR_PER_TARGET) != 0;
+  v->private_var = (flags & VAR_PRIVATE) != 0;
+  v->flavor = (enum variable_flavor) ((flags >> VAR_FLAVOR_SHIFT) & 7);
+  v->export = (enum variable_export) ((flags >> VAR_EXPORT_SHIFT) & 3);
+}
+
+static void load_variable_set (struct snapshot_reader * r, struct variable_set * set)
+{
+  uint32_t count = get_u32 (r);
+  uint32_t i;
+
+  for (i = 0; i < count && !r->bad; ++i)
+    load_variable (r, set);
+}
+
+static struct commands * load_commands (struct snapshot_reader * r)
+{
+  struct commands * cmds;
+  const char * text;
+
+  if (!get_u32 (r))
+    return NULL;
+
+  cmds = (struct commands *) xcalloc (sizeof (struct commands));
+  get_floc (r, &cmds->fileinfo);
+  text = get_string (r);
+  cmds->commands = xstrdup (text != NULL ? text : "");
+  cmds->recipe_prefix = (char) get_u32 (r);
+  return cmds;
+}
+
+static struct file * find_or_enter (const char * name)
+{
+  struct file * f = lookup_file (name);
+  return f != NULL ? f : enter_file (name);
+}
+
+static struct dep * load_deps (struct snapshot_reader * r)
+{
+  uint32_t count = get_u32 (r);
+  struct dep * deps = NULL;
+  struct dep ** tail = &deps;
+  uint32_t i;
+
+  for (i = 0; i < count && !r->bad; ++i)
+    {
+      const char * name = get_name (r);
+      const char * stem = get_string (r);
+      uint32_t flags = get_u32 (r);
+      struct dep * d = alloc_dep ();
+
+      d->flags = flags & 0xff;
+      d->changed = (flags & DEP_CHANGED) != 0;
+      d->ignore_mtime = (flags & DEP_IGNORE_MTIME) != 0;
+      d->staticpattern = (flags & DEP_STATICPATTERN) != 0;
+      d->need_2nd_expansion = (flags & DEP_2ND_EXPANSION) != 0;
+      d->stem = stem != NULL ? strcache_add (stem) : NULL;
+      if (flags & DEP_HAS_FILE)
+        d->file = find_or_enter (name);
+      if (flags & DEP_HAS_NAME)
+        /* Names waiting for a second expansion are freed after it */
+        d->name = d->need_2nd_expansion ? xstrdup (name) : name;
+
+      *tail = d;
+      tail = &d->next;
+    }
+
+  return deps;
+}
+
+static void load_file_entries (struct snapshot_reader * r)
+{
+  const char * name = get_name (r);
+  uint32_t count = get_u32 (r);
+  uint32_t i;
+
+  for (i = 0; i < count && !r->bad; ++i)
+    {
+      uint32_t flags = get_u32 (r);
+      const char * stem = get_string (r);
+      struct file * f;
+
+      /* After the first double-colon entry enter_file () makes new ones */
+      f = i == 0 ? find_or_enter (name) : enter_file (name);
+      if (i == 0 && (flags & ENTRY_DOUBLE_COLON))
+        f->double_colon = f;
+
+      f->builtin = 0;
+      f->is_target = (flags & ENTRY_TARGET) != 0;
+      f->dontcare = (flags & ENTRY_DONTCARE) != 0;
+      f->stem = stem != NULL ? strcache_add (stem) : NULL;
+      f->cmds = load_commands (r);
+      free_dep_chain (f->deps);
+      f->deps = load_deps (r);
+      free_dep_chain (f->also_make);
+      f->also_make = load_deps (r);
+      if (get_u32 (r))
+        {
+          initialize_file_variables (f, 1);
+          load_variable_set (r, f->variables->set);
+        }
+    }
+}
+
+static void load_pattern_rules (struct snapshot_reader * r)
+{
+  uint32_t count = get_u32 (r);
+  uint32_t i;
+
+  for (i = 0; i < count && !r->bad; ++i)
+    {
+      unsigned short num = (unsigned short) get_u32 (r);
+      const char ** targets = (const char **) xmalloc ((num + 1) * sizeof (const char *));
+      const char ** percents = (const char **) xmalloc ((num + 1) * sizeof (const char *));
+      unsigned short t;
+      int terminal;
+      struct dep * deps;
+
+      for (t = 0; t < num; ++t)
+        {
+          targets[t] = get_name (r);
+          percents[t] = targets[t] + get_u32 (r);
+          if (percents[t] >= targets[t] + strlen (targets[t]))
+            r->bad = 1;
+        }
+      terminal = (int) get_u32 (r);
+      deps = load_deps (r);
+      if (r->bad || num == 0)
+        break;
+      create_pattern_rule (targets, percents, num, terminal, deps,
+                           load_commands (r), 1);
+    }
+}
+
+static void load_pattern_vars (struct snapshot_reader * r)
+{
+  uint32_t count = get_u32 (r);
+  uint32_t i;
+
+  for (i = 0; i < count && !r->bad; ++i)
+    {
+      const char * target = get_name (r);
+      uint32_t percent = get_u32 (r);
+      const char * name = get_string (r);
+      const char * value = get_string (r);
+      uint32_t flags;
+      struct pattern_var * p;
+
+      if (r->bad || percent >= strlen (target) || name == NULL || value == NULL)
+        {
+          r->bad = 1;
+          break;
+        }
+
+      p = create_pattern_var (target, target + percent);
+      get_floc (r, &p->variable.fileinfo);
+      flags = get_u32 (r);
+      p->variable.name = xstrdup (name);
+      p->variable.length = (unsigned int) strlen (name);
+      p->variable.value = xstrdup (value);
+      p->variable.recursive = (flags & VAR_RECURSIVE) != 0;
+      p->variable.append = (flags & VAR_APPEND) != 0;
+      p->variable.conditional = (flags & VAR_CONDITIONAL) != 0;
+      p->variable.per_target = (flags & VAR_PER_TARGET) != 0;
+      p->variable.private_var = (flags & VAR_PRIVATE) != 0;
+      p->variable.flavor = (enum variable_flavor) ((flags >> VAR_FLAVOR_SHIFT) & 7);
+      p->variable.origin = (enum variable_origin) ((flags >> VAR_ORIGIN_SHIFT) & 7);
+      p->variable.export = (enum variable_export) ((flags >> VAR_EXPORT_SHIFT) & 3);
+    }
+}
+
+/** The listings were saved newest first and construct_vpath_list ()
+ * puts each new one first */
+static void load_vpaths (struct snapshot_reader * r)
+{
+  uint32_t count = get_u32 (r);
+  const char ** strings;
+  uint32_t i;
+
+  strings = (const char **) xmalloc ((2 * count + 1) * sizeof (const char *));
+  for (i = 0; i < count && !r->bad; ++i)
+    {
+      strings[2 * i] = get_string (r);
+      strings[2 * i + 1] = get_string (r);
+      if (strings[2 * i] == NULL || strings[2 * i + 1] == NULL)
+        r->bad = 1;
+    }
+
+  if (!r->bad)
+    for (i = count; i > 0; --i)
+      {
+        char * pattern = xstrdup (strings[2 * i - 2]);
+        char * path = xstrdup (strings[2 * i - 1]);
+        construct_vpath_list (pattern, path);
+        free (path);
+        free (pattern);
+      }
+
+  free (strings);
+}
+
+static struct goaldep * load_read_files (struct snapshot_reader * r)
+{
+  uint32_t count = get_u32 (r);
+  struct goaldep * read_files = NULL;
+  struct goaldep ** tail = &read_files;
+  uint32_t i;
+
+  for (i = 0; i < count && !r->bad; ++i)
+    {
+      struct goaldep * d = alloc_goaldep ();
+
+      d->file = find_or_enter (get_name (r));
+      d->flags = get_u32 (r);
+      d->error = (int) get_u32 (r);
+      get_floc (r, &d->floc);
+
+      *tail = d;
+      tail = &d->next;
+    }
+
+  return read_files;
+}
+
+static char * read_whole_file (const char * filename, size_t * size)
+{
+  FILE * f = fopen (filename, "rb");
+  char * buffer;
+  size_t capacity = 1024 * 1024;
+  size_t got;
+
+  if (f == NULL)
+    return NULL;
+
+  buffer = (char *) xmalloc (capacity);
+  *size = 0;
+  while ((got = fread (buffer + *size, 1, capacity - *size, f)) > 0)
+    {
+      *size += got;
+      if (*size == capacity)
+        {
+          capacity *= 2;
+          buffer = (char *) xrealloc (buffer, capacity);
+        }
+    }
+
+  if (ferror (f))
+    {
+      free (buffer);
+      buffer = NULL;
+    }
+  fclose (f);
+  return buffer;
+}
+
+int load_database (const char * filename, struct goaldep ** read_files)
+{
+  struct snapshot_reader r;
+  const char * problem;
+  char * buffer;
+  size_t size;
+  uint32_t flags;
+  uint32_t count;
+  uint32_t i;
+
+  buffer = read_whole_file (filename, &size);
+  if (buffer == NULL)
+    {
+      DB (DB_BASIC, (_("No snapshot in '%s'.\n"), filename));
+      return 0;
+    }
+
+  memset (&r, 0, sizeof (r));
+  r.p = buffer;
+  r.end = buffer + size;
+  problem = check_snapshot (&r);
+  if (problem != NULL)
+    {
+      DB (DB_BASIC, (_("Not using snapshot '%s': %s.\n"), filename, problem));
+      free (r.strings);
+      free (buffer);
+      return 0;
+    }
+
+  DB (DB_BASIC, (_("Reading the data base from snapshot '%s'.\n"), filename));
+
+  /* The makefiles will not be read */
+  if (recording)
+    {
+      recording = 0;
+      hash_free (&inputs, 0);
+    }
+
+  flags = get_u32 (&r);
+  if (flags & DB_POSIX)
+    posix_pedantic = 1;
+  if (flags & DB_SECOND_EXPANSION)
+    second_expansion = 1;
+  if (flags & DB_ONE_SHELL)
+    one_shell = 1;
+  if (flags & DB_EXPORT_ALL)
+    export_all_variables = 1;
+
+  load_variable_set (&r, current_variable_set_list->set);
+
+  count = get_u32 (&r);
+  for (i = 0; i < count && !r.bad; ++i)
+    load_file_entries (&r);
+
+  load_pattern_rules (&r);
+  load_pattern_vars (&r);
+  load_vpaths (&r);
+  *read_files = load_read_files (&r);
+
+  /* Past the checks the data base has been changed: there is no going
+     back to reading the makefiles */
+  if (r.bad || r.p != r.end)
+    OS (fatal, NILF, _("snapshot '%s' is corrupt"), filename);
+
+  free (r.strings);
+  free (buffer);
+  return 1;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A snapshot of the data base as reading the makefiles leaves it: the
+   files with their rules and target-specific variables, the global
+   variables, pattern rules, pattern-specific variables and vpath
+   directives.  Loading a snapshot takes the place of reading the
+   makefiles, and everything that follows reading runs as usual.
+
+   A snapshot is only used if it was taken in the same directory, with
+   the same flags, command-line variables, makefile arguments and
+   environment, and if every makefile read (or looked for), every
+   directory a wildcard read and every file $(file <) read then still
+   has the same modification time and size.  Makefiles that run
+   commands or write files while they are read are not saved.  */
+
+/* Records what reading the makefiles depends on.  MAKEFILES is the list
+   given with -f, or NULL.  If SAVING is nonzero the files the makefiles
+   look at are recorded until save_database.  Call before reading the
+   makefiles */
+void init_database_snapshot (const char ** makefiles, int saving);
+
+/* While reading for a snapshot, notes a file or directory the makefiles
+   looked at besides themselves */
+void snapshot_note_input (const char * name);
+
+/* While reading for a snapshot, notes that WHAT ran, such as $(shell),
+   whose effects a snapshot cannot reproduce */
+void snapshot_note_side_effect (const char * what);
+
+/* Returns nonzero and sets *read_files as read_all_makefiles () would
+   if filename holds a snapshot that is valid for this run */
+int load_database (const char * filename, struct goaldep ** read_files);
+
+void save_database (const char * filename, struct goaldep * read_files);
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "job.h"
+#include "os.h"
+#include "jsonout.h"
+#include "history.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+
+/* Events are written out once this much has been buffered.  Since the
+   buffer is only flushed between events, every write () holds whole
+   events and appends from several makes cannot interleave inside one */
+#define TRACE_FLUSH_SIZE (64 * 1024)
+
+static FILE * traceFile = NULL;
+static struct json_writer traceWriter;
+static int topLevel;
+static unsigned long tracePid;
+
+/* Which lanes are taken by running recipes, and how many have been named */
+static unsigned char * laneBusy = NULL;
+static unsigned int laneCount = 0;
+
+static void end_event (void)
+{
+  json_raw (&traceWriter, ",\n");
+  if (traceWriter.out.used >= TRACE_FLUSH_SIZE)
+    flush_trace_events ();
+}
+
+static void begin_event (const char * phase, const char * name)
+{
+  json_begin_object (&traceWriter);
+  json_key (&traceWriter, "ph");
+  json_string (&traceWriter, phase);
+  json_key (&traceWriter, "name");
+  json_string (&traceWriter, name);
+  json_key (&traceWriter, "pid");
+  json_ulong (&traceWriter, tracePid);
+}
+
+static void write_name (const char * kind, unsigned int lane, const char * name)
+{
+  begin_event ("M", kind);
+  json_key (&traceWriter, "tid");
+  json_ulong (&traceWriter, lane);
+  json_key (&traceWriter, "args");
+  json_begin_object (&traceWriter);
+  json_key (&traceWriter, "name");
+  json_string (&traceWriter, name);
+  json_end_object (&traceWriter);
+  json_end_object (&traceWriter);
+}
+
+static void write_times (double start, double end)
+{
+  json_key (&traceWriter, "ts");
+  json_double (&traceWriter, start * 1e6);
+  json_key (&traceWriter, "dur");
+  json_double (&traceWriter, (end - start) * 1e6);
+}
+
+/** Starts the trace.  The top-level make truncates the file;
+ * sub-makes and re-executed makes (APPEND) add to it */
+void init_trace_events (const char * filename, int top_level, int restarted)
+{
+  int append = !top_level || restarted;
+  int fd;
+
+  /* Even the top-level make appends, or it would
+     write over the events of its sub-makes */
+  EINTRLOOP (fd, open (filename, O_WRONLY | O_CREAT | O_APPEND
+                                 | (append ? 0 : O_TRUNC), 0666));
+  if (fd >= 0)
+    {
+      fd_noinherit (fd);
+      traceFile = fdopen (fd, "a");
+    }
+  if (traceFile == NULL)
+    {
+      perror_with_name (_("fopen (trace events file): "), filename);
+      return;
+    }
+
+  /* Let every flush go straight to a single write () */
+  setvbuf (traceFile, NULL, _IONBF, 0);
+  json_init (&traceWriter, traceFile, 0);
+  topLevel = top_level;
+  tracePid = (unsigned long) getpid ();
+
+  if (!append)
+    json_raw (&traceWriter, "[\n");
+  write_name ("thread_name", 0, "make");
+  end_event ();
+
+  /* The array has to be open before any sub-make appends to it */
+  flush_trace_events ();
+}
+
+void flush_trace_events (void)
+{
+  if (traceFile != NULL)
+    outbuf_flush (&traceWriter.out);
+}
+
+/** Names this process's track after its level and directory.  The
+ * top-level make's event is the last one and closes the array */
+void finish_trace_events (void)
+{
+  char name[64];
+
+  if (traceFile == NULL)
+    {
+      return;
+    }
+
+  sprintf (name, "make[%u] ", makelevel);
+  write_name ("process_name", 0, concat (2, name, starting_directory
+                                               ? starting_directory : ""));
+  json_raw (&traceWriter, topLevel ? "\n]\n" : ",\n");
+  json_finish (&traceWriter);
+  fclose (traceFile);
+  traceFile = NULL;
+  free (laneBusy);
+  laneBusy = NULL;
+}
+
+double trace_start (void)
+{
+  return traceFile != NULL ? recipe_clock () : 0.0;
+}
+
+void trace_span (const char * name, const char * category, double start,
+                 const char * detail)
+{
+  if (traceFile == NULL)
+    {
+      return;
+    }
+
+  begin_event ("X", name);
+  json_key (&traceWriter, "cat");
+  json_string (&traceWriter, category);
+  json_key (&traceWriter, "tid");
+  json_ulong (&traceWriter, 0);
+  write_times (start, recipe_clock ());
+  if (detail != NULL)
+    {
+      json_key (&traceWriter, "args");
+      json_begin_object (&traceWriter);
+      json_key (&traceWriter, "detail");
+      json_string (&traceWriter, detail);
+      json_end_object (&traceWriter);
+    }
+  json_end_object (&traceWriter);
+  end_event ();
+}
+
+/** Returns the lowest free lane, naming it the first time it is used */
+unsigned int trace_take_lane (void)
+{
+  unsigned int lane;
+
+  if (traceFile == NULL)
+    return 0;
+
+  for (lane = 1; lane <= laneCount; ++lane)
+    if (!laneBusy[lane])
+      break;
+
+  if (lane > laneCount)
+    {
+      char name[64];
+
+      laneCount = lane;
+      laneBusy = (unsigned char *) xrealloc (laneBusy, laneCount + 1);
+      sprintf (name, "job slot %u", lane);
+      write_name ("thread_name", lane, name);
+      end_event ();
+    }
+
+  laneBusy[lane] = 1;
+  return lane;
+}
+
+void trace_release_lane (unsigned int lane)
+{
+  if (laneBusy != NULL && lane > 0 && lane <= laneCount)
+    laneBusy[lane] = 0;
+}
+
+void trace_job (const struct child * c, int exit_code, int exit_sig)
+{
+  if (traceFile == NULL)
+    {
+      return;
+    }
+
+  begin_event ("X", c->file->name);
+  json_key (&traceWriter, "cat");
+  json_string (&traceWriter, c->recursive ? "submake" : "recipe");
+  json_key (&traceWriter, "tid");
+  json_ulong (&traceWriter, c->trace_lane);
+  write_times (c->command_start, recipe_clock ());
+  json_key (&traceWriter, "args");
+  json_begin_object (&traceWriter);
+  json_key (&traceWriter, "pid");
+  json_long (&traceWriter, (long) c->pid);
+  json_key (&traceWriter, "line");
+  json_ulong (&traceWriter, c->command_line);
+  json_key (&traceWriter, "exit_code");
+  json_long (&traceWriter, exit_code);
+  if (exit_sig != 0)
+    {
+      json_key (&traceWriter, "signal");
+      json_long (&traceWriter, exit_sig);
+    }
+  json_end_object (&traceWriter);
+  json_end_object (&traceWriter);
+  end_event ();
+}
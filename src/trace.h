@@ -0,0 +1,40 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Trace Event Format output, readable by chrome://tracing and Perfetto.
+   The file is a JSON array with one event per line.  The top-level make
+   creates it and closes the array when it exits; sub-makes append their
+   events to it, each on its own process track.  A top-level make that
+   re-executed itself after remaking makefiles appends to the array it
+   opened before, and still closes it.  Every running recipe
+   gets a lane (thread) of its own for as long as it runs; lane 0 is
+   make itself, where makefile parsing, $(shell) and goal updates show
+   up.  When tracing is off every call below returns at once.  */
+
+struct child;
+
+/* restarted is nonzero in a make that re-executed itself */
+void init_trace_events (const char * filename, int top_level, int restarted);
+void flush_trace_events (void);
+void finish_trace_events (void);
+
+/* Returns the time to pass to trace_span, or 0 when tracing is off */
+double trace_start (void);
+void trace_span (const char * name, const char * category, double start,
+                 const char * detail);
+
+unsigned int trace_take_lane (void);
+void trace_release_lane (unsigned int lane);
+
+/* Records the command of C that has just finished */
+void trace_job (const struct child * c, int exit_code, int exit_sig);
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "variable.h"
+#include "vardefs.h"
+#include "jsonout.h"
+
+#include <stdio.h>
+
+struct vardef
+{
+  const char * name;            /* both strings live in the strcache */
+  const char * filename;
+  unsigned long lineno;
+  unsigned long sequence;       /* position in reading order */
+  unsigned char flavor;
+  unsigned char origin;
+  unsigned char flags;
+};
+
+static int recording = 0;
+static struct vardef * definitions = NULL;
+static unsigned long definitionCount = 0;
+static unsigned long definitionCapacity = 0;
+
+void init_definition_history (void)
+{
+  recording = 1;
+}
+
+void record_variable_definition (const char * name, const floc * flocp,
+                                 enum variable_flavor flavor,
+                                 enum variable_origin origin,
+                                 unsigned int flags)
+{
+  struct vardef * d;
+
+  if (!recording || flocp == NULL || flocp->filenm == NULL)
+    {
+      return;
+    }
+
+  if (definitionCount == definitionCapacity)
+    {
+      definitionCapacity = definitionCapacity ? definitionCapacity * 2 : 1024;
+      definitions = (struct vardef *) xrealloc (definitions,
+                                                definitionCapacity * sizeof (struct vardef));
+    }
+
+  d = &definitions[definitionCount];
+  d->name = strcache_add (name);
+  d->filename = flocp->filenm;
+  d->lineno = flocp->lineno;
+  d->sequence = definitionCount;
+  d->flavor = (unsigned char) flavor;
+  d->origin = (unsigned char) origin;
+  d->flags = (unsigned char) flags;
+  ++definitionCount;
+}
+
+/** Groups the definitions of a variable together, in reading order */
+static int vardef_compare (const void * a, const void * b)
+{
+  const struct vardef * aDef = (const struct vardef *) a;
+  const struct vardef * bDef = (const struct vardef *) b;
+  int result = strcmp (aDef->name, bDef->name);
+
+  if (result == 0)
+    result = aDef->sequence < bDef->sequence ? -1 : 1;
+  return result;
+}
+
+static const char * flavor_operator (unsigned char flavor)
+{
+  switch (flavor)
+    {
+    case f_simple: return ":=";
+    case f_recursive: return "=";
+    case f_append: return "+=";
+    case f_conditional: return "?=";
+    case f_shell: return "!=";
+    default: return "?";
+    }
+}
+
+const char * variable_origin_name (unsigned char origin)
+{
+  switch (origin)
+    {
+    case o_default: return "default";
+    case o_env: return "environment";
+    case o_file: return "file";
+    case o_env_override: return "environment override";
+    case o_command: return "command line";
+    case o_override: return "override";
+    case o_automatic: return "automatic";
+    default: return "invalid";
+    }
+}
+
+/** Counts the definitions that replaced an earlier value */
+static unsigned long count_overrides (const struct vardef * first,
+                                      unsigned long count)
+{
+  unsigned long overrides = 0;
+  unsigned long i;
+
+  for (i = 1; i < count; ++i)
+    if (!(first[i].flags & (VARDEF_IGNORED | VARDEF_APPENDS)))
+      ++overrides;
+  return overrides;
+}
+
+/** Index of the definition that gave the variable its final value,
+ * ignoring the ones that appended to it */
+static unsigned long final_definition (const struct vardef * first,
+                                       unsigned long count)
+{
+  unsigned long final = 0;
+  unsigned long i;
+
+  for (i = 0; i < count; ++i)
+    if (!(first[i].flags & (VARDEF_IGNORED | VARDEF_APPENDS)))
+      final = i;
+  return final;
+}
+
+static const char * definition_effect (const struct vardef * d, int isFinal)
+{
+  if (d->flags & VARDEF_IGNORED)
+    return "ignored";
+  if (d->flags & VARDEF_APPENDS)
+    return "appends";
+  return isFinal ? "final" : "overridden";
+}
+
+void report_multiple_definitions (const char * filename)
+{
+  struct json_writer w;
+  FILE * f = NULL;
+  unsigned long variables = 0;
+  unsigned long totalOverrides = 0;
+  unsigned long start;
+  unsigned long end;
+  int json = !streq (filename, "-");
+
+  recording = 0;
+  qsort (definitions, definitionCount, sizeof (struct vardef), vardef_compare);
+
+  if (json)
+    {
+      f = fopen (filename, "w");
+      if (f == NULL)
+        {
+          perror_with_name (_("fopen (multiple definitions file): "), filename);
+          goto done;
+        }
+      json_init (&w, f, 0);
+      json_begin_object (&w);
+      json_key (&w, "variables");
+      json_begin_array (&w);
+    }
+
+  for (start = 0; start < definitionCount; start = end)
+    {
+      const struct vardef * first = &definitions[start];
+      unsigned long overrides;
+      unsigned long final;
+      unsigned long i;
+
+      for (end = start + 1; end < definitionCount; ++end)
+        if (definitions[end].name != first->name)
+          break;
+
+      overrides = count_overrides (first, end - start);
+      if (overrides == 0)
+        continue;
+      ++variables;
+      totalOverrides += overrides;
+      final = final_definition (first, end - start);
+
+      if (json)
+        {
+          json_begin_object (&w);
+          json_key (&w, "name");
+          json_string (&w, first->name);
+          json_key (&w, "count");
+          json_ulong (&w, end - start);
+          json_key (&w, "overrides");
+          json_ulong (&w, overrides);
+          json_key (&w, "definitions");
+          json_begin_array (&w);
+        }
+      else
+        printf (_("%s: %lu definitions, %lu overrides\n"), first->name,
+                end - start, overrides);
+
+      for (i = 0; i < end - start; ++i)
+        {
+          const struct vardef * d = &first[i];
+          const char * effect = definition_effect (d, i == final);
+
+          if (json)
+            {
+              json_begin_object (&w);
+              json_key (&w, "file");
+              json_string (&w, d->filename);
+              json_key (&w, "line");
+              json_ulong (&w, d->lineno);
+              json_key (&w, "flavor");
+              json_string (&w, flavor_operator (d->flavor));
+              json_key (&w, "origin");
+              json_string (&w, variable_origin_name (d->origin));
+              json_key (&w, "effect");
+              json_string (&w, effect);
+              json_end_object (&w);
+            }
+          else
+            printf ("  %s:%lu: %s (%s) %s\n", d->filename, d->lineno,
+                    flavor_operator (d->flavor), variable_origin_name (d->origin),
+                    effect);
+        }
+
+      if (json)
+        {
+          json_end_array (&w);
+          json_end_object (&w);
+        }
+    }
+
+  if (json)
+    {
+      json_end_array (&w);
+      json_key (&w, "count");
+      json_ulong (&w, variables);
+      json_key (&w, "overrides");
+      json_ulong (&w, totalOverrides);
+      json_end_object (&w);
+      json_finish (&w);
+      fclose (f);
+    }
+  else if (variables == 0)
+    printf (_("No variable is defined more than once.\n"));
+  else
+    printf (_("%lu variables are defined more than once, with %lu overrides\n"),
+            variables, totalOverrides);
+
+ done:
+  free (definitions);
+  definitions = NULL;
+  definitionCount = definitionCapacity = 0;
+}
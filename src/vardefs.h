@@ -0,0 +1,34 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The history of every global variable definition read from a makefile.
+   Recording a definition only appends a small record to an array; the
+   grouping by variable happens once, when the report is written.  */
+
+/* Flags of a recorded definition */
+#define VARDEF_IGNORED 1        /* had no effect, e.g. ?= on a set variable */
+#define VARDEF_APPENDS 2        /* added to the previous value */
+
+void init_definition_history (void);
+void record_variable_definition (const char * name, const floc * flocp,
+                                 enum variable_flavor flavor,
+                                 enum variable_origin origin,
+                                 unsigned int flags);
+
+/* The name $(origin) gives to ORIGIN */
+const char * variable_origin_name (unsigned char origin);
+
+/* Reports every variable that was assigned more than once.  If filename
+   is "-" the report is printed as text on stdout, otherwise it is
+   written to filename as JSON */
+void report_multiple_definitions (const char * filename);
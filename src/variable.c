@@ -29,6 +29,11 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #endif
 #include "hash.h"
 #include "ctags.h"
+#include "trace.h"
+#include "vardefs.h"
+#include "expcost.h"
+#include "varrefs.h"
+#include "snapshot.h"
 
 /* Incremented every time we add or remove a global variable.  */
 static unsigned long variable_changenum;
@@ -41,6 +46,43 @@ static struct pattern_var *pattern_vars;
 
 static struct pattern_var *last_pattern_vars[256];
 
+/* Index of PATTERN_VARS.  Each pattern is in a group with the others that
+   have the same text before and after the %, so a target only has to be
+   looked up once for each pair of prefix and suffix lengths in use.  */
+
+struct pattern_var_group
+  {
+    const char *prefix;
+    size_t prefix_length;
+    const char *suffix;
+    size_t suffix_length;
+    unsigned int count;
+    unsigned int size;
+    unsigned int *vars;         /* Places in PATTERN_VARS, in order.  */
+  };
+
+struct pattern_var_lengths
+  {
+    size_t prefix;
+    size_t suffix;
+  };
+
+static struct hash_table pattern_var_groups;
+
+/* The pairs of prefix and suffix lengths of the groups.  */
+static struct pattern_var_lengths *pattern_var_lengths;
+static unsigned int num_pattern_var_lengths;
+
+/* PATTERN_VARS as a vector, and room for the places of all of them and
+   for all of them again.  */
+static struct pattern_var **indexed_pattern_vars;
+static unsigned int *found_pattern_vars;
+static struct pattern_var **matched_pattern_vars;
+
+/* Nonzero if pattern-specific variables were added since the index was
+   built.  */
+static int pattern_var_index_stale = 1;
+
 /* Create a new pattern-specific variable struct. The new variable is
    inserted into the PATTERN_VARS list in the shortest patterns first
    order to support the shortest stem matching (the variables are
@@ -93,46 +135,202 @@ create_pattern_var (const char *target, const char *suffix)
   if (len < 256)
     last_pattern_vars[len] = p;
 
+  pattern_var_index_stale = 1;
+
   return p;
 }
 
-/* Look up a target in the pattern-specific variable list.  */
+/* Return the head of the pattern-specific variable list, in the order
+   create_pattern_var () keeps it.  */
+
+struct pattern_var *
+first_pattern_var (void)
+{
+  return pattern_vars;
+}
+
+static unsigned long
+pattern_var_group_hash_1 (const void *key)
+{
+  const struct pattern_var_group *g = key;
+  unsigned long result = g->prefix_length * 31 + g->suffix_length;
+  STRING_N_HASH_1 (g->prefix, g->prefix_length, result);
+  STRING_N_HASH_1 (g->suffix, g->suffix_length, result);
+  return result;
+}
 
-static struct pattern_var *
-lookup_pattern_var (struct pattern_var *start, const char *target)
+static unsigned long
+pattern_var_group_hash_2 (const void *key)
+{
+  const struct pattern_var_group *g = key;
+  unsigned long result = 0;
+  STRING_N_HASH_2 (g->prefix, g->prefix_length, result);
+  STRING_N_HASH_2 (g->suffix, g->suffix_length, result);
+  return result;
+}
+
+static int
+pattern_var_group_hash_cmp (const void *x, const void *y)
+{
+  const struct pattern_var_group *gx = x;
+  const struct pattern_var_group *gy = y;
+  int result;
+
+  if (gx->prefix_length != gy->prefix_length)
+    return gx->prefix_length < gy->prefix_length ? -1 : 1;
+  if (gx->suffix_length != gy->suffix_length)
+    return gx->suffix_length < gy->suffix_length ? -1 : 1;
+  STRING_N_COMPARE (gx->prefix, gy->prefix, gx->prefix_length, result);
+  if (result == 0)
+    STRING_N_COMPARE (gx->suffix, gy->suffix, gx->suffix_length, result);
+  return result;
+}
+
+static void
+free_pattern_var_group (const void *item)
+{
+  struct pattern_var_group *g = (struct pattern_var_group *) item;
+  free (g->vars);
+  free (g);
+}
+
+/* Build the index of the pattern-specific variables.  */
+
+static void
+index_pattern_vars (void)
 {
   struct pattern_var *p;
-  size_t targlen = strlen (target);
+  unsigned int total = 0;
+  unsigned int i;
 
-  for (p = start ? start->next : pattern_vars; p != 0; p = p->next)
+  if (pattern_var_groups.ht_vec == 0)
+    hash_init (&pattern_var_groups, 256, pattern_var_group_hash_1,
+               pattern_var_group_hash_2, pattern_var_group_hash_cmp);
+  else
+    {
+      hash_map (&pattern_var_groups, free_pattern_var_group);
+      hash_delete_items (&pattern_var_groups);
+    }
+  num_pattern_var_lengths = 0;
+
+  for (p = pattern_vars; p != 0; p = p->next)
+    ++total;
+
+  free (indexed_pattern_vars);
+  free (found_pattern_vars);
+  free (matched_pattern_vars);
+  free (pattern_var_lengths);
+  indexed_pattern_vars = xmalloc ((total + 1) * sizeof (struct pattern_var *));
+  found_pattern_vars = xmalloc ((total + 1) * sizeof (unsigned int));
+  matched_pattern_vars = xmalloc ((total + 1) * sizeof (struct pattern_var *));
+  pattern_var_lengths = xmalloc ((total + 1)
+                                 * sizeof (struct pattern_var_lengths));
+
+  for (p = pattern_vars, i = 0; p != 0; p = p->next, ++i)
     {
-      const char *stem;
-      size_t stemlen;
+      struct pattern_var_group key;
+      struct pattern_var_group **slot;
+      struct pattern_var_group *g;
+
+      key.prefix = p->target;
+      key.prefix_length = p->suffix - p->target - 1;
+      key.suffix = p->suffix;
+      key.suffix_length = p->len - key.prefix_length - 1;
+
+      slot = (struct pattern_var_group **) hash_find_slot (&pattern_var_groups,
+                                                           &key);
+      if (HASH_VACANT (*slot))
+        {
+          unsigned int l;
+
+          g = xmalloc (sizeof (struct pattern_var_group));
+          *g = key;
+          g->count = 0;
+          g->size = 0;
+          g->vars = 0;
+          hash_insert_at (&pattern_var_groups, g, slot);
+
+          for (l = 0; l < num_pattern_var_lengths; ++l)
+            if (pattern_var_lengths[l].prefix == key.prefix_length
+                && pattern_var_lengths[l].suffix == key.suffix_length)
+              break;
+          if (l == num_pattern_var_lengths)
+            {
+              pattern_var_lengths[l].prefix = key.prefix_length;
+              pattern_var_lengths[l].suffix = key.suffix_length;
+              ++num_pattern_var_lengths;
+            }
+        }
+      else
+        g = *slot;
 
-      if (p->len > targlen)
-        /* It can't possibly match.  */
-        continue;
+      if (g->count == g->size)
+        {
+          g->size = g->size ? g->size * 2 : 4;
+          g->vars = xrealloc (g->vars, g->size * sizeof (unsigned int));
+        }
+      g->vars[g->count++] = i;
+      indexed_pattern_vars[i] = p;
+    }
+
+  pattern_var_index_stale = 0;
+}
+
+static int
+place_compare (const void *x, const void *y)
+{
+  unsigned int a = *(const unsigned int *) x;
+  unsigned int b = *(const unsigned int *) y;
+  return a < b ? -1 : a > b;
+}
+
+/* Find the pattern-specific variables whose pattern matches TARGET.  They
+   are returned in the order of the pattern-specific variable list, in a
+   vector that is valid until the next call.  The number of them is put in
+   *COUNT.  */
+
+static struct pattern_var **
+lookup_pattern_vars (const char *target, unsigned int *count)
+{
+  size_t targlen = strlen (target);
+  unsigned int n = 0;
+  unsigned int l;
+  unsigned int i;
+
+  if (pattern_var_index_stale)
+    index_pattern_vars ();
 
-      /* From the lengths of the filename and the pattern parts,
-         find the stem: the part of the filename that matches the %.  */
-      stem = target + (p->suffix - p->target - 1);
-      stemlen = targlen - p->len + 1;
+  for (l = 0; l < num_pattern_var_lengths; ++l)
+    {
+      struct pattern_var_group key;
+      const struct pattern_var_group *g;
 
-      /* Compare the text in the pattern before the stem, if any.  */
-      if (stem > target && !strneq (p->target, target, stem - target))
+      /* The stem is never empty.  */
+      key.prefix_length = pattern_var_lengths[l].prefix;
+      key.suffix_length = pattern_var_lengths[l].suffix;
+      if (key.prefix_length + key.suffix_length >= targlen)
         continue;
 
-      /* Compare the text in the pattern after the stem, if any.
-         We could test simply using streq, but this way we compare the
-         first two characters immediately.  This saves time in the very
-         common case where the first character matches because it is a
-         period.  */
-      if (*p->suffix == stem[stemlen]
-          && (*p->suffix == '\0' || streq (&p->suffix[1], &stem[stemlen+1])))
-        break;
+      key.prefix = target;
+      key.suffix = target + targlen - key.suffix_length;
+      g = hash_find_item (&pattern_var_groups, &key);
+      if (g != 0)
+        {
+          memcpy (&found_pattern_vars[n], g->vars,
+                  g->count * sizeof (unsigned int));
+          n += g->count;
+        }
     }
 
-  return p;
+  /* Each group is in order, but the groups are not.  */
+  if (n > 1 && num_pattern_var_lengths > 1)
+    qsort (found_pattern_vars, n, sizeof (unsigned int), place_compare);
+
+  for (i = 0; i < n; ++i)
+    matched_pattern_vars[i] = indexed_pattern_vars[found_pattern_vars[i]];
+
+  *count = n;
+  return matched_pattern_vars;
 }
 
 /* Hash table of all global variable definitions.  */
@@ -603,12 +801,19 @@ initialize_file_variables (struct file *file, int reading)
 
   if (!reading && !file->pat_searched)
     {
-      struct pattern_var *p;
+      struct pattern_var **found;
+      unsigned int nfound;
 
-      p = lookup_pattern_var (0, file->name);
-      if (p != 0)
+      found = lookup_pattern_vars (file->name, &nfound);
+      if (nfound > 0)
         {
           struct variable_set_list *global = current_variable_set_list;
+          struct pattern_var **matches;
+          unsigned int i;
+
+          /* Defining the variables might look up others.  */
+          matches = alloca (nfound * sizeof (struct pattern_var *));
+          memcpy (matches, found, nfound * sizeof (struct pattern_var *));
 
           /* We found at least one.  Set up a new variable set to accumulate
              all the pattern variables that match this target.  */
@@ -616,10 +821,11 @@ initialize_file_variables (struct file *file, int reading)
           file->pat_variables = create_new_variable_set ();
           current_variable_set_list = file->pat_variables;
 
-          do
+          for (i = 0; i < nfound; ++i)
             {
               /* We found one, so insert it into the set.  */
 
+              struct pattern_var *p = matches[i];
               struct variable *v;
 
               if (p->variable.flavor == f_simple)
@@ -644,7 +850,6 @@ initialize_file_variables (struct file *file, int reading)
               v->export = p->variable.export;
               v->private_var = p->variable.private_var;
             }
-          while ((p = lookup_pattern_var (p, file->name)) != 0);
 
           current_variable_set_list = global;
         }
@@ -1148,12 +1353,15 @@ shell_result (const char *p)
   size_t len;
   char *args[2];
   char *result;
+  double start = trace_start ();
 
+  snapshot_note_side_effect ("!=");
   install_variable_buffer (&buf, &len);
 
   args[0] = (char *) p;
   args[1] = NULL;
   variable_buffer_output (func_shell_base (variable_buffer, args, 0), "\0", 1);
+  trace_span ("!=", "shell", start, p);
   result = strdup (variable_buffer);
 
   restore_variable_buffer (buf, len);
@@ -1173,6 +1381,11 @@ do_variable_definition (const floc *flocp, const char *varname,
   struct variable *v;
   int append = 0;
   int conditional = 0;
+  enum variable_flavor written = flavor;
+  unsigned int history = 0;
+
+  /* What the value references, it references on behalf of VARNAME */
+  push_variable_definition (varname);
 
   /* Calculate the variable's new value in VALUE.  */
 
@@ -1204,7 +1417,10 @@ do_variable_definition (const floc *flocp, const char *varname,
          The value is set IFF the variable is not defined yet. */
       v = lookup_variable (varname, strlen (varname));
       if (v)
-        goto done;
+        {
+          history |= VARDEF_IGNORED;
+          goto done;
+        }
 
       conditional = 1;
       flavor = f_recursive;
@@ -1248,6 +1464,8 @@ do_variable_definition (const floc *flocp, const char *varname,
             const char *val;
             char *tp = NULL;
 
+            history |= VARDEF_APPENDS;
+
             val = value;
             if (v->recursive)
               /* The previous definition of the variable was recursive.
@@ -1431,22 +1649,7 @@ do_variable_definition (const floc *flocp, const char *varname,
        current_variable_set_list->set == NULL) &&
       flocp != NULL)
     {
-      add_to_ctags (varname, flocp->filenm, flocp->lineno);
-
-      if (!conditional && detect_multiple_definition)
-        {
-          struct variable * possible_duplicate = lookup_variable (varname, strlen(varname));
-          if (possible_duplicate != NULL && possible_duplicate->fileinfo.filenm != NULL)
-            {
-              /* Re-definition by the user */
-              printf ("%s redefined at %s:%ld, original definition at %s:%ld\n",
-                      varname,
-                      flocp->filenm,
-                      flocp->lineno,
-                      possible_duplicate->fileinfo.filenm,
-                      possible_duplicate->fileinfo.lineno);
-            }
-        }
+      add_to_ctags (varname, flocp->filenm, flocp->lineno, CTAGS_VARIABLE);
     }
 
   v = define_variable_in_set (varname, strlen (varname), p,
@@ -1458,6 +1661,16 @@ do_variable_definition (const floc *flocp, const char *varname,
   v->conditional = conditional;
 
  done:
+  pop_variable_expansion ();
+
+  /* A variable set with a higher priority origin keeps its value */
+  if (v->origin > origin)
+    history |= VARDEF_IGNORED;
+  if (!target_var && written != f_append_value)
+    record_variable_definition (varname, flocp, written, origin, history);
+  if (!target_var && !(history & VARDEF_IGNORED))
+    record_definition_order (varname);
+
   free (alloc_value);
   return v->special ? set_special_var (v) : v;
 }
@@ -16,6 +16,9 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "hash.h"
 
+struct expansion_program;
+struct function_call;
+
 /* Codes in a variable definition saying where the definition came from.
    Increasing numeric values signify less-overridable definitions.  */
 enum variable_origin
@@ -128,9 +131,19 @@ char *expand_argument (const char *str, const char *end);
 char *variable_expand_string (char *line, const char *string, size_t length);
 void install_variable_buffer (char **bufp, size_t *lenp);
 void restore_variable_buffer (char *buf, size_t len);
+struct expansion_program *compile_expansion (const char *string,
+                                             size_t length);
+char *expand_program (char *line, struct expansion_program *program);
+char *allocated_expand_program (struct expansion_program *program);
+void release_expansion (struct expansion_program *program);
 
 /* function.c */
+extern unsigned long function_table_changenum;
 int handle_function (char **op, const char **stringp);
+int compile_function_call (const char *s, const char **endp,
+                           struct function_call **callp);
+char *run_function_call (char *o, const struct function_call *call);
+void free_function_call (struct function_call *call);
 int pattern_matches (const char *pattern, const char *percent, const char *str);
 char *subst_expand (char *o, const char *text, const char *subst,
                     const char *replace, size_t slen, size_t rlen,
@@ -234,6 +247,7 @@ char **target_environment (struct file *file);
 
 struct pattern_var *create_pattern_var (const char *target,
                                         const char *suffix);
+struct pattern_var *first_pattern_var (void);
 
 extern int export_all_variables;
 
@@ -0,0 +1,578 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "variable.h"
+#include "hash.h"
+#include "history.h"
+#include "jsonout.h"
+#include "varrefs.h"
+
+#include <stdio.h>
+
+/* How many of the most expensive variables to follow into chains */
+#define VARREFS_TOP 20
+
+/* Chains stop after this many links, or at the first variable seen twice */
+#define VARREFS_CHAIN_MAX 32
+
+struct varnode
+{
+  const char * name;            /* in the strcache; "" is the top level */
+  unsigned int length;
+  unsigned long references;     /* times it was referenced */
+  unsigned long undefined;      /* of which while it was not defined */
+  unsigned long expansions;
+  unsigned int active;          /* expansions of it in progress */
+  double inclusive;             /* seconds, including what it referenced */
+  double self;
+  struct varedge * heaviest;    /* the reference to the costliest variable */
+};
+
+struct varedge
+{
+  struct varnode * from;
+  struct varnode * to;
+  unsigned long count;
+  unsigned int computed:1;      /* the name was computed at least once */
+};
+
+struct varframe
+{
+  struct varnode * node;
+  double start;
+  double children;              /* seconds spent in nested expansions */
+};
+
+static int collecting = 0;
+static struct hash_table nodes;
+static struct hash_table edges;
+static struct varnode * topLevel;
+
+/* frameCount + 1 while the references made by the innermost frame are
+   make's own lookups, as of VPATH or SHELL; otherwise 0 */
+static unsigned int hiddenFrame = 0;
+
+static struct varframe * frames = NULL;
+static unsigned int frameCount = 0;
+static unsigned int frameCapacity = 0;
+
+static unsigned long varnode_hash_1 (const void * keyv)
+{
+  const struct varnode * key = (const struct varnode *) keyv;
+  return_STRING_N_HASH_1 (key->name, key->length);
+}
+
+static unsigned long varnode_hash_2 (const void * keyv)
+{
+  const struct varnode * key = (const struct varnode *) keyv;
+  return_STRING_N_HASH_2 (key->name, key->length);
+}
+
+static int varnode_hash_cmp (const void * xv, const void * yv)
+{
+  const struct varnode * x = (const struct varnode *) xv;
+  const struct varnode * y = (const struct varnode *) yv;
+  int result = x->length - y->length;
+  if (result)
+    return result;
+  return_STRING_N_COMPARE (x->name, y->name, x->length);
+}
+
+static unsigned long varedge_hash_1 (const void * keyv)
+{
+  const struct varedge * key = (const struct varedge *) keyv;
+  return ((unsigned long) key->from >> 3) * 31 + ((unsigned long) key->to >> 3);
+}
+
+static unsigned long varedge_hash_2 (const void * keyv)
+{
+  const struct varedge * key = (const struct varedge *) keyv;
+  return ((unsigned long) key->to >> 3) * 17 + ((unsigned long) key->from >> 3);
+}
+
+static int varedge_hash_cmp (const void * xv, const void * yv)
+{
+  const struct varedge * x = (const struct varedge *) xv;
+  const struct varedge * y = (const struct varedge *) yv;
+  if (x->from != y->from)
+    return x->from < y->from ? -1 : 1;
+  if (x->to != y->to)
+    return x->to < y->to ? -1 : 1;
+  return 0;
+}
+
+static struct varnode * find_node (const char * name, size_t length)
+{
+  struct varnode key;
+  struct varnode ** slot;
+
+  key.name = name;
+  key.length = (unsigned int) length;
+  slot = (struct varnode **) hash_find_slot (&nodes, &key);
+  if (HASH_VACANT (*slot))
+    {
+      struct varnode * node = (struct varnode *) xcalloc (sizeof (struct varnode));
+      node->name = strcache_add_len (name, length);
+      node->length = (unsigned int) length;
+      hash_insert_at (&nodes, node, slot);
+      return node;
+    }
+  return *slot;
+}
+
+void init_variable_references (void)
+{
+  hash_init (&nodes, 1024, varnode_hash_1, varnode_hash_2, varnode_hash_cmp);
+  hash_init (&edges, 4096, varedge_hash_1, varedge_hash_2, varedge_hash_cmp);
+  topLevel = find_node ("", 0);
+  collecting = 1;
+}
+
+/** Opens a frame for NAME: what is referenced until it is closed is
+ * referenced on behalf of NAME */
+static struct varframe * push_frame (const char * name)
+{
+  struct varframe * frame;
+
+  if (frameCount == frameCapacity)
+    {
+      frameCapacity = frameCapacity ? frameCapacity * 2 : 64;
+      frames = (struct varframe *) xrealloc (frames,
+                                             frameCapacity * sizeof (struct varframe));
+    }
+
+  frame = &frames[frameCount++];
+  frame->node = find_node (name, strlen (name));
+  frame->children = 0.0;
+  ++frame->node->active;
+  frame->start = recipe_clock ();
+  return frame;
+}
+
+void push_variable_expansion (const char * name)
+{
+  if (!collecting)
+    {
+      return;
+    }
+
+  ++push_frame (name)->node->expansions;
+}
+
+void push_variable_definition (const char * name)
+{
+  if (!collecting)
+    {
+      return;
+    }
+
+  push_frame (name);
+}
+
+/** Charges the time of the finished expansion to its variable, once
+ * even if it was expanded recursively, and to the enclosing one */
+void pop_variable_expansion (void)
+{
+  struct varframe * frame;
+  double elapsed;
+
+  if (!collecting || frameCount == 0)
+    {
+      return;
+    }
+
+  frame = &frames[--frameCount];
+  elapsed = recipe_clock () - frame->start;
+  frame->node->self += elapsed - frame->children;
+  if (--frame->node->active == 0)
+    frame->node->inclusive += elapsed;
+  if (frameCount > 0)
+    frames[frameCount - 1].children += elapsed;
+}
+
+void record_variable_reference (const char * name, size_t length,
+                                int defined, int computed)
+{
+  struct varedge key;
+  struct varedge ** slot;
+  struct varedge * edge;
+
+  if (!collecting)
+    {
+      return;
+    }
+
+  if (frameCount + 1 == hiddenFrame)
+    {
+      return;
+    }
+
+  key.from = frameCount > 0 ? frames[frameCount - 1].node : topLevel;
+  key.to = find_node (name, length);
+  ++key.to->references;
+  if (!defined)
+    ++key.to->undefined;
+
+  slot = (struct varedge **) hash_find_slot (&edges, &key);
+  if (HASH_VACANT (*slot))
+    {
+      edge = (struct varedge *) xcalloc (sizeof (struct varedge));
+      edge->from = key.from;
+      edge->to = key.to;
+      hash_insert_at (&edges, edge, slot);
+    }
+  else
+    edge = *slot;
+
+  ++edge->count;
+  if (computed)
+    edge->computed = 1;
+}
+
+unsigned int hide_variable_references (void)
+{
+  unsigned int saved = hiddenFrame;
+  hiddenFrame = frameCount + 1;
+  return saved;
+}
+
+void show_variable_references (unsigned int saved)
+{
+  hiddenFrame = saved;
+}
+
+/** Orders by name, so that the report is stable */
+static int varnode_name_compare (const void * a, const void * b)
+{
+  const struct varnode * x = *(const struct varnode * const *) a;
+  const struct varnode * y = *(const struct varnode * const *) b;
+  return strcmp (x->name, y->name);
+}
+
+/** Orders by decreasing inclusive time */
+static int varnode_cost_compare (const void * a, const void * b)
+{
+  const struct varnode * x = *(const struct varnode * const *) a;
+  const struct varnode * y = *(const struct varnode * const *) b;
+  if (x->inclusive != y->inclusive)
+    return x->inclusive < y->inclusive ? 1 : -1;
+  return strcmp (x->name, y->name);
+}
+
+/** Orders by the names of both ends */
+static int varedge_name_compare (const void * a, const void * b)
+{
+  const struct varedge * x = *(const struct varedge * const *) a;
+  const struct varedge * y = *(const struct varedge * const *) b;
+  int result = strcmp (x->from->name, y->from->name);
+  if (result == 0)
+    result = strcmp (x->to->name, y->to->name);
+  return result;
+}
+
+static int variable_name_compare (const void * a, const void * b)
+{
+  const struct variable * x = *(const struct variable * const *) a;
+  const struct variable * y = *(const struct variable * const *) b;
+  return strcmp (x->name, y->name);
+}
+
+/** Variables that make itself reads without expanding them */
+static int used_by_make (const struct variable * v)
+{
+  static const char * const names[] = {
+    "SHELL", "MAKEFLAGS", "MFLAGS", "MAKEFILES", "MAKEOVERRIDES",
+    "MAKEFILE_LIST", "VPATH", "GPATH", "SUFFIXES", NULL
+  };
+  unsigned int i;
+
+  if (v->name[0] == '.')
+    return 1;
+  for (i = 0; names[i] != NULL; ++i)
+    if (streq (v->name, names[i]))
+      return 1;
+  return 0;
+}
+
+/** Collects the global variables defined in makefiles that no
+ * expansion referenced, sorted by name */
+static struct variable ** find_unreferenced (unsigned long * count)
+{
+  struct variable_set_list * global = current_variable_set_list;
+  struct variable ** found;
+  struct variable ** slot;
+  struct variable ** end;
+  unsigned long n = 0;
+
+  while (global->next != NULL)
+    global = global->next;
+
+  found = (struct variable **) xmalloc ((global->set->table.ht_fill + 1)
+                                         * sizeof (struct variable *));
+  slot = (struct variable **) global->set->table.ht_vec;
+  end = slot + global->set->table.ht_size;
+  for (; slot < end; ++slot)
+    {
+      struct variable * v = *slot;
+      struct varnode key;
+      struct varnode * node;
+
+      if (HASH_VACANT (v) || v->fileinfo.filenm == NULL
+          || (v->origin != o_file && v->origin != o_override)
+          || used_by_make (v))
+        continue;
+
+      key.name = v->name;
+      key.length = v->length;
+      node = (struct varnode *) hash_find_item (&nodes, &key);
+      if (node == NULL || node->references == 0)
+        found[n++] = v;
+    }
+
+  qsort (found, n, sizeof (struct variable *), variable_name_compare);
+  *count = n;
+  return found;
+}
+
+/** Writes the chain of costliest references starting at NODE */
+static void print_chain (struct varnode * node, struct json_writer * w)
+{
+  struct varnode * seen[VARREFS_CHAIN_MAX];
+  unsigned int length = 0;
+  unsigned int i;
+
+  while (node != NULL && length < VARREFS_CHAIN_MAX)
+    {
+      for (i = 0; i < length; ++i)
+        if (seen[i] == node)
+          break;
+      if (i < length)
+        break;
+      seen[length++] = node;
+
+      if (w != NULL)
+        json_string (w, node->name);
+      else
+        printf ("%s%s", length > 1 ? " -> " : "", node->name);
+      node = node->heaviest != NULL ? node->heaviest->to : NULL;
+    }
+}
+
+/** Lists variables defined in makefiles that were never referenced,
+ * variables referenced that were never defined, and the variables whose
+ * expansions took the longest, each followed along its costliest
+ * references.  Only the expansions make actually did count, so a run
+ * with -n -B gives the fullest picture */
+void report_variable_references (const char * filename)
+{
+  struct varnode ** all;
+  struct varnode ** byCost;
+  struct varedge ** edgeList;
+  struct variable ** unreferenced;
+  unsigned long nodeCount;
+  unsigned long edgeCount;
+  unsigned long unreferencedCount;
+  unsigned long undefinedCount = 0;
+  unsigned long topCount;
+  unsigned long i;
+  struct json_writer w;
+  FILE * f = NULL;
+  int json = !streq (filename, "-");
+
+  if (!collecting)
+    {
+      return;
+    }
+  collecting = 0;
+
+  nodeCount = nodes.ht_fill;
+  all = (struct varnode **) hash_dump (&nodes, NULL, varnode_name_compare);
+  edgeCount = edges.ht_fill;
+  edgeList = (struct varedge **) hash_dump (&edges, NULL, varedge_name_compare);
+
+  for (i = 0; i < edgeCount; ++i)
+    {
+      struct varedge * e = edgeList[i];
+      if (e->to != e->from
+          && (e->from->heaviest == NULL
+              || e->to->inclusive > e->from->heaviest->to->inclusive))
+        e->from->heaviest = e;
+    }
+
+  byCost = (struct varnode **) xmalloc ((nodeCount + 1) * sizeof (struct varnode *));
+  topCount = 0;
+  for (i = 0; i < nodeCount; ++i)
+    if (all[i] != topLevel
+        && (all[i]->expansions > 0 || all[i]->heaviest != NULL))
+      byCost[topCount++] = all[i];
+  qsort (byCost, topCount, sizeof (struct varnode *), varnode_cost_compare);
+  if (topCount > VARREFS_TOP)
+    topCount = VARREFS_TOP;
+
+  unreferenced = find_unreferenced (&unreferencedCount);
+
+  if (json)
+    {
+      f = fopen (filename, "w");
+      if (f == NULL)
+        {
+          perror_with_name (_("fopen (variable references file): "), filename);
+          goto done;
+        }
+      json_init (&w, f, 0);
+      json_begin_object (&w);
+
+      json_key (&w, "variables");
+      json_begin_array (&w);
+      for (i = 0; i < nodeCount; ++i)
+        {
+          if (all[i] == topLevel)
+            continue;
+          json_begin_object (&w);
+          json_key (&w, "name");
+          json_string (&w, all[i]->name);
+          json_key (&w, "references");
+          json_ulong (&w, all[i]->references);
+          json_key (&w, "expansions");
+          json_ulong (&w, all[i]->expansions);
+          json_key (&w, "inclusive_seconds");
+          json_double (&w, all[i]->inclusive);
+          json_key (&w, "self_seconds");
+          json_double (&w, all[i]->self);
+          json_end_object (&w);
+        }
+      json_end_array (&w);
+
+      json_key (&w, "references");
+      json_begin_array (&w);
+      for (i = 0; i < edgeCount; ++i)
+        {
+          json_begin_object (&w);
+          json_key (&w, "from");
+          if (edgeList[i]->from == topLevel)
+            json_null (&w);
+          else
+            json_string (&w, edgeList[i]->from->name);
+          json_key (&w, "to");
+          json_string (&w, edgeList[i]->to->name);
+          json_key (&w, "count");
+          json_ulong (&w, edgeList[i]->count);
+          json_key (&w, "computed");
+          json_bool (&w, edgeList[i]->computed);
+          json_end_object (&w);
+        }
+      json_end_array (&w);
+
+      json_key (&w, "unreferenced");
+      json_begin_array (&w);
+      for (i = 0; i < unreferencedCount; ++i)
+        {
+          json_begin_object (&w);
+          json_key (&w, "name");
+          json_string (&w, unreferenced[i]->name);
+          json_key (&w, "file");
+          json_string (&w, unreferenced[i]->fileinfo.filenm);
+          json_key (&w, "line");
+          json_ulong (&w, unreferenced[i]->fileinfo.lineno);
+          json_key (&w, "exported");
+          json_bool (&w, unreferenced[i]->export == v_export);
+          json_end_object (&w);
+        }
+      json_end_array (&w);
+
+      json_key (&w, "undefined");
+      json_begin_array (&w);
+    }
+  else
+    {
+      printf (_("Variable references: %lu variables, %lu distinct references\n"),
+              nodeCount - 1, edgeCount);
+      printf (_("Defined in makefiles but never referenced (%lu):\n"),
+              unreferencedCount);
+      for (i = 0; i < unreferencedCount; ++i)
+        printf ("  %s (%s:%lu)%s\n", unreferenced[i]->name,
+                unreferenced[i]->fileinfo.filenm,
+                unreferenced[i]->fileinfo.lineno,
+                unreferenced[i]->export == v_export ? _(" exported") : "");
+      printf (_("Referenced but never defined:\n"));
+    }
+
+  for (i = 0; i < nodeCount; ++i)
+    {
+      struct varnode * node = all[i];
+      if (node == topLevel || node->undefined < node->references
+          || lookup_variable (node->name, node->length) != NULL)
+        continue;
+
+      ++undefinedCount;
+      if (json)
+        {
+          json_begin_object (&w);
+          json_key (&w, "name");
+          json_string (&w, node->name);
+          json_key (&w, "references");
+          json_ulong (&w, node->references);
+          json_end_object (&w);
+        }
+      else
+        printf (_("  %s (%lu references)\n"), node->name, node->references);
+    }
+
+  if (json)
+    {
+      json_end_array (&w);
+      json_key (&w, "chains");
+      json_begin_array (&w);
+      for (i = 0; i < topCount; ++i)
+        {
+          json_begin_object (&w);
+          json_key (&w, "inclusive_seconds");
+          json_double (&w, byCost[i]->inclusive);
+          json_key (&w, "variables");
+          json_begin_array (&w);
+          print_chain (byCost[i], &w);
+          json_end_array (&w);
+          json_end_object (&w);
+        }
+      json_end_array (&w);
+      json_end_object (&w);
+      json_finish (&w);
+      fclose (f);
+    }
+  else
+    {
+      if (undefinedCount == 0)
+        printf (_("  none\n"));
+      printf (_("Most expensive expansions (seconds inclusive, self, expansions):\n"));
+      for (i = 0; i < topCount; ++i)
+        {
+          printf ("  %10.6f %10.6f %8lu  ", byCost[i]->inclusive,
+                  byCost[i]->self, byCost[i]->expansions);
+          print_chain (byCost[i], NULL);
+          printf ("\n");
+        }
+    }
+
+ done:
+  free (unreferenced);
+  free (byCost);
+  free (edgeList);
+  free (all);
+  hash_free (&edges, 1);
+  hash_free (&nodes, 1);
+  free (frames);
+  frames = NULL;
+  frameCount = frameCapacity = 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2019 Debamitro Chakraborti
+ * This file was NOT part of GNU make
+ *
+ * Make-analyze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The variable reference graph: which variable's expansion (or the
+   definition of which simply expanded variable) referenced which other
+   variable, collected while make runs.  References made outside of any
+   variable, from rules and recipes, come from the top level.  When the
+   graph is not being collected every call below returns at once.  */
+
+void init_variable_references (void);
+
+/* Brackets the expansion of the value of NAME */
+void push_variable_expansion (const char * name);
+void pop_variable_expansion (void);
+
+/* Brackets the expansions made while defining NAME, which are charged to
+   NAME without counting as an expansion of it; closed by
+   pop_variable_expansion */
+void push_variable_definition (const char * name);
+
+/* Until show_variable_references is called with what this returns, the
+   references made at the current level are make's own lookups, which are
+   not recorded; those made by the values they expand still are */
+unsigned int hide_variable_references (void);
+void show_variable_references (unsigned int saved);
+
+/* Records a reference to the LENGTH chars at NAME.  COMPUTED is nonzero
+   if the name was itself the result of an expansion, as in $($(X)_FLAGS) */
+void record_variable_reference (const char * name, size_t length,
+                                int defined, int computed);
+
+/* If filename is "-" the report is printed as text on stdout, otherwise
+   the graph and the report are written to filename as JSON */
+void report_variable_references (const char * filename);
@@ -17,10 +17,21 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "makeint.h"
 #include "filedef.h"
 #include "variable.h"
+#include "hash.h"
+#include "mtimecache.h"
+#include "varrefs.h"
 #ifdef WINDOWS32
 #include "pathstuff.h"
 #endif
 
+/* Directories are read only once, and file names are compared as they
+   are, so what is in the VPATH directories can be known at once and what
+   a VPATH search finds can be remembered.  */
+#if !defined(VMS) && !defined(HAVE_DOS_PATHS) && !defined(_AMIGA) \
+    && !defined(HAVE_CASE_INSENSITIVE_FS)
+# define VPATH_CACHE 1
+#endif
+
 
 /* Structure used to represent a selective VPATH searchpath.  */
 
@@ -45,6 +56,305 @@ static struct vpath *general_vpath;
 /* Structure for GPATH given in the variable.  */
 
 static struct vpath *gpaths;
+
+/* Incremented every time the VPATH lists change.  */
+
+static unsigned long vpath_changenum;
+
+#ifdef VPATH_CACHE
+
+/* A name in a VPATH directory: a file in the directory, or a file in the
+   data base with the directory prepended to the name, or both.  */
+
+struct vpath_name
+  {
+    const char *name;           /* In the strcache.  */
+    size_t length;
+    const char *dir;            /* As in the searchpath of a VPATH.  */
+    unsigned int exists:1;      /* The directory has a file NAME.  */
+    unsigned int mentioned:1;   /* DIR/NAME is in the data base.  */
+    struct vpath_name *next;    /* The same name in another directory.  */
+  };
+
+/* All names in all VPATH directories, and the directories themselves (as
+   struct vpath_name with NAME the same as DIR), as they were when
+   VPATH_NAMES_CHANGENUM was VPATH_CHANGENUM.  */
+
+static struct hash_table vpath_names;
+static struct hash_table vpath_dirs;
+static unsigned long vpath_names_changenum;
+
+/* Nonzero if VPATH_NAMES is to be used: the names of the files in the
+   VPATH directories are the names of the directories followed by a slash
+   and the names in the directories.  */
+static int vpath_names_usable;
+
+/* What vpath_search found for a name that is not a target: the name of
+   an existing file, or nil.  */
+
+struct vpath_result
+  {
+    const char *file;           /* In the strcache.  */
+    const char *found;
+    unsigned int vpath_index;
+    unsigned int path_index;
+    int mentioned;              /* Nonzero if FOUND is in the data base.  */
+  };
+
+static struct hash_table vpath_results;
+
+static unsigned long vpath_hits;
+static unsigned long vpath_misses;
+
+static unsigned long
+vpath_name_hash_1 (const void *key)
+{
+  const struct vpath_name *n = key;
+  return_STRING_N_HASH_1 (n->name, n->length);
+}
+
+static unsigned long
+vpath_name_hash_2 (const void *key)
+{
+  const struct vpath_name *n = key;
+  return_STRING_N_HASH_2 (n->name, n->length);
+}
+
+static int
+vpath_name_hash_cmp (const void *x, const void *y)
+{
+  const struct vpath_name *nx = x;
+  const struct vpath_name *ny = y;
+  if (nx->length != ny->length)
+    return nx->length < ny->length ? -1 : 1;
+  return_STRING_N_COMPARE (nx->name, ny->name, nx->length);
+}
+
+static unsigned long
+vpath_result_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((const struct vpath_result *) key)->file);
+}
+
+static unsigned long
+vpath_result_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((const struct vpath_result *) key)->file);
+}
+
+static int
+vpath_result_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((const struct vpath_result *) x)->file,
+                         ((const struct vpath_result *) y)->file);
+}
+
+static void
+free_vpath_name (const void *item)
+{
+  struct vpath_name *n = (struct vpath_name *) item;
+  while (n != 0)
+    {
+      struct vpath_name *next = n->next;
+      free (n);
+      n = next;
+    }
+}
+
+/* Return the entry for NAME, LENGTH chars long, in DIR, made if MAKE is
+   nonzero.  */
+
+static struct vpath_name *
+find_vpath_name (const char *name, size_t length, const char *dir, int make)
+{
+  struct vpath_name key;
+  struct vpath_name **slot;
+  struct vpath_name *n;
+
+  key.name = name;
+  key.length = length;
+  slot = (struct vpath_name **) hash_find_slot (&vpath_names, &key);
+  if (!HASH_VACANT (*slot))
+    for (n = *slot; n != 0; n = n->next)
+      if (n->dir == dir)
+        return n;
+
+  if (!make)
+    return 0;
+
+  n = xcalloc (sizeof (struct vpath_name));
+  n->name = name;
+  n->length = length;
+  n->dir = dir;
+  if (HASH_VACANT (*slot))
+    hash_insert_at (&vpath_names, n, slot);
+  else
+    {
+      /* Keep the first entry in the table: others might point to it.  */
+      n->next = (*slot)->next;
+      (*slot)->next = n;
+    }
+  return n;
+}
+
+static void
+add_vpath_file (const char *name, size_t length, void *dir)
+{
+  find_vpath_name (name, length, dir, 1)->exists = 1;
+}
+
+/* Call FN with each VPATH directory that NAME is in, the rest of NAME,
+   and ARG.  */
+
+static void
+map_vpath_dirs (const char *name,
+                void (*fn) (const char *dir, const char *rest, void *arg),
+                void *arg)
+{
+  const char *slash;
+
+  for (slash = strchr (name, '/'); slash != 0; slash = strchr (slash + 1, '/'))
+    {
+      struct vpath_name key;
+      const struct vpath_name *dir;
+
+      key.name = name;
+      key.length = slash == name ? 1 : slash - name;
+      dir = hash_find_item (&vpath_dirs, &key);
+      if (dir != 0 && slash[1] != '\0')
+        fn (dir->dir, slash + 1, arg);
+    }
+}
+
+static void
+mention_vpath_file (const char *dir, const char *rest, void *arg)
+{
+  find_vpath_name (rest, strlen (rest), dir, 1)->mentioned = 1;
+  (void) arg;
+}
+
+static void
+unmention_vpath_file (const char *dir, const char *rest, void *arg)
+{
+  struct vpath_name *n = find_vpath_name (rest, strlen (rest), dir, 0);
+  if (n != 0)
+    n->mentioned = 0;
+  (void) arg;
+}
+
+static void
+forget_vpath_result (const char *dir, const char *rest, void *arg)
+{
+  struct vpath_result key;
+  struct vpath_result **slot;
+
+  key.file = rest;
+  slot = (struct vpath_result **) hash_find_slot (&vpath_results, &key);
+  if (!HASH_VACANT (*slot))
+    free (hash_delete_at (&vpath_results, slot));
+  (void) dir;
+  (void) arg;
+}
+
+/* Put the directories of PATH in VPATH_DIRS and the files in them in
+   VPATH_NAMES.  */
+
+static void
+add_vpath_dirs (const struct vpath *path)
+{
+  const char **dir;
+
+  for (dir = path->searchpath; *dir != 0; ++dir)
+    {
+      struct vpath_name key;
+      struct vpath_name **slot;
+
+      if ((*dir)[0] == '.' && ((*dir)[1] == '/' || (*dir)[1] == '\0'))
+        /* The data base knows the files in it by other names.  */
+        vpath_names_usable = 0;
+
+      key.name = *dir;
+      key.length = strlen (*dir);
+      slot = (struct vpath_name **) hash_find_slot (&vpath_dirs, &key);
+      if (HASH_VACANT (*slot))
+        {
+          struct vpath_name *d = xcalloc (sizeof (struct vpath_name));
+          *d = key;
+          d->dir = *dir;
+          hash_insert_at (&vpath_dirs, d, slot);
+          dir_map_files (*dir, add_vpath_file, (void *) *dir);
+        }
+    }
+}
+
+/* Make VPATH_NAMES and VPATH_RESULTS fit the VPATH lists.  Return
+   nonzero if VPATH_NAMES is to be used.  */
+
+static int
+update_vpath_names (void)
+{
+  struct vpath *v;
+  struct file **files;
+  unsigned long nfiles;
+  unsigned long i;
+
+  if (vpath_names.ht_vec != 0 && vpath_names_changenum == vpath_changenum)
+    return vpath_names_usable;
+
+  if (vpath_names.ht_vec == 0)
+    {
+      hash_init (&vpath_names, 1024, vpath_name_hash_1, vpath_name_hash_2,
+                 vpath_name_hash_cmp);
+      hash_init (&vpath_dirs, 64, vpath_name_hash_1, vpath_name_hash_2,
+                 vpath_name_hash_cmp);
+      hash_init (&vpath_results, 1024, vpath_result_hash_1,
+                 vpath_result_hash_2, vpath_result_hash_cmp);
+    }
+  else
+    {
+      hash_map (&vpath_names, free_vpath_name);
+      hash_delete_items (&vpath_names);
+      hash_free_items (&vpath_dirs);
+      hash_free_items (&vpath_results);
+    }
+  vpath_names_changenum = vpath_changenum;
+
+  vpath_names_usable = 1;
+  for (v = vpaths; v != 0; v = v->next)
+    add_vpath_dirs (v);
+  if (general_vpath != 0)
+    add_vpath_dirs (general_vpath);
+
+  files = get_all_files (&nfiles);
+  for (i = 0; i < nfiles; ++i)
+    map_vpath_dirs (files[i]->hname, mention_vpath_file, 0);
+  free (files);
+
+  return vpath_names_usable;
+}
+
+#endif /* VPATH_CACHE */
+
+/* Note that NAME is being entered in the data base if ENTERED is nonzero,
+   or taken out of it: a VPATH search might find it, or find something
+   else instead.  */
+
+void
+vpath_note_file (const char *name, int entered)
+{
+#ifdef VPATH_CACHE
+  if (vpath_names.ht_vec == 0 || vpath_names_changenum != vpath_changenum)
+    /* It is all looked at anew when needed.  */
+    return;
+
+  map_vpath_dirs (name, entered ? mention_vpath_file : unmention_vpath_file,
+                  0);
+  map_vpath_dirs (name, forget_vpath_result, 0);
+#else
+  (void) name;
+  (void) entered;
+#endif
+}
 
 
 /* Reverse the chain of selective VPATH lists so they will be searched in the
@@ -58,6 +368,8 @@ build_vpath_lists (void)
   struct vpath *old, *nexto;
   char *p;
 
+  ++vpath_changenum;
+
   /* Reverse the chain.  */
   for (old = vpaths; old != 0; old = nexto)
     {
@@ -75,11 +387,13 @@ build_vpath_lists (void)
   {
     /* Turn off --warn-undefined-variables while we expand SHELL and IFS.  */
     int save = warn_undefined_variables_flag;
+    unsigned int hidden = hide_variable_references ();
     warn_undefined_variables_flag = 0;
 
     p = variable_expand ("$(strip $(VPATH))");
 
     warn_undefined_variables_flag = save;
+    show_variable_references (hidden);
   }
 
   if (*p != '\0')
@@ -108,11 +422,13 @@ build_vpath_lists (void)
   {
     /* Turn off --warn-undefined-variables while we expand SHELL and IFS.  */
     int save = warn_undefined_variables_flag;
+    unsigned int hidden = hide_variable_references ();
     warn_undefined_variables_flag = 0;
 
     p = variable_expand ("$(strip $(GPATH))");
 
     warn_undefined_variables_flag = save;
+    show_variable_references (hidden);
   }
 
   if (*p != '\0')
@@ -135,6 +451,41 @@ build_vpath_lists (void)
     }
 }
 
+/* Call FN for every selective VPATH listing, from the most recently
+   constructed one on, with its pattern and its directories separated by
+   PATH_SEPARATOR_CHAR.  Calling construct_vpath_list () with the same
+   arguments in the opposite order rebuilds the listings.  */
+
+void
+map_vpath_lists (void (*fn) (const char *pattern, const char *path,
+                             void *arg), void *arg)
+{
+  struct vpath *v;
+
+  for (v = vpaths; v != 0; v = v->next)
+    {
+      size_t len = 0;
+      unsigned int i;
+      char *path, *p;
+
+      for (i = 0; v->searchpath[i] != 0; ++i)
+        len += strlen (v->searchpath[i]) + 1;
+
+      p = path = xmalloc (len + 1);
+      for (i = 0; v->searchpath[i] != 0; ++i)
+        {
+          if (i > 0)
+            *p++ = PATH_SEPARATOR_CHAR;
+          strcpy (p, v->searchpath[i]);
+          p += strlen (p);
+        }
+      *p = '\0';
+
+      fn (v->pattern, path, arg);
+      free (path);
+    }
+}
+
 /* Construct the VPATH listing for the PATTERN and DIRPATH given.
 
    This function is called to generate selective VPATH lists and also for
@@ -167,6 +518,8 @@ construct_vpath_list (char *pattern, char *dirpath)
   if (pattern != 0)
     percent = find_percent (pattern);
 
+  ++vpath_changenum;
+
   if (dirpath == 0)
     {
       /* Remove matching listings.  */
@@ -337,6 +690,10 @@ selective_vpath_search (struct vpath *path, const char *file,
   unsigned int i;
   size_t flen, name_dplen;
   int exists = 0;
+#ifdef VPATH_CACHE
+  int indexed = 0;
+  const struct vpath_name *known = 0;
+#endif
 
   /* Find out if *FILE is a target.
      If and only if it is NOT a target, we will accept prospective
@@ -371,12 +728,38 @@ selective_vpath_search (struct vpath *path, const char *file,
      always be necessary), the filename, and a null terminator.  */
   name = alloca (maxvpath + 1 + name_dplen + 1 + flen + 1);
 
+#ifdef VPATH_CACHE
+  /* All that is known of a name without a directory prefix in the VPATH
+     directories is found at once.  */
+  if (name_dplen == 0 && update_vpath_names ())
+    {
+      struct vpath_name key;
+      key.name = filename;
+      key.length = flen;
+      known = hash_find_item (&vpath_names, &key);
+      indexed = 1;
+    }
+#endif
+
   /* Try each VPATH entry.  */
   for (i = 0; vpath[i] != 0; ++i)
     {
       int exists_in_cache = 0;
       char *p = name;
       size_t vlen = strlen (vpath[i]);
+#ifdef VPATH_CACHE
+      const struct vpath_name *here = 0;
+
+      if (indexed)
+        {
+          for (here = known; here != 0; here = here->next)
+            if (here->dir == vpath[i])
+              break;
+          if (here == 0)
+            /* Neither in the directory nor in the data base.  */
+            continue;
+        }
+#endif
 
       /* Put the next VPATH entry into NAME at P and increment P past it.  */
       memcpy (p, vpath[i], vlen);
@@ -442,6 +825,9 @@ selective_vpath_search (struct vpath *path, const char *file,
          file* entry for the VPATH-found file, and set the renamed field if
          we use it.
       */
+#ifdef VPATH_CACHE
+      if (!indexed || here->mentioned)
+#endif
       {
         struct file *f = lookup_file (name);
         if (f != 0)
@@ -461,6 +847,11 @@ selective_vpath_search (struct vpath *path, const char *file,
           /* That file wasn't mentioned in the makefile.
              See if it actually exists.  */
 
+#ifdef VPATH_CACHE
+          if (indexed)
+            exists_in_cache = exists = here->exists;
+          else
+#endif
 #ifdef VMS
           /* For VMS syntax just use the original vpath */
           if (*p != '/')
@@ -499,9 +890,13 @@ selective_vpath_search (struct vpath *path, const char *file,
 
           if (exists_in_cache)  /* Makefile-mentioned file need not exist.  */
             {
+              FILE_TIMESTAMP mtime = UNKNOWN_MTIME;
               int e;
 
-              EINTRLOOP (e, stat (name, &st)); /* Does it really exist?  */
+              if (prefetched_mtime (name, &mtime))
+                e = mtime == NONEXISTENT_MTIME ? -1 : 0;
+              else
+                EINTRLOOP (e, stat (name, &st)); /* Does it really exist?  */
               if (e != 0)
                 {
                   exists = 0;
@@ -511,7 +906,8 @@ selective_vpath_search (struct vpath *path, const char *file,
               /* Store the modtime into *MTIME_PTR for the caller.  */
               if (mtime_ptr != 0)
                 {
-                  *mtime_ptr = FILE_TIMESTAMP_STAT_MODTIME (name, st);
+                  *mtime_ptr = (mtime != UNKNOWN_MTIME ? mtime
+                                : FILE_TIMESTAMP_STAT_MODTIME (name, st));
                   mtime_ptr = 0;
                 }
             }
@@ -535,33 +931,90 @@ selective_vpath_search (struct vpath *path, const char *file,
 }
 
 
+/* Return nonzero if there are VPATH entries, so that vpath_search may find
+   a file somewhere other than where it is named.  */
+
+int
+vpath_in_effect (void)
+{
+  return vpaths != 0 || general_vpath != 0;
+}
+
+/* Call FN with ARG and each file in the directories of PATH that
+   vpath_search might stat for FILE.  */
+
+static void
+map_candidates (struct vpath *path, const char *file,
+                void (*fn) (const char *name, void *arg), void *arg)
+{
+  const char *filename = strrchr (file, '/');
+  size_t flen = strlen (file);
+  size_t name_dplen = filename != 0 ? filename - file : 0;
+  char *name = alloca (path->maxlen + 1 + flen + 1);
+  const char **vpath;
+
+  filename = filename != 0 ? filename + 1 : file;
+
+  for (vpath = path->searchpath; *vpath != 0; ++vpath)
+    {
+      size_t vlen = strlen (*vpath);
+      char *p = name;
+
+      /* Make NAME the directory to look in, then the file in it.  */
+      memcpy (p, *vpath, vlen);
+      p += vlen;
+      if (name_dplen > 0)
+        {
+          *p++ = '/';
+          memcpy (p, file, name_dplen);
+          p += name_dplen;
+        }
+      *p = '\0';
+      if (!dir_file_exists_p (name, filename))
+        continue;
+
+      if (p[-1] != '/')
+        *p++ = '/';
+      strcpy (p, filename);
+      fn (name, arg);
+    }
+}
+
+/* Call FN with ARG and each file that vpath_search might stat for FILE:
+   the files named FILE in the directories of the VPATH lists that match
+   it.  */
+
+void
+vpath_map_candidates (const char *file,
+                      void (*fn) (const char *name, void *arg), void *arg)
+{
+  struct vpath *v;
+
+  if (file[0] == '/')
+    return;
+
+  for (v = vpaths; v != 0; v = v->next)
+    if (pattern_matches (v->pattern, v->percent, file))
+      map_candidates (v, file, fn, arg);
+
+  if (general_vpath != 0)
+    map_candidates (general_vpath, file, fn, arg);
+}
+
 /* Search the VPATH list whose pattern matches FILE for a directory where FILE
    exists.  If it is found, return the cached name of an existing file, and
    set *MTIME_PTR (if MTIME_PTR is not NULL) to its modtime (or zero if no
    stat call was done). Also set the matching directory index in VPATH_INDEX
    and PATH_INDEX if they are not NULL.  Otherwise we return 0.  */
 
-const char *
-vpath_search (const char *file, FILE_TIMESTAMP *mtime_ptr,
-              unsigned int* vpath_index, unsigned int* path_index)
+static const char *
+vpath_search_1 (const char *file, FILE_TIMESTAMP *mtime_ptr,
+                unsigned int* vpath_index, unsigned int* path_index)
 {
   struct vpath *v;
 
-  /* If there are no VPATH entries or FILENAME starts at the root,
-     there is nothing we can do.  */
-
-  if (file[0] == '/'
-#ifdef HAVE_DOS_PATHS
-      || file[0] == '\\' || file[1] == ':'
-#endif
-      || (vpaths == 0 && general_vpath == 0))
-    return 0;
-
-  if (vpath_index)
-    {
-      *vpath_index = 0;
-      *path_index = 0;
-    }
+  *vpath_index = 0;
+  *path_index = 0;
 
   for (v = vpaths; v != 0; v = v->next)
     {
@@ -573,8 +1026,7 @@ vpath_search (const char *file, FILE_TIMESTAMP *mtime_ptr,
             return p;
         }
 
-      if (vpath_index)
-        ++*vpath_index;
+      ++*vpath_index;
     }
 
 
@@ -589,6 +1041,138 @@ vpath_search (const char *file, FILE_TIMESTAMP *mtime_ptr,
   return 0;
 }
 
+/* Search the VPATH list whose pattern matches FILE for a directory where FILE
+   exists.  If it is found, return the cached name of an existing file, and
+   set *MTIME_PTR (if MTIME_PTR is not NULL) to its modtime (or zero if no
+   stat call was done). Also set the matching directory index in VPATH_INDEX
+   and PATH_INDEX if they are not NULL.  Otherwise we return 0.
+
+   What is found for a name that is not a target is remembered until a
+   file that could be found for it is entered in the data base or taken
+   out of it (see vpath_note_file): nothing else changes what is found,
+   since each directory is read only once.  A file found in a directory is
+   still checked to exist.  */
+
+const char *
+vpath_search (const char *file, FILE_TIMESTAMP *mtime_ptr,
+              unsigned int* vpath_index, unsigned int* path_index)
+{
+  unsigned int vindex, pindex;
+  const char *found;
+#ifdef VPATH_CACHE
+  struct vpath_result key;
+  struct vpath_result **slot;
+  struct vpath_result *r;
+  int remember;
+#endif
+
+  /* If there are no VPATH entries or FILENAME starts at the root,
+     there is nothing we can do.  */
+
+  if (file[0] == '/'
+#ifdef HAVE_DOS_PATHS
+      || file[0] == '\\' || file[1] == ':'
+#endif
+      || (vpaths == 0 && general_vpath == 0))
+    return 0;
+
+#ifdef VPATH_CACHE
+  /* Whether a file that is mentioned but does not exist will do depends
+     on whether FILE is a target.  */
+  {
+    struct file *f = lookup_file (file);
+    remember = (f == 0 || !f->is_target) && update_vpath_names ();
+  }
+
+  if (remember)
+    {
+      key.file = file;
+      r = hash_find_item (&vpath_results, &key);
+      if (r != 0 && r->found == 0)
+        {
+          ++vpath_hits;
+          return 0;
+        }
+      if (r != 0)
+        {
+          int exists = 1;
+
+          if (r->mentioned)
+            {
+              /* It need not exist, but keep the times of -o and -W.  */
+              if (mtime_ptr != 0)
+                {
+                  struct file *f = lookup_file (r->found);
+                  *mtime_ptr = (f->last_mtime == OLD_MTIME
+                                || f->last_mtime == NEW_MTIME
+                                ? f->last_mtime : UNKNOWN_MTIME);
+                }
+            }
+          else
+            {
+              FILE_TIMESTAMP mtime;
+              struct stat st;
+              int e;
+
+              if (prefetched_mtime (r->found, &mtime))
+                {
+                  exists = mtime != NONEXISTENT_MTIME;
+                  if (exists && mtime_ptr != 0)
+                    *mtime_ptr = mtime;
+                }
+              else
+                {
+                  EINTRLOOP (e, stat (r->found, &st));
+                  if (e != 0)
+                    exists = 0;
+                  else if (mtime_ptr != 0)
+                    *mtime_ptr = FILE_TIMESTAMP_STAT_MODTIME (r->found, st);
+                }
+            }
+
+          if (exists)
+            {
+              ++vpath_hits;
+              if (vpath_index)
+                {
+                  *vpath_index = r->vpath_index;
+                  *path_index = r->path_index;
+                }
+              return r->found;
+            }
+        }
+    }
+#endif /* VPATH_CACHE */
+
+  found = vpath_search_1 (file, mtime_ptr, &vindex, &pindex);
+
+#ifdef VPATH_CACHE
+  if (remember)
+    {
+      ++vpath_misses;
+      slot = (struct vpath_result **) hash_find_slot (&vpath_results, &key);
+      r = *slot;
+      if (HASH_VACANT (r))
+        {
+          r = xmalloc (sizeof (struct vpath_result));
+          r->file = strcache_add (file);
+          hash_insert_at (&vpath_results, r, slot);
+        }
+      r->found = found;
+      r->vpath_index = vindex;
+      r->path_index = pindex;
+      r->mentioned = found != 0 && lookup_file (found) != 0;
+    }
+#endif
+
+  if (found != 0 && vpath_index)
+    {
+      *vpath_index = vindex;
+      *path_index = pindex;
+    }
+  return found;
+}
+
 
 
 
@@ -634,4 +1218,10 @@ print_vpath_data_base (void)
         printf ("%s%c", path[i],
                 path[i + 1] == 0 ? '\n' : PATH_SEPARATOR_CHAR);
     }
+
+#ifdef VPATH_CACHE
+  if (vpath_hits + vpath_misses > 0)
+    printf (_("\n# VPATH searches: %lu names found again, %lu searched\n"),
+            vpath_hits, vpath_misses);
+#endif
 }
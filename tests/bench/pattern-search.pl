@@ -0,0 +1,57 @@
+#!/usr/bin/env perl
+# -*-perl-*-
+#
+# Times implicit rule search with patterns.mk for each make given on the
+# command line, to compare builds of make.  Usage:
+#
+#   perl pattern-search.pl [-rules N] [-files N] [-runs N] MAKE...
+#
+# Every make runs 'make -n -B' over the same generated sources RUNS
+# times; the fastest run is reported.
+
+use strict;
+use warnings;
+
+use Cwd qw(abs_path getcwd);
+use File::Basename qw(dirname);
+use File::Temp qw(tempdir);
+use Time::HiRes qw(time);
+
+my $rules = 2000;
+my $files = 10000;
+my $runs = 3;
+
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my $opt = shift @ARGV;
+    if ($opt eq '-rules') { $rules = shift @ARGV; }
+    elsif ($opt eq '-files') { $files = shift @ARGV; }
+    elsif ($opt eq '-runs') { $runs = shift @ARGV; }
+    else { die "$0: unknown option $opt\n"; }
+}
+@ARGV or die "usage: $0 [-rules N] [-files N] [-runs N] MAKE...\n";
+
+my $makefile = abs_path(dirname($0)) . '/patterns.mk';
+my @makes = map { m{/} ? abs_path($_) : $_ } @ARGV;
+
+my $dir = tempdir('pattern-search-XXXXXX', TMPDIR => 1, CLEANUP => 1);
+my $start = getcwd();
+chdir($dir) or die "$0: $dir: $!\n";
+for my $n (1 .. $files) {
+    open(my $fh, '>', "f$n.c") or die "$0: f$n.c: $!\n";
+    close($fh);
+}
+
+printf("%d pattern rules, %d files, best of %d runs\n", $rules, $files, $runs);
+for my $make (@makes) {
+    my $best;
+    for (1 .. $runs) {
+        my $t = time();
+        system("$make -f $makefile -n -B RULES=$rules FILES=$files > /dev/null") == 0
+            or die "$0: $make failed\n";
+        $t = time() - $t;
+        $best = $t if !defined($best) || $t < $best;
+    }
+    printf("  %8.3f s  %s\n", $best, $make);
+}
+
+chdir($start);
@@ -0,0 +1,21 @@
+# Benchmark for implicit rule search.
+#
+# RULES pattern rules whose targets each end in a suffix of their own,
+# which the search for an object file can skip, and one %.o: %.c rule
+# that makes FILES objects from the f<n>.c files in the directory.
+# Run it through pattern-search.pl, which creates the sources.
+
+MAKEFLAGS += -r
+
+RULES ?= 2000
+FILES ?= 10000
+
+count = $(shell seq 1 $(1))
+
+.DEFAULT_GOAL := all
+
+$(foreach i,$(call count,$(RULES)),$(eval %.t$(i): %.c ; @:))
+
+%.o: %.c ; @:
+
+all: $(patsubst %,f%.o,$(call count,$(FILES)))